@@ -0,0 +1,19 @@
+# Settings shared by the benchmarks, each of which includes this file and
+# adds its target and sources.
+#
+# The benchmarks link against the static library, see benchmarks.pro for
+# how to build them.
+
+QT += widgets
+
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+INCLUDEPATH += \
+    $$PWD/..
+
+LIBS += \
+    -L$$OUT_PWD/../.. -lqtterminalwidget
+PRE_TARGETDEPS += \
+    $$OUT_PWD/../../libqtterminalwidget.a
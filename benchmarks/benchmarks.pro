@@ -0,0 +1,16 @@
+# Builds all benchmarks.
+#
+# They link against the static library, so build qtterminalwidget.pro first
+# in the directory above this one's build directory, eg.:
+#   mkdir -p build/benchmarks
+#   cd build && qmake ../qtterminalwidget.pro && make
+#   cd benchmarks && qmake ../../benchmarks/benchmarks.pro && make
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    blockcodec \
+    linecompare \
+    literalmatcher \
+    replay \
+    urlfilter
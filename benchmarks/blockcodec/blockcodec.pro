@@ -0,0 +1,10 @@
+# Round-trip and corruption check and micro-benchmark for the block codec
+# of the compressed history.
+# See ../benchmarks.pro for how to build it.
+
+include(../benchmark.pri)
+
+TARGET = blockcodec
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,314 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Checks that compressBlock() and decompressBlock() round-trip and that
+ * the decoder rejects truncated and damaged data without writing outside
+ * its buffer, then times both and reports the results as JSON.  See
+ * README.md in this directory.
+ */
+
+// Own includes
+#include "blockcodec.h"
+
+// System includes
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Qt includes
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace
+{
+
+typedef std::vector<char> Bytes;
+
+// bytes written after the end of a decompression buffer, which must not change
+const int GUARD_BYTES = 16;
+const char GUARD = char(0xa5);
+
+/** Small linear congruential generator, so the inputs do not depend on the C library */
+class Random
+{
+public:
+    Random(quint32 seed) : _state(seed) {}
+
+    quint32 next()
+    {
+        _state = _state * 1664525u + 1013904223u;
+        return _state >> 8;
+    }
+
+private:
+    quint32 _state;
+};
+
+/** Returns lines of text like those of a build log */
+Bytes textInput(int size)
+{
+    static const char* const WORDS[] = {
+        "compiling", "linking", "warning:", "screen.cpp", "history.cpp",
+        "-O2", "-fPIC", "unused", "variable", "in", "function", "[", "]"
+    };
+    Random random(1);
+    Bytes bytes;
+    while (int(bytes.size()) < size)
+    {
+        const char* word = WORDS[random.next() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        bytes.insert(bytes.end(), word, word + strlen(word));
+        bytes.push_back(random.next() % 8 == 0 ? '\n' : ' ');
+    }
+    bytes.resize(size);
+    return bytes;
+}
+
+/** Returns byte planes like those of the compressed history: mostly zeros */
+Bytes planesInput(int size)
+{
+    Random random(2);
+    Bytes bytes(size, 0);
+    for (int i = 0; i < size / 8; i++)
+        bytes[i] = char(' ' + random.next() % 64);
+    return bytes;
+}
+
+Bytes randomInput(int size)
+{
+    Random random(3);
+    Bytes bytes(size);
+    for (int i = 0; i < size; i++)
+        bytes[i] = char(random.next());
+    return bytes;
+}
+
+Bytes compress(const Bytes& input)
+{
+    Bytes output(compressBlockBound(int(input.size())));
+    output.resize(compressBlock(input.empty() ? 0 : &input[0], int(input.size()),
+                                &output[0], int(output.size())));
+    return output;
+}
+
+/**
+ * Decompresses @p compressed into @p output, which is resized to
+ * @p decompressedSize.  Returns false if the decoder rejected the data,
+ * and sets @p overrun if it wrote past the end of the buffer.
+ */
+bool decompress(const Bytes& compressed, int decompressedSize, Bytes& output, bool& overrun)
+{
+    // the data is copied to a buffer of its exact size, so that reading
+    // past its end is caught by the address sanitizer
+    Bytes source(compressed);
+    output.assign(decompressedSize + GUARD_BYTES, GUARD);
+    const bool ok = decompressBlock(source.empty() ? 0 : &source[0], int(source.size()),
+                                    &output[0], decompressedSize);
+
+    overrun = false;
+    for (int i = decompressedSize; i < decompressedSize + GUARD_BYTES; i++)
+        overrun = overrun || output[i] != GUARD;
+    output.resize(decompressedSize);
+    return ok;
+}
+
+class Checker
+{
+public:
+    Checker() : checks(0), failures(0) {}
+
+    void fail(const char* what, const QString& input)
+    {
+        fprintf(stderr, "%s: %s\n", qPrintable(input), what);
+        failures++;
+    }
+
+    /** Compresses and decompresses @p input, then damages the compressed data */
+    void check(const Bytes& input, const QString& name)
+    {
+        const int size = int(input.size());
+        const Bytes compressed = compress(input);
+        bool overrun = false;
+        Bytes output;
+
+        checks++;
+        if (compressed.empty())
+            fail("not compressed", name);
+        if (!decompress(compressed, size, output, overrun) || output != input)
+            fail("does not round-trip", name);
+        if (overrun)
+            fail("decoder wrote past its buffer", name);
+
+        // too small a destination is refused rather than overrun
+        checks++;
+        if (size > 0)
+        {
+            Bytes small(compressBlockBound(size) - 1);
+            if (compressBlock(&input[0], size, &small[0], int(small.size())) != 0)
+                fail("compressed into too small a buffer", name);
+        }
+
+        // a wrong size is corrupt data
+        checks += 2;
+        if (decompress(compressed, size + 1, output, overrun) || overrun)
+            fail("accepted a larger size", name);
+        if (size > 0 && (decompress(compressed, size - 1, output, overrun) || overrun))
+            fail("accepted a smaller size", name);
+
+        // every truncation loses bytes of a non-empty input, so it must be rejected
+        const int step = qMax(1, int(compressed.size()) / 256);
+        for (int length = 0; size > 0 && length < int(compressed.size()); length += step)
+        {
+            checks++;
+            const Bytes truncated(compressed.begin(), compressed.begin() + length);
+            if (decompress(truncated, size, output, overrun) || overrun)
+                fail("accepted truncated data", name);
+        }
+
+        // damaged bytes may still decode, but never outside the buffer
+        Random random(size);
+        for (int i = 0; i < 256 && !compressed.empty(); i++)
+        {
+            checks++;
+            Bytes damaged(compressed);
+            damaged[random.next() % damaged.size()] ^= char(1 + random.next() % 255);
+            decompress(damaged, size, output, overrun);
+            if (overrun)
+                fail("decoder wrote past its buffer on damaged data", name);
+        }
+    }
+
+    int checks;
+    int failures;
+};
+
+/** Returns the megabytes per second of the fastest of three runs of @p function */
+template <typename Function>
+double throughput(int bytes, int iterations, Function function)
+{
+    qint64 best = -1;
+    for (int run = 0; run < 3; run++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+            function();
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return double(bytes) * iterations / qMax(best, qint64(1)) * 1e9 / (1024 * 1024);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("blockcodec"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Checks the history block codec and times it, reporting the results as JSON."));
+    parser.addHelpOption();
+
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+        QStringLiteral("Blocks compressed and decompressed per measurement (default: 200)."),
+        QStringLiteral("count"), QStringLiteral("200"));
+    parser.addOption(iterationsOption);
+    QCommandLineOption sizeOption(QStringLiteral("size"),
+        QStringLiteral("Bytes per block (default: 65536)."),
+        QStringLiteral("bytes"), QStringLiteral("65536"));
+    parser.addOption(sizeOption);
+    parser.process(app);
+
+    const int iterations = parser.value(iterationsOption).toInt();
+    const int size = parser.value(sizeOption).toInt();
+    if (iterations <= 0 || size <= 0)
+    {
+        fprintf(stderr, "Invalid --iterations or --size\n");
+        return 1;
+    }
+
+    Checker checker;
+
+    // inputs shorter than the matches the encoder looks for, and around that length
+    for (int length = 0; length <= 64; length++)
+    {
+        checker.check(textInput(length), QStringLiteral("text-%1").arg(length));
+        checker.check(randomInput(length), QStringLiteral("random-%1").arg(length));
+        checker.check(Bytes(length, 0), QStringLiteral("zeros-%1").arg(length));
+    }
+
+    struct Input
+    {
+        const char* name;
+        Bytes bytes;
+    };
+    const Input inputs[] = {
+        { "text", textInput(size) },
+        { "planes", planesInput(size) },
+        { "random", randomInput(size) },
+        { "zeros", Bytes(size, 0) }
+    };
+
+    QJsonArray results;
+    for (unsigned i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        const Bytes& input = inputs[i].bytes;
+        checker.check(input, QString::fromLatin1(inputs[i].name));
+
+        const Bytes compressed = compress(input);
+        Bytes buffer(compressBlockBound(size));
+        Bytes output(size);
+        const double compressSpeed = throughput(size, iterations, [&]() {
+            compressBlock(&input[0], size, &buffer[0], int(buffer.size()));
+        });
+        const double decompressSpeed = throughput(size, iterations, [&]() {
+            decompressBlock(&compressed[0], int(compressed.size()), &output[0], size);
+        });
+
+        QJsonObject result;
+        result[QStringLiteral("input")] = QString::fromLatin1(inputs[i].name);
+        result[QStringLiteral("compressedBytes")] = int(compressed.size());
+        result[QStringLiteral("ratio")] = double(size) / compressed.size();
+        result[QStringLiteral("compressMBps")] = compressSpeed;
+        result[QStringLiteral("decompressMBps")] = decompressSpeed;
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report[QStringLiteral("qtVersion")] = QString::fromLatin1(qVersion());
+    report[QStringLiteral("iterations")] = iterations;
+    report[QStringLiteral("bytes")] = size;
+    report[QStringLiteral("checks")] = checker.checks;
+    report[QStringLiteral("failures")] = checker.failures;
+    report[QStringLiteral("results")] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+    return checker.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+# Micro-benchmark for the line comparison in TerminalDisplay::updateImage().
+# See ../benchmarks.pro for how to build it.
+
+include(../benchmark.pri)
+
+TARGET = linecompare
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,185 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Times compareLines() against compareLinesScalar() on lines of 80, 200
+ * and 400 columns and reports the results as JSON.  See README.md in this
+ * directory.
+ */
+
+// Own includes
+#include "linecompare.h"
+
+// System includes
+#include <stdio.h>
+
+// Qt includes
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+
+namespace
+{
+
+typedef int (*CompareFunction)(const Character*, const Character*, int, ColumnRange*);
+
+enum Change
+{
+    Unchanged,
+    OneCell,
+    Sparse,
+    All
+};
+
+const char* changeName(Change change)
+{
+    switch (change)
+    {
+    case Unchanged: return "unchanged";
+    case OneCell:   return "one-cell";
+    case Sparse:    return "sparse";
+    case All:       return "all";
+    }
+    return "";
+}
+
+/** Fills @p line with text in a few colors, like a colored log line */
+void fillLine(QVector<Character>& line)
+{
+    for (int x = 0; x < line.size(); x++)
+    {
+        line[x] = Character('a' + x % 26,
+                            CharacterColor(COLOR_SPACE_SYSTEM, (x / 10) % 8),
+                            CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_BACK_COLOR));
+    }
+}
+
+void applyChange(QVector<Character>& line, Change change)
+{
+    switch (change)
+    {
+    case Unchanged:
+        break;
+    case OneCell:
+        line[line.size() / 2].character = '#';
+        break;
+    case Sparse:
+        for (int x = 0; x < line.size(); x += 16)
+            line[x].foregroundColor = CharacterColor(COLOR_SPACE_256, 200);
+        break;
+    case All:
+        for (int x = 0; x < line.size(); x++)
+            line[x].rendition |= RE_BOLD;
+        break;
+    }
+}
+
+/** Returns the nanoseconds per comparison of the fastest of three runs */
+double timeCompare(CompareFunction compare, const QVector<Character>& oldLine,
+                   const QVector<Character>& newLine, int iterations)
+{
+    QVector<ColumnRange> ranges((oldLine.size() + 1) / 2);
+    qint64 best = -1;
+    volatile int sink = 0;
+
+    for (int run = 0; run < 3; run++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+            sink = sink + compare(oldLine.constData(), newLine.constData(),
+                                  oldLine.size(), ranges.data());
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return double(best) / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("linecompare"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Times the comparison of terminal lines and reports the results as JSON."));
+    parser.addHelpOption();
+
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+        QStringLiteral("Comparisons per measurement (default: 200000)."),
+        QStringLiteral("count"), QStringLiteral("200000"));
+    parser.addOption(iterationsOption);
+    parser.process(app);
+
+    const int iterations = parser.value(iterationsOption).toInt();
+    if (iterations <= 0)
+    {
+        fprintf(stderr, "Invalid --iterations\n");
+        return 1;
+    }
+
+    const int widths[] = { 80, 200, 400 };
+    const Change changes[] = { Unchanged, OneCell, Sparse, All };
+
+    QJsonArray results;
+    for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        for (unsigned c = 0; c < sizeof(changes) / sizeof(changes[0]); c++)
+        {
+            const int columns = widths[w];
+            const Change change = changes[c];
+
+            QVector<Character> oldLine(columns);
+            fillLine(oldLine);
+            QVector<Character> newLine = oldLine;
+            applyChange(newLine, change);
+
+            const double scalar = timeCompare(compareLinesScalar, oldLine, newLine, iterations);
+            const double vectorized = timeCompare(compareLines, oldLine, newLine, iterations);
+
+            QJsonObject result;
+            result[QStringLiteral("columns")] = columns;
+            result[QStringLiteral("change")] = QString::fromLatin1(changeName(change));
+            result[QStringLiteral("scalarNs")] = scalar;
+            result[QStringLiteral("vectorizedNs")] = vectorized;
+            result[QStringLiteral("speedup")] = scalar / qMax(vectorized, 0.001);
+            results.append(result);
+        }
+    }
+
+    QJsonObject report;
+    report[QStringLiteral("qtVersion")] = QString::fromLatin1(qVersion());
+    report[QStringLiteral("iterations")] = iterations;
+    report[QStringLiteral("results")] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+    return 0;
+}
@@ -0,0 +1,9 @@
+# Micro-benchmark for the plain text search in the history.
+# See ../benchmarks.pro for how to build it.
+
+include(../benchmark.pri)
+
+TARGET = literalmatcher
+
+SOURCES += \
+    main.cpp
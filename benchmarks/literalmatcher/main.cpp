@@ -0,0 +1,184 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Times LiteralMatcher::indexIn() against LiteralMatcher::indexInScalar()
+ * and against decoding the cells into a QString and searching that, which
+ * is what a search for plain text did before, and reports the results as
+ * JSON.  See README.md in this directory.
+ */
+
+// Own includes
+#include "literalmatcher.h"
+
+// System includes
+#include <stdio.h>
+
+// Qt includes
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+
+namespace
+{
+
+const char* const WORDS[] = {
+    "the", "terminal", "emulation", "screen", "history", "line", "of",
+    "output", "error", "warning", "build", "src/main.cpp", "0x7fff5fbff8c8", "OK"
+};
+
+/** Fills @p cells with lines of words, like the output of a build */
+void fillCells(QVector<CompactCharacter>& cells)
+{
+    quint32 seed = 1;
+    int x = 0;
+    while (x < cells.size())
+    {
+        seed = seed * 1103515245 + 12345;
+        const char* word = WORDS[(seed >> 16) % (sizeof(WORDS) / sizeof(WORDS[0]))];
+        for (; *word && x < cells.size(); word++)
+            cells[x++] = CompactCharacter(quint32(*word), seed % 3);
+        if (x < cells.size())
+            cells[x++] = CompactCharacter(' ');
+    }
+}
+
+/** Returns the nanoseconds per cell of the fastest of three searches through all of @p cells */
+template <typename Search>
+double timeSearch(Search search, int cellCount, int iterations)
+{
+    qint64 best = -1;
+    volatile int sink = 0;
+
+    for (int run = 0; run < 3; run++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+            sink = sink + search();
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return double(best) / iterations / cellCount;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("literalmatcher"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Times the search for plain text in terminal cells and reports the results as JSON."));
+    parser.addHelpOption();
+
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+        QStringLiteral("Searches through all cells per measurement (default: 20)."),
+        QStringLiteral("count"), QStringLiteral("20"));
+    QCommandLineOption cellsOption(QStringLiteral("cells"),
+        QStringLiteral("Cells searched (default: 1000000)."),
+        QStringLiteral("count"), QStringLiteral("1000000"));
+    parser.addOption(iterationsOption);
+    parser.addOption(cellsOption);
+    parser.process(app);
+
+    const int iterations = parser.value(iterationsOption).toInt();
+    const int cellCount = parser.value(cellsOption).toInt();
+    if (iterations <= 0 || cellCount <= 0)
+    {
+        fprintf(stderr, "Invalid --iterations or --cells\n");
+        return 1;
+    }
+
+    QVector<CompactCharacter> cells(cellCount);
+    fillCells(cells);
+
+    // the text never occurs, so every search goes through all of the cells
+    const char* const texts[] = { "segfault", "e", "Undefined reference" };
+    const Qt::CaseSensitivity sensitivities[] = { Qt::CaseSensitive, Qt::CaseInsensitive };
+
+    QJsonArray results;
+    for (unsigned t = 0; t < sizeof(texts) / sizeof(texts[0]); t++)
+    {
+        for (unsigned s = 0; s < sizeof(sensitivities) / sizeof(sensitivities[0]); s++)
+        {
+            const QString text = QString::fromLatin1(texts[t]);
+            const Qt::CaseSensitivity sensitivity = sensitivities[s];
+            const LiteralMatcher matcher(text, sensitivity);
+
+            // a single character text is found everywhere, count its matches
+            const CompactCharacter* data = cells.constData();
+            const double vectorized = timeSearch([&]() {
+                int found = 0;
+                for (int x = matcher.indexIn(data, cellCount, 0); x >= 0;
+                     x = matcher.indexIn(data, cellCount, x + matcher.length()))
+                    found++;
+                return found;
+            }, cellCount, iterations);
+            const double scalar = timeSearch([&]() {
+                int found = 0;
+                for (int x = matcher.indexInScalar(data, cellCount, 0); x >= 0;
+                     x = matcher.indexInScalar(data, cellCount, x + matcher.length()))
+                    found++;
+                return found;
+            }, cellCount, iterations);
+            const double decoded = timeSearch([&]() {
+                QString decodedText;
+                decodedText.reserve(cellCount);
+                for (int x = 0; x < cellCount; x++)
+                    decodedText.append(QChar(ushort(data[x].character)));
+                int found = 0;
+                for (int x = decodedText.indexOf(text, 0, sensitivity); x >= 0;
+                     x = decodedText.indexOf(text, x + text.size(), sensitivity))
+                    found++;
+                return found;
+            }, cellCount, iterations);
+
+            QJsonObject result;
+            result[QStringLiteral("text")] = text;
+            result[QStringLiteral("caseSensitive")] = sensitivity == Qt::CaseSensitive;
+            result[QStringLiteral("vectorizedNsPerCell")] = vectorized;
+            result[QStringLiteral("scalarNsPerCell")] = scalar;
+            result[QStringLiteral("decodedNsPerCell")] = decoded;
+            result[QStringLiteral("speedupOverDecoded")] = decoded / qMax(vectorized, 0.001);
+            results.append(result);
+        }
+    }
+
+    QJsonObject report;
+    report[QStringLiteral("qtVersion")] = QString::fromLatin1(qVersion());
+    report[QStringLiteral("iterations")] = iterations;
+    report[QStringLiteral("cells")] = cellCount;
+    report[QStringLiteral("results")] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+    return 0;
+}
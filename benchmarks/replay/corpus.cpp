@@ -0,0 +1,373 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "corpus.h"
+
+// Qt includes
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+namespace
+{
+
+const int MEGABYTE = 1024 * 1024;
+
+// the streams are written for a screen of this size
+const int COLUMNS = 80;
+const int LINES = 24;
+
+/** Small linear congruential generator, so the corpus does not depend on the C library */
+class Random
+{
+public:
+    Random(quint32 seed) : _state(seed) {}
+
+    quint32 next()
+    {
+        _state = _state * 1664525u + 1013904223u;
+        return _state >> 8;
+    }
+
+    int range(int n) { return int(next() % quint32(n)); }
+
+    template <typename T, int N>
+    const T& pick(const T (&items)[N]) { return items[range(N)]; }
+
+private:
+    quint32 _state;
+};
+
+const char* const WORDS[] = {
+    "the", "terminal", "emulation", "screen", "history", "line", "of",
+    "output", "character", "buffer", "and", "a", "to", "is", "with",
+    "program", "process", "window", "session", "cursor", "scroll", "in",
+    "which", "display", "update", "image", "color", "font", "widget"
+};
+
+const char* const NAMES[] = {
+    "libfoo.so.1", "README", "Makefile", "main.cpp", "screen.h", "icons",
+    "share", "include", "x86_64-linux-gnu", "python3.11", "locale",
+    "config.status", "CMakeLists.txt", "build", "doc", "man1", "bin"
+};
+
+const char* const USERS[] = { "root", "jacob", "daemon", "www-data" };
+
+const char* const MONTHS[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+void appendWords(QByteArray& data, Random& random, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0)
+            data += ' ';
+        data += random.pick(WORDS);
+    }
+}
+
+/** Plain text, as written by cat on a large file.  Some lines wrap. */
+QByteArray generateCat(int size)
+{
+    Random random(1);
+    QByteArray data;
+    data.reserve(size + COLUMNS * 4);
+
+    while (data.size() < size)
+    {
+        // mostly short lines, now and then an empty or an overlong one
+        const int kind = random.range(20);
+        if (kind == 0)
+        {
+            data += "\r\n";
+            continue;
+        }
+        appendWords(data, random, kind == 1 ? 40 + random.range(40) : 3 + random.range(10));
+        data += "\r\n";
+    }
+    return data;
+}
+
+/** Recursive colored directory listing, as written by ls -lR --color */
+QByteArray generateListing(int size)
+{
+    Random random(2);
+    QByteArray data;
+    data.reserve(size + COLUMNS * 4);
+
+    while (data.size() < size)
+    {
+        data += "./usr/share/";
+        data += random.pick(NAMES);
+        data += '/';
+        data += random.pick(NAMES);
+        data += ":\r\ntotal ";
+        data += QByteArray::number(random.range(10000));
+        data += "\r\n";
+
+        const int entries = 2 + random.range(30);
+        for (int i = 0; i < entries; i++)
+        {
+            const int kind = random.range(4);
+            data += kind == 0 ? "drwxr-xr-x" : kind == 1 ? "lrwxrwxrwx"
+                  : kind == 2 ? "-rwxr-xr-x" : "-rw-r--r--";
+            data += ' ';
+            data += QByteArray::number(1 + random.range(20)).rightJustified(2);
+            data += ' ';
+            const char* user = random.pick(USERS);
+            data += QByteArray(user).leftJustified(8);
+            data += QByteArray(user).leftJustified(8);
+            data += QByteArray::number(random.range(1 << 20)).rightJustified(8);
+            data += ' ';
+            data += random.pick(MONTHS);
+            data += ' ';
+            data += QByteArray::number(1 + random.range(28)).rightJustified(2);
+            data += ' ';
+            data += QByteArray::number(random.range(24)).rightJustified(2, '0');
+            data += ':';
+            data += QByteArray::number(random.range(60)).rightJustified(2, '0');
+            data += ' ';
+
+            switch (kind)
+            {
+            case 0: data += "\033[01;34m"; break;
+            case 1: data += "\033[01;36m"; break;
+            case 2: data += "\033[01;32m"; break;
+            default: data += "\033[0m"; break;
+            }
+            data += random.pick(NAMES);
+            data += "\033[0m";
+            if (kind == 1)
+            {
+                data += " -> ";
+                data += random.pick(NAMES);
+            }
+            data += "\r\n";
+        }
+        data += "\r\n";
+    }
+    return data;
+}
+
+/** Build progress and diagnostics with the colors used by make and gcc */
+QByteArray generateCompilerLog(int size)
+{
+    Random random(3);
+    QByteArray data;
+    data.reserve(size + COLUMNS * 16);
+
+    int percent = 0;
+    while (data.size() < size)
+    {
+        const char* file = random.pick(NAMES);
+
+        data += "[";
+        data += QByteArray::number(percent).rightJustified(3);
+        data += "%] \033[32mBuilding CXX object src/CMakeFiles/qtterminalwidget.dir/";
+        data += file;
+        data += ".o\033[0m\r\n";
+        percent = (percent + 1) % 101;
+
+        if (random.range(3) != 0)
+            continue;
+
+        const QByteArray line = QByteArray::number(1 + random.range(2000));
+        const QByteArray column = QByteArray::number(1 + random.range(60));
+        const bool error = random.range(4) == 0;
+
+        data += "\033[01m\033[Ksrc/";
+        data += file;
+        data += ':' + line + ':' + column + ":\033[m\033[K ";
+        data += error ? "\033[01;31m\033[Kerror: " : "\033[01;35m\033[Kwarning: ";
+        data += "\033[m\033[Kunused variable '\033[01m\033[K";
+        data += random.pick(WORDS);
+        data += "\033[m\033[K' [";
+        data += error ? "\033[01;31m\033[K-Werror" : "\033[01;35m\033[K-Wunused-variable";
+        data += "\033[m\033[K]\r\n";
+
+        data += line.rightJustified(5) + " |     ";
+        appendWords(data, random, 2);
+        data += " \033[01;35m\033[K";
+        data += random.pick(WORDS);
+        data += "\033[m\033[K = ";
+        appendWords(data, random, 3);
+        data += ";\r\n      |         \033[01;35m\033[K^~~~~\033[m\033[K\r\n";
+    }
+    return data;
+}
+
+/**
+ * Full screen redraws on the alternate screen: htop style frames which
+ * position the cursor for every line, alternating with vim style updates
+ * which scroll a region and repaint the status line.
+ */
+QByteArray generateFullScreen(int size)
+{
+    Random random(4);
+    QByteArray data;
+    data.reserve(size + COLUMNS * LINES * 8);
+
+    data += "\033[?1049h\033[?25l\033[H\033[2J";
+    while (data.size() < size)
+    {
+        // htop: meters, header and process table
+        for (int row = 1; row <= LINES; row++)
+        {
+            data += "\033[" + QByteArray::number(row) + ";1H";
+            if (row <= 4)
+            {
+                const int used = random.range(40);
+                data += "\033[1m" + QByteArray::number(row).rightJustified(3) + "\033[0m[";
+                data += "\033[32m" + QByteArray(used, '|');
+                data += "\033[31m" + QByteArray(random.range(40 - used + 1), '|');
+                data += "\033[0m\033[K";
+            }
+            else if (row == 5)
+            {
+                data += "\033[30;42m  PID USER      PRI  NI  VIRT   RES   SHR S CPU% MEM%   TIME+  Command\033[K\033[0m";
+            }
+            else
+            {
+                data += QByteArray::number(random.range(99999)).rightJustified(5) + ' ';
+                data += QByteArray(random.pick(USERS)).leftJustified(9) + "  20   0 ";
+                data += "\033[36m" + QByteArray::number(random.range(999)) + "M\033[0m ";
+                data += QByteArray::number(random.range(99)).rightJustified(4) + ".0 ";
+                data += "\033[1;32mR\033[0m ";
+                data += QByteArray::number(random.range(100)).rightJustified(4) + "  0:00.00  ";
+                data += random.pick(NAMES);
+                data += "\033[K";
+            }
+        }
+
+        // vim: scroll the text area, draw the new line and the status line
+        for (int step = 0; step < 8; step++)
+        {
+            data += "\033[1;" + QByteArray::number(LINES - 1) + "r";
+            if (random.range(2))
+                data += "\033[" + QByteArray::number(LINES - 1) + ";1H\r\n";
+            else
+                data += "\033[1;1H\033[1L";
+            data += "\033[r\033[33m" + QByteArray::number(random.range(5000)).rightJustified(4) + "\033[0m ";
+            appendWords(data, random, 2 + random.range(8));
+            data += "\033[K\033[" + QByteArray::number(LINES) + ";1H\033[7m";
+            data += QByteArray(random.pick(NAMES)).leftJustified(COLUMNS - 20);
+            data += QByteArray::number(random.range(5000)).rightJustified(10) + ",1        All\033[27m";
+        }
+    }
+    data += "\033[?25h\033[?1049l";
+    return data;
+}
+
+/** Log lines in which every word has another of the 256 colors */
+QByteArray generateColorLog(int size)
+{
+    Random random(6);
+    QByteArray data;
+    data.reserve(size + COLUMNS * 16);
+
+    while (data.size() < size)
+    {
+        data += "\033[38;5;" + QByteArray::number(random.range(256)) + "m";
+        data += QByteArray(random.pick(MONTHS)) + ' ' + QByteArray::number(1 + random.range(28));
+        const int count = 3 + random.range(10);
+        for (int i = 0; i < count; i++)
+        {
+            data += "\033[38;5;" + QByteArray::number(random.range(256)) + "m ";
+            data += random.pick(WORDS);
+        }
+        data += "\033[0m\r\n";
+    }
+    return data;
+}
+
+/** Wide CJK characters, combining marks and other non-ASCII text */
+QByteArray generateUnicode(int size)
+{
+    Random random(5);
+    const QByteArray phrases[] = {
+        QByteArray(u8"漢字仮名交じり文"),
+        QByteArray(u8"中文字符显示测试"),
+        QByteArray(u8"한국어 텍스트 출력"),
+        QByteArray(u8"ｶﾀｶﾅ ﾃｷｽﾄ"),
+        QByteArray(u8"Ελληνικά κείμενα"),
+        QByteArray(u8"e\u0301te\u0301 nai\u0308ve"),
+        QByteArray(u8"a\u0300\u0316 o\u0323\u0302 u\u0308\u0304"),
+        QByteArray(u8"日本語のテキスト")
+    };
+
+    QByteArray data;
+    data.reserve(size + COLUMNS * 16);
+
+    while (data.size() < size)
+    {
+        // long enough lines that wide characters end up at the right margin
+        const int count = 2 + random.range(12);
+        for (int i = 0; i < count; i++)
+        {
+            if (i > 0)
+                data += ' ';
+            data += random.pick(phrases);
+        }
+        data += "\r\n";
+    }
+    return data;
+}
+
+} // namespace
+
+QList<Scenario> builtinScenarios(int scale)
+{
+    scale = qMax(1, scale);
+
+    QList<Scenario> scenarios;
+    scenarios << Scenario{ QStringLiteral("cat"), generateCat(8 * MEGABYTE * scale) };
+    scenarios << Scenario{ QStringLiteral("ls-lR"), generateListing(4 * MEGABYTE * scale) };
+    scenarios << Scenario{ QStringLiteral("compiler-log"), generateCompilerLog(4 * MEGABYTE * scale) };
+    scenarios << Scenario{ QStringLiteral("fullscreen"), generateFullScreen(4 * MEGABYTE * scale) };
+    scenarios << Scenario{ QStringLiteral("cjk-combining"), generateUnicode(4 * MEGABYTE * scale) };
+    scenarios << Scenario{ QStringLiteral("color256-log"), generateColorLog(4 * MEGABYTE * scale) };
+    return scenarios;
+}
+
+QList<Scenario> loadScenarios(const QString& directory)
+{
+    QList<Scenario> scenarios;
+
+    QDir dir(directory);
+    const QFileInfoList files = dir.entryInfoList(QDir::Files | QDir::Readable, QDir::Name);
+    foreach (const QFileInfo& info, files)
+    {
+        QFile file(info.filePath());
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Unable to open" << info.filePath();
+            continue;
+        }
+        scenarios << Scenario{ info.fileName(), file.readAll() };
+    }
+    return scenarios;
+}
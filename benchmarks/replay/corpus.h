@@ -0,0 +1,55 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Qt includes
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/**
+ * A stream of bytes as written by a program to the terminal, together with
+ * the name it is reported under.
+ */
+struct Scenario
+{
+    QString name;
+    QByteArray data;
+};
+
+/**
+ * Returns the built-in scenarios.  The streams mimic what the programs they
+ * are named after write to a pty, including the CR LF line endings added by
+ * the terminal driver.  They are generated from a fixed seed, so every run
+ * replays exactly the same bytes.
+ *
+ * @param scale Multiplies the size of each stream, 1 gives a few MB each.
+ */
+QList<Scenario> builtinScenarios(int scale = 1);
+
+/**
+ * Loads captured streams from @p directory, one scenario per file.  The
+ * scenarios are named after the files.  Returns an empty list if the
+ * directory cannot be read.
+ */
+QList<Scenario> loadScenarios(const QString& directory);
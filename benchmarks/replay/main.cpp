@@ -0,0 +1,417 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Replays streams of terminal output through Vt102Emulation and its
+ * screens, without a TerminalDisplay, and reports for every stream the
+ * throughput, the number of heap allocations and the peak resident set
+ * size as JSON.  See README.md in this directory.
+ */
+
+// Own includes
+#include "corpus.h"
+#include "history.h"
+#include "historyindex.h"
+#include "terminalcharacterdecoder.h"
+#include "vt102emulation.h"
+
+// System includes
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+// Qt includes
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextCodec>
+#include <QTextStream>
+
+//////////////////////////////////////////////////////////////////////
+// Allocation counting
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+std::atomic<quint64> allocationCount(0);
+std::atomic<quint64> allocatedBytes(0);
+
+void countAllocation(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+}
+
+#ifdef __GLIBC__
+// Qt's containers allocate with malloc() rather than operator new, so the
+// allocator itself is wrapped.  glibc exports its implementation under these
+// names.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void  __libc_free(void* pointer);
+
+void* malloc(size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer)
+{
+    __libc_free(pointer);
+}
+}
+#else
+// elsewhere only the allocations made with operator new are counted
+void* operator new(size_t size)
+{
+    countAllocation(size);
+    if (void* pointer = malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    free(pointer);
+}
+#endif
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////
+// Resident set size
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Resets the peak resident set size of the process to its current size, so
+ * peakResidentSetSize() covers one scenario only.  Returns false where this
+ * is not supported; the peak then covers the whole run up to now.
+ */
+bool resetPeakResidentSetSize()
+{
+    QFile file(QStringLiteral("/proc/self/clear_refs"));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write("5") == 1;
+}
+
+/** Returns the peak resident set size of the process in KiB */
+qint64 peakResidentSetSize()
+{
+    QFile file(QStringLiteral("/proc/self/status"));
+    if (file.open(QIODevice::ReadOnly))
+    {
+        foreach (const QByteArray& line, file.readAll().split('\n'))
+        {
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+    return -1;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Replay
+//////////////////////////////////////////////////////////////////////
+
+struct ReplayOptions
+{
+    QString history;
+    int indexKiB;
+    int columns;
+    int lines;
+    int chunkSize;
+    int repeat;
+};
+
+/** Creates the history type described by @p spec, eg. "buffer:1000" */
+HistoryType* createHistoryType(const QString& spec)
+{
+    const QString kind = spec.section(QLatin1Char(':'), 0, 0);
+    bool ok = true;
+    const int size = spec.contains(QLatin1Char(':'))
+            ? spec.section(QLatin1Char(':'), 1).toInt(&ok) : 1000;
+    if (!ok || size < 0)
+        return 0;
+
+    if (kind == QLatin1String("none"))
+        return new HistoryTypeNone();
+    if (kind == QLatin1String("buffer"))
+        return new HistoryTypeBuffer(size);
+    if (kind == QLatin1String("compact"))
+        return new CompactHistoryType(size);
+    if (kind == QLatin1String("compressed"))
+        return new CompressedHistoryType(size);
+    if (kind == QLatin1String("tiered"))
+        return new CompressedHistoryType(0, size_t(size) * 1024);
+    if (kind == QLatin1String("blockarray"))
+        return new HistoryTypeBlockArray(size);
+    if (kind == QLatin1String("file"))
+        return new HistoryTypeFile();
+    return 0;
+}
+
+QJsonObject replay(const Scenario& scenario, const HistoryType& historyType,
+                   const ReplayOptions& options)
+{
+    QTextCodec* utf8 = QTextCodec::codecForName("UTF-8");
+
+    qint64 bestTime = -1;
+    quint64 allocations = 0;
+    quint64 bytesAllocated = 0;
+    int lineCount = 0;
+    qint64 historyReadTime = -1;
+    double indexBytes = 0;
+    double indexedLines = 0;
+
+    const bool perScenarioPeak = resetPeakResidentSetSize();
+
+    for (int run = 0; run < options.repeat; run++)
+    {
+        std::unique_ptr<Vt102Emulation> emulation(new Vt102Emulation());
+        emulation->setCodec(utf8);
+        emulation->setImageSize(options.lines, options.columns);
+        emulation->setHistory(historyType);
+        emulation->setHistoryIndexMemoryLimit(size_t(options.indexKiB) * 1024);
+
+        const quint64 allocationsBefore = allocationCount.load();
+        const quint64 bytesBefore = allocatedBytes.load();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        const char* data = scenario.data.constData();
+        const int size = scenario.data.size();
+        for (int offset = 0; offset < size; offset += options.chunkSize)
+        {
+            // one chunk per read from the pty, with the event loop in between
+            emulation->receiveData(data + offset, qMin(options.chunkSize, size - offset));
+            QCoreApplication::processEvents();
+        }
+
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (bestTime < 0 || elapsed < bestTime)
+            bestTime = elapsed;
+
+        // every run replays the same bytes, so the counts of the last run stand for all
+        allocations = allocationCount.load() - allocationsBefore;
+        bytesAllocated = allocatedBytes.load() - bytesBefore;
+        lineCount = emulation->lineCount();
+
+        if (const HistoryIndex* index = emulation->historyIndex())
+        {
+            indexBytes = double(index->memoryUsage());
+            indexedLines = double(index->endLine() - index->firstLine());
+        }
+
+        // read everything back, like saving or searching the output does
+        QString text;
+        QTextStream stream(&text);
+        PlainTextDecoder decoder;
+        decoder.begin(&stream);
+        timer.restart();
+        emulation->writeToStream(&decoder, 0, lineCount - 1);
+        const qint64 readTime = timer.nsecsElapsed();
+        decoder.end();
+        if (historyReadTime < 0 || readTime < historyReadTime)
+            historyReadTime = readTime;
+    }
+
+    const double seconds = qMax<qint64>(bestTime, 1) / 1e9;
+
+    QJsonObject result;
+    result[QStringLiteral("name")] = scenario.name;
+    result[QStringLiteral("bytes")] = double(scenario.data.size());
+    result[QStringLiteral("seconds")] = seconds;
+    result[QStringLiteral("mbPerSecond")] = scenario.data.size() / 1e6 / seconds;
+    result[QStringLiteral("historyReadSeconds")] = historyReadTime / 1e9;
+    result[QStringLiteral("allocations")] = double(allocations);
+    result[QStringLiteral("allocatedBytes")] = double(bytesAllocated);
+    result[QStringLiteral("peakRssKiB")] = double(peakResidentSetSize());
+    result[QStringLiteral("peakRssPerScenario")] = perScenarioPeak;
+    result[QStringLiteral("lines")] = lineCount;
+    if (options.indexKiB > 0)
+    {
+        result[QStringLiteral("indexBytes")] = indexBytes;
+        result[QStringLiteral("indexedLines")] = indexedLines;
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("replay"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Replays terminal output through the emulation and reports throughput, "
+        "allocations and peak memory use as JSON."));
+    parser.addHelpOption();
+
+    QCommandLineOption historyOption(QStringLiteral("history"),
+        QStringLiteral("History type: none, buffer:<lines>, compact:<lines>, "
+                       "compressed:<lines>, tiered:<KB in memory>, blockarray:<lines> or file "
+                       "(default: buffer:1000)."),
+        QStringLiteral("type"), QStringLiteral("buffer:1000"));
+    QCommandLineOption indexOption(QStringLiteral("index"),
+        QStringLiteral("Keep a search index of the history of up to <KB> (default: 0, none)."),
+        QStringLiteral("KB"), QStringLiteral("0"));
+    QCommandLineOption sizeOption(QStringLiteral("size"),
+        QStringLiteral("Screen size in columns and lines (default: 80x24)."),
+        QStringLiteral("columnsxlines"), QStringLiteral("80x24"));
+    QCommandLineOption chunkOption(QStringLiteral("chunk"),
+        QStringLiteral("Bytes passed to the emulation at once (default: 4096)."),
+        QStringLiteral("bytes"), QStringLiteral("4096"));
+    QCommandLineOption repeatOption(QStringLiteral("repeat"),
+        QStringLiteral("Replays of each scenario, the fastest is reported (default: 3)."),
+        QStringLiteral("count"), QStringLiteral("3"));
+    QCommandLineOption scaleOption(QStringLiteral("scale"),
+        QStringLiteral("Size multiplier for the built-in scenarios (default: 1)."),
+        QStringLiteral("factor"), QStringLiteral("1"));
+    QCommandLineOption corpusOption(QStringLiteral("corpus"),
+        QStringLiteral("Replay the captured streams in <directory> instead of the built-in ones."),
+        QStringLiteral("directory"));
+    QCommandLineOption scenarioOption(QStringLiteral("scenario"),
+        QStringLiteral("Only replay the scenario called <name>. May be given more than once."),
+        QStringLiteral("name"));
+    QCommandLineOption outputOption(QStringLiteral("output"),
+        QStringLiteral("Write the report to <file> instead of standard output."),
+        QStringLiteral("file"));
+    parser.addOption(historyOption);
+    parser.addOption(indexOption);
+    parser.addOption(sizeOption);
+    parser.addOption(chunkOption);
+    parser.addOption(repeatOption);
+    parser.addOption(scaleOption);
+    parser.addOption(corpusOption);
+    parser.addOption(scenarioOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    ReplayOptions options;
+    options.history = parser.value(historyOption);
+    options.indexKiB = parser.value(indexOption).toInt();
+    options.columns = parser.value(sizeOption).section(QLatin1Char('x'), 0, 0).toInt();
+    options.lines = parser.value(sizeOption).section(QLatin1Char('x'), 1, 1).toInt();
+    options.chunkSize = parser.value(chunkOption).toInt();
+    options.repeat = parser.value(repeatOption).toInt();
+
+    if (options.columns <= 0 || options.lines <= 0 || options.chunkSize <= 0 || options.repeat <= 0 ||
+        options.indexKiB < 0)
+    {
+        fprintf(stderr, "Invalid --size, --chunk, --repeat or --index\n");
+        return 1;
+    }
+
+    std::unique_ptr<HistoryType> historyType(createHistoryType(options.history));
+    if (!historyType)
+    {
+        fprintf(stderr, "Unknown history type '%s'\n", qPrintable(options.history));
+        return 1;
+    }
+
+    QList<Scenario> scenarios = parser.isSet(corpusOption)
+            ? loadScenarios(parser.value(corpusOption))
+            : builtinScenarios(parser.value(scaleOption).toInt());
+
+    const QStringList selected = parser.values(scenarioOption);
+    QJsonArray results;
+    foreach (const Scenario& scenario, scenarios)
+    {
+        if (!selected.isEmpty() && !selected.contains(scenario.name))
+            continue;
+        results.append(replay(scenario, *historyType, options));
+    }
+
+    if (results.isEmpty())
+    {
+        fprintf(stderr, "No scenarios to replay\n");
+        return 1;
+    }
+
+    QJsonObject report;
+    report[QStringLiteral("qtVersion")] = QString::fromLatin1(qVersion());
+    report[QStringLiteral("history")] = options.history;
+    report[QStringLiteral("indexKiB")] = options.indexKiB;
+    report[QStringLiteral("columns")] = options.columns;
+    report[QStringLiteral("lines")] = options.lines;
+    report[QStringLiteral("chunkSize")] = options.chunkSize;
+    report[QStringLiteral("repeat")] = options.repeat;
+    report[QStringLiteral("scenarios")] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            fprintf(stderr, "Unable to write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    }
+    else
+    {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+# Replay benchmark for the emulation pipeline.
+# See ../benchmarks.pro for how to build it.
+
+include(../benchmark.pri)
+
+TARGET = replay
+
+HEADERS += \
+    corpus.h
+SOURCES += \
+    main.cpp \
+    corpus.cpp
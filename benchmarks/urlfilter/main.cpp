@@ -0,0 +1,235 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+ * Times UrlFilter, which finds URLs with a compiled expression shared by
+ * all filters, against the same filter on QRegExp, which is what it used
+ * before, over a screen of log text, and reports the results as JSON.
+ * See README.md in this directory.
+ */
+
+// Own includes
+#include "filter.h"
+
+// System includes
+#include <stdio.h>
+
+// Qt includes
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegExp>
+
+namespace
+{
+
+// UrlFilter as it was before, on QRegExp
+class QRegExpUrlFilter : public Filter
+{
+public:
+    QRegExpUrlFilter()
+        : _regExp(QStringLiteral("((www\\.(?!\\.)|[a-z][a-z0-9+.-]*://)[^\\s<>'\"]+[^!,\\.\\s<>'\"\\]]|"
+                                 "\\b(\\w|\\.|-)+@(\\w|\\.|-)+\\.\\w+\\b)"))
+    {
+    }
+
+    virtual void process()
+    {
+        const QString* text = buffer();
+        if (_regExp.exactMatch(QString()))
+            return;
+
+        int pos = 0;
+        while (pos >= 0)
+        {
+            pos = _regExp.indexIn(*text, pos);
+            if (pos >= 0)
+            {
+                int startLine, startColumn, endLine, endColumn;
+                getLineColumn(pos, startLine, startColumn);
+                getLineColumn(pos + _regExp.matchedLength(), endLine, endColumn);
+
+                RegExpFilter::HotSpot* spot = new UrlFilter::HotSpot(startLine, startColumn,
+                                                                     endLine, endColumn);
+                spot->setCapturedTexts(_regExp.capturedTexts());
+                addHotSpot(spot);
+
+                pos += _regExp.matchedLength();
+                if (_regExp.matchedLength() == 0)
+                    pos = -1;
+            }
+        }
+    }
+
+private:
+    QRegExp _regExp;
+};
+
+const char* const WORDS[] = {
+    "INFO", "WARN", "ERROR", "connection", "from", "request", "completed", "in", "ms",
+    "user", "session", "timeout", "retrying", "GET", "/api/v1/items", "200", "404",
+    "worker-3", "2015-06-01T12:00:00Z", "[main]", "->", "ok"
+};
+
+const char* const LINKS[] = {
+    "https://example.org/path/to/page?query=1", "www.example.com/docs", "ftp://mirror.example.net/pub/",
+    "admin@example.org", "first.last-name@mail.example.co.uk"
+};
+
+/**
+ * Returns @p lines lines of log text, each of at most @p columns
+ * characters and followed by a new line, and stores where the lines start
+ * in @p linePositions, like TerminalImageFilterChain does for a screen
+ */
+QString logText(int lines, int columns, int linksPerLine, QList<int>& linePositions)
+{
+    QString text;
+    quint32 seed = 1;
+    for (int line = 0; line < lines; line++)
+    {
+        linePositions.append(text.size());
+        QString lineText;
+        int links = 0;
+        while (lineText.size() < columns)
+        {
+            seed = seed * 1103515245 + 12345;
+            const quint32 random = seed >> 16;
+            if (links < linksPerLine && random % 8 == 0)
+            {
+                lineText += QLatin1String(LINKS[random % (sizeof(LINKS) / sizeof(LINKS[0]))]);
+                links++;
+            }
+            else
+            {
+                lineText += QLatin1String(WORDS[random % (sizeof(WORDS) / sizeof(WORDS[0]))]);
+            }
+            lineText += QLatin1Char(' ');
+        }
+        text += lineText.left(columns);
+        text += QLatin1Char('\n');
+    }
+    return text;
+}
+
+/** Returns the microseconds per screen of the fastest of three runs of @p filter, and its hotspots in @p hotSpots */
+double timeFilter(Filter& filter, const QString& text, const QList<int>& linePositions,
+                  int iterations, int& hotSpots)
+{
+    filter.setBuffer(&text, &linePositions);
+
+    qint64 best = -1;
+    for (int run = 0; run < 3; run++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++)
+        {
+            qDeleteAll(filter.hotSpots());
+            filter.reset();
+            filter.process();
+        }
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    hotSpots = filter.hotSpots().size();
+    qDeleteAll(filter.hotSpots());
+    filter.reset();
+    return double(best) / iterations / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("urlfilter"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+        "Times the URL detection in a screen of log text and reports the results as JSON."));
+    parser.addHelpOption();
+
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+        QStringLiteral("Screens processed per measurement (default: 200)."),
+        QStringLiteral("count"), QStringLiteral("200"));
+    QCommandLineOption linesOption(QStringLiteral("lines"),
+        QStringLiteral("Lines of the screen (default: 60)."),
+        QStringLiteral("count"), QStringLiteral("60"));
+    QCommandLineOption columnsOption(QStringLiteral("columns"),
+        QStringLiteral("Columns of the screen (default: 200)."),
+        QStringLiteral("count"), QStringLiteral("200"));
+    parser.addOption(iterationsOption);
+    parser.addOption(linesOption);
+    parser.addOption(columnsOption);
+    parser.process(app);
+
+    const int iterations = parser.value(iterationsOption).toInt();
+    const int lines = parser.value(linesOption).toInt();
+    const int columns = parser.value(columnsOption).toInt();
+    if (iterations <= 0 || lines <= 0 || columns <= 0)
+    {
+        fprintf(stderr, "Invalid --iterations, --lines or --columns\n");
+        return 1;
+    }
+
+    // a screen without links, where every candidate fails, and two with links
+    const int linksPerLine[] = { 0, 1, 3 };
+
+    QJsonArray results;
+    for (unsigned i = 0; i < sizeof(linksPerLine) / sizeof(linksPerLine[0]); i++)
+    {
+        QList<int> linePositions;
+        const QString text = logText(lines, columns, linksPerLine[i], linePositions);
+
+        QRegExpUrlFilter oldFilter;
+        UrlFilter newFilter;
+        int oldHotSpots = 0;
+        int newHotSpots = 0;
+        const double oldTime = timeFilter(oldFilter, text, linePositions, iterations, oldHotSpots);
+        const double newTime = timeFilter(newFilter, text, linePositions, iterations, newHotSpots);
+
+        QJsonObject result;
+        result[QStringLiteral("linksPerLine")] = linksPerLine[i];
+        result[QStringLiteral("qRegExpUsPerScreen")] = oldTime;
+        result[QStringLiteral("compiledUsPerScreen")] = newTime;
+        result[QStringLiteral("speedup")] = oldTime / qMax(newTime, 0.001);
+        result[QStringLiteral("qRegExpHotSpots")] = oldHotSpots;
+        result[QStringLiteral("compiledHotSpots")] = newHotSpots;
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report[QStringLiteral("qtVersion")] = QString::fromLatin1(qVersion());
+    report[QStringLiteral("iterations")] = iterations;
+    report[QStringLiteral("lines")] = lines;
+    report[QStringLiteral("columns")] = columns;
+    report[QStringLiteral("results")] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+    return 0;
+}
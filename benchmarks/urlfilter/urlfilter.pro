@@ -0,0 +1,9 @@
+# Benchmark of the URL detection in a screen of text.
+# See ../benchmarks.pro for how to build it.
+
+include(../benchmark.pri)
+
+TARGET = urlfilter
+
+SOURCES += \
+    main.cpp
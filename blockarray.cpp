@@ -53,7 +53,7 @@ BlockArray::BlockArray()
 {
     // lastmap_index = index = current = size_t(-1);
     if (blocksize == 0) {
-        blocksize = ((sizeof(Block) / getpagesize()) + 1) * getpagesize();
+        blocksize = ((sizeof(Block) + getpagesize() - 1) / getpagesize()) * getpagesize();
     }
 
 }
@@ -106,6 +106,10 @@ size_t BlockArray::newBlock()
         return size_t(-1);
     }
     append(lastblock);
+    // if the block could not be written, the history has been turned off
+    if (!size) {
+        return size_t(-1);
+    }
 
     lastblock = new Block();
     return index + 1;
@@ -137,21 +141,18 @@ const Block * BlockArray::at(size_t i)
         return lastblock;
     }
 
-    if (i == lastmap_index) {
-        return lastmap;
-    }
-
-    if (i > index) {
-        qDebug() << "BlockArray::at() i > index\n";
+    if (!has(i)) {
+        qDebug() << "BlockArray::at() block" << i << "is not available";
         return 0;
     }
 
-    //     if (index - i >= length) {
-    //         kDebug(1211) << "BlockArray::at() index - i >= length\n";
-    //         return 0;
-    //     }
+    if (i == lastmap_index) {
+        return lastmap;
+    }
 
-    size_t j = i; // (current - (index - i) + (index/size+1)*size) % size ;
+    // blocks are written round robin, the size does not change once
+    // blocks have been added
+    size_t j = i % size;
 
     assert(j < size);
     unmap();
@@ -204,6 +205,8 @@ bool BlockArray::setHistorySize(size_t newsize)
         }
         ion = -1;
         current = size_t(-1);
+        size = 0;
+        length = 0;
         return true;
     }
 
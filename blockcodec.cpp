@@ -0,0 +1,216 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own includes
+#include "blockcodec.h"
+
+// System includes
+#include <string.h>
+#include <stdint.h>
+
+namespace
+{
+const int MIN_MATCH = 4;
+// the last 5 bytes are always literals and no match starts in the last 12
+// bytes, as the LZ4 block format requires
+const int LAST_LITERALS = 5;
+const int MATCH_LIMIT = 12;
+const int MAX_OFFSET = 65535;
+const int HASH_BITS = 12;
+
+inline uint32_t read32(const char* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline int hash(uint32_t value)
+{
+    return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// writes the extra bytes of a length which did not fit into the token
+inline char* writeLength(char* dest, int length)
+{
+    for (; length >= 255; length -= 255)
+        *dest++ = (char)255;
+    *dest++ = (char)length;
+    return dest;
+}
+
+// writes a sequence of 'literalCount' literals and a match, if 'matchLength' is not 0
+char* writeSequence(char* dest, const char* literals, int literalCount,
+                    int offset, int matchLength)
+{
+    char* token = dest++;
+    const int literalToken = literalCount < 15 ? literalCount : 15;
+    if (literalCount >= 15)
+        dest = writeLength(dest, literalCount - 15);
+    if (literalCount > 0)
+        memcpy(dest, literals, literalCount);
+    dest += literalCount;
+
+    int matchToken = 0;
+    if (matchLength > 0)
+    {
+        *dest++ = (char)(offset & 0xff);
+        *dest++ = (char)(offset >> 8);
+        const int length = matchLength - MIN_MATCH;
+        matchToken = length < 15 ? length : 15;
+        if (length >= 15)
+            dest = writeLength(dest, length - 15);
+    }
+
+    *token = (char)((literalToken << 4) | matchToken);
+    return dest;
+}
+}
+
+int compressBlockBound(int size)
+{
+    return size + size / 255 + 16;
+}
+
+int compressBlock(const char* source, int size, char* dest, int capacity)
+{
+    if (capacity < compressBlockBound(size))
+        return 0;
+
+    int table[1 << HASH_BITS];
+    memset(table, -1, sizeof(table));
+
+    const char* const end = source + size;
+    const char* literals = source;
+    const char* p = source;
+    char* out = dest;
+
+    // shorter input is stored as literals, 'end - MATCH_LIMIT' would point
+    // before it
+    const char* const matchLimit = size > MATCH_LIMIT ? end - MATCH_LIMIT : source;
+    while (p < matchLimit)
+    {
+        const uint32_t value = read32(p);
+        const int h = hash(value);
+        const int candidate = table[h];
+        table[h] = p - source;
+
+        if (candidate < 0 || (p - source) - candidate > MAX_OFFSET ||
+            read32(source + candidate) != value)
+        {
+            p++;
+            continue;
+        }
+
+        // extend the match, leaving the last literals alone
+        const char* match = source + candidate;
+        const char* matchEnd = p + MIN_MATCH;
+        const char* reference = match + MIN_MATCH;
+        while (matchEnd < end - LAST_LITERALS && *matchEnd == *reference)
+        {
+            matchEnd++;
+            reference++;
+        }
+
+        out = writeSequence(out, literals, p - literals, p - match, matchEnd - p);
+        p = literals = matchEnd;
+    }
+
+    out = writeSequence(out, literals, end - literals, 0, 0);
+    return out - dest;
+}
+
+bool decompressBlock(const char* source, int size, char* dest, int decompressedSize)
+{
+    const unsigned char* in = (const unsigned char*)source;
+    const unsigned char* const inEnd = in + size;
+    char* out = dest;
+    char* const outEnd = dest + decompressedSize;
+
+    while (in < inEnd)
+    {
+        const int token = *in++;
+
+        int literalCount = token >> 4;
+        if (literalCount == 15)
+        {
+            int extra;
+            do
+            {
+                if (in >= inEnd)
+                    return false;
+                extra = *in++;
+                literalCount += extra;
+            } while (extra == 255);
+        }
+
+        if (literalCount > inEnd - in || literalCount > outEnd - out)
+            return false;
+        memcpy(out, in, literalCount);
+        in += literalCount;
+        out += literalCount;
+
+        // the last sequence has no match
+        if (in == inEnd)
+            break;
+
+        if (inEnd - in < 2)
+            return false;
+        const int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out - dest)
+            return false;
+
+        int matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            int extra;
+            do
+            {
+                if (in >= inEnd)
+                    return false;
+                extra = *in++;
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > outEnd - out)
+            return false;
+
+        // the match may overlap the bytes it produces, so copy bytewise
+        // unless the source is far enough behind
+        const char* match = out - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        }
+        else
+        {
+            for (int i = 0; i < matchLength; i++)
+                *out++ = *match++;
+        }
+    }
+
+    return out == outEnd;
+}
@@ -0,0 +1,51 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+#pragma once
+
+/**
+ * A fast, byte oriented block compressor for the history.
+ *
+ * The compressed data uses the LZ4 block format: sequences of literals
+ * followed by a back reference of at least 4 bytes into the last 64KB.
+ * Compression is greedy with a small hash table, which trades some ratio
+ * for speed; the output of terminal programs is repetitive enough for this
+ * to work well.
+ */
+
+/** Returns the largest possible compressed size of @p size bytes. */
+int compressBlockBound(int size);
+
+/**
+ * Compresses @p size bytes from @p source into @p dest, which has room
+ * for @p capacity bytes.  Returns the compressed size, or 0 if the
+ * result does not fit into @p dest.
+ */
+int compressBlock(const char* source, int size, char* dest, int capacity);
+
+/**
+ * Decompresses @p size bytes of compressed data from @p source into
+ * @p dest, which must have room for the @p decompressedSize bytes which
+ * were compressed.  Returns false if the data is corrupt.
+ */
+bool decompressBlock(const char* source, int size, char* dest, int decompressedSize);
@@ -0,0 +1,179 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "characterstyle.h"
+
+// System includes
+#include <string.h>
+
+uint qHash(const CharacterStyle& style, uint seed)
+{
+    // a CharacterColor is four bytes without padding
+    quint32 foreground;
+    quint32 background;
+    memcpy(&foreground, &style.foregroundColor, sizeof(foreground));
+    memcpy(&background, &style.backgroundColor, sizeof(background));
+
+    return qHash((quint64(foreground) << 32) | background, seed) ^ style.rendition;
+}
+
+CharacterStyleTable::CharacterStyleTable()
+    : _lastIndex(0),
+      _compactAt(COMPACT_THRESHOLD)
+{
+    insert(CharacterStyle());
+}
+
+QVector<quint32> CharacterStyleTable::compact(const QBitArray& used)
+{
+    QVector<quint32> indexes(_styles.count(), 0);
+    QVector<CharacterStyle> styles;
+    styles.reserve(_styles.count());
+    styles.append(CharacterStyle());
+    _indexes.clear();
+    _indexes.insert(CharacterStyle(), 0);
+
+    for (int i = 1; i < _styles.count(); i++)
+    {
+        if (i >= used.size() || !used.testBit(i))
+            continue;
+        indexes[i] = styles.count();
+        _indexes.insert(_styles.at(i), indexes[i]);
+        styles.append(_styles.at(i));
+    }
+
+    styles.squeeze();
+    _styles = styles;
+    _lastIndex = 0;
+
+    // compacting again only pays off once as many styles have been added
+    _compactAt = qMax<int>(COMPACT_THRESHOLD, _styles.count() * 2);
+    return indexes;
+}
+
+size_t CharacterStyleTable::memoryUsage() const
+{
+    // a QHash node holds the next node and the hash besides the key and
+    // the value, a bucket is a pointer to a node
+    const size_t node = sizeof(void*) + sizeof(uint) + sizeof(CharacterStyle) + sizeof(quint32);
+    return _styles.capacity()*sizeof(CharacterStyle) +
+           _indexes.capacity()*sizeof(void*) + _indexes.size()*node;
+}
+
+void CharacterStyleTable::clear()
+{
+    *this = CharacterStyleTable();
+}
+
+void CharacterStyleTable::markStyles(const CompactCharacter* cells, int count, QBitArray& used)
+{
+    // styles come in runs, so only mark a style when it changes
+    quint32 style = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (cells[i].style != style)
+        {
+            style = cells[i].style;
+            used.setBit(style);
+        }
+    }
+}
+
+void CharacterStyleTable::renumberStyles(CompactCharacter* cells, int count, const QVector<quint32>& indexes)
+{
+    for (int i = 0; i < count; i++)
+        cells[i].style = indexes.at(cells[i].style);
+}
+
+quint32 CharacterStyleTable::insert(const CharacterStyle& style)
+{
+    QHash<CharacterStyle,quint32>::const_iterator it = _indexes.constFind(style);
+    if (it != _indexes.constEnd())
+    {
+        _lastIndex = it.value();
+        return _lastIndex;
+    }
+
+    _lastIndex = _styles.count();
+    _styles.append(style);
+    _indexes.insert(style, _lastIndex);
+    return _lastIndex;
+}
+
+void CharacterStyleTable::toCharacters(const CompactCharacter* src, int count, Character* dest) const
+{
+    // styles come in runs, so only look up a style when it changes
+    quint32 index = 0;
+    const CharacterStyle* style = &_styles.at(0);
+    for (int i = 0; i < count; i++)
+    {
+        if (src[i].style != index)
+        {
+            index = src[i].style;
+            style = &_styles.at(index);
+        }
+        dest[i] = Character(src[i].character, style->foregroundColor, style->backgroundColor,
+                            style->rendition);
+    }
+}
+
+void CharacterStyleTable::fromCharacters(const Character* src, int count, CompactCharacter* dest)
+{
+    for (int i = 0; i < count; i++)
+        dest[i] = fromCharacter(src[i]);
+}
+
+void CharacterStyleTable::translate(const CompactCharacter* src, int count,
+                                    const CharacterStyleTable& table, CompactCharacter* dest)
+{
+    // styles come in runs, so only look up a style when it changes
+    quint32 sourceStyle = 0;
+    quint32 style = indexOf(table.style(0));
+    for (int i = 0; i < count; i++)
+    {
+        if (src[i].style != sourceStyle)
+        {
+            sourceStyle = src[i].style;
+            style = indexOf(table.style(sourceStyle));
+        }
+        dest[i] = CompactCharacter(src[i].character, style);
+    }
+}
+
+CharacterStyleTable& CharacterStyleGenerations::tableForNewLine(quint64 position, quint64 oldest)
+{
+    if (_current.needsCompaction() && oldest >= _currentStart && position > _currentStart)
+    {
+        _previous = _current;
+        _current.clear();
+        _currentStart = position;
+    }
+    return _current;
+}
+
+void CharacterStyleGenerations::clear()
+{
+    _previous.clear();
+    _current.clear();
+    _currentStart = 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Own includes
+#include "character.h"
+
+// Qt includes
+#include <QBitArray>
+#include <QHash>
+#include <QVector>
+
+/**
+ * The appearance of a character: its rendition flags and colors.
+ */
+class CharacterStyle
+{
+public:
+    CharacterStyle()
+        : rendition(DEFAULT_RENDITION),
+          foregroundColor(COLOR_SPACE_DEFAULT,DEFAULT_FORE_COLOR),
+          backgroundColor(COLOR_SPACE_DEFAULT,DEFAULT_BACK_COLOR) {}
+
+    CharacterStyle(quint8 _r, CharacterColor _f, CharacterColor _b)
+        : rendition(_r), foregroundColor(_f), backgroundColor(_b) {}
+
+    explicit CharacterStyle(const Character& c)
+        : rendition(c.rendition), foregroundColor(c.foregroundColor), backgroundColor(c.backgroundColor) {}
+
+    quint8 rendition;
+    CharacterColor foregroundColor;
+    CharacterColor backgroundColor;
+};
+
+inline bool operator == (const CharacterStyle& a, const CharacterStyle& b)
+{
+    return a.rendition == b.rendition &&
+            a.foregroundColor == b.foregroundColor &&
+            a.backgroundColor == b.backgroundColor;
+}
+
+inline bool operator != (const CharacterStyle& a, const CharacterStyle& b)
+{
+    return !operator==(a,b);
+}
+
+uint qHash(const CharacterStyle& style, uint seed = 0);
+
+/**
+ * A character as it is stored by Screen and the history: the unicode
+ * character value and the index of its style in a CharacterStyleTable.
+ *
+ * A CompactCharacter takes 8 bytes, compared to the 12 bytes of a Character,
+ * and two of them are compared with a single 64 bit comparison.  A
+ * default constructed CompactCharacter is a space in the default style,
+ * like a default constructed Character.
+ */
+class CompactCharacter
+{
+public:
+    CompactCharacter(quint32 _c = ' ', quint32 _s = 0)
+        : character(_c), style(_s) {}
+
+    /** The unicode character value, or the charSequence if the style has RE_EXTENDED_CHAR */
+    quint32 character;
+    /** Index of the style in the CharacterStyleTable the character belongs to */
+    quint32 style;
+};
+
+inline bool operator == (const CompactCharacter& a, const CompactCharacter& b)
+{
+    return a.character == b.character && a.style == b.style;
+}
+
+inline bool operator != (const CompactCharacter& a, const CompactCharacter& b)
+{
+    return !operator==(a,b);
+}
+
+Q_DECLARE_TYPEINFO(CharacterStyle, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(CompactCharacter, Q_PRIMITIVE_TYPE);
+
+/**
+ * Assigns indexes to the styles of characters.  Every distinct style
+ * is stored once.  Index 0 is always the default style.
+ *
+ * Entries are only removed by compact() and clear(), so an index stays
+ * valid until then.  Output which keeps changing its colors, such as a
+ * gradient in 24 bit colors, adds styles all the time, so the owner of a
+ * table compacts it once needsCompaction() returns true, keeping the
+ * styles its characters still use.
+ *
+ * Characters mostly come in runs of the same style, so the table
+ * remembers the last style it looked up.
+ */
+class CharacterStyleTable
+{
+public:
+    CharacterStyleTable();
+
+    /** The number of styles before a table needs to be compacted for the first time */
+    enum { COMPACT_THRESHOLD = 1024 };
+
+    /** Returns the index of @p style, adding it to the table if necessary */
+    quint32 indexOf(const CharacterStyle& style)
+    {
+        if (style == _styles.at(_lastIndex))
+            return _lastIndex;
+        return insert(style);
+    }
+
+    /** Returns the style at @p index */
+    const CharacterStyle& style(quint32 index) const { return _styles.at(index); }
+
+    /** Returns the number of styles in the table */
+    int count() const { return _styles.count(); }
+
+    /** Returns roughly the number of bytes of memory the table takes */
+    size_t memoryUsage() const;
+
+    /**
+     * Returns true if styles have been added to the table since it was
+     * created or compacted which are worth the time compact() takes
+     */
+    bool needsCompaction() const { return _styles.count() >= _compactAt; }
+
+    /**
+     * Removes the styles whose bit in @p used is not set, except the
+     * default style, and returns the new index of every old one, 0 for
+     * those which were removed.
+     */
+    QVector<quint32> compact(const QBitArray& used);
+
+    /** Removes all styles but the default one */
+    void clear();
+
+    /** Sets the bits of the styles of @p count characters from @p cells in @p used */
+    static void markStyles(const CompactCharacter* cells, int count, QBitArray& used);
+    /** Replaces the styles of @p count characters from @p cells by their new @p indexes from compact() */
+    static void renumberStyles(CompactCharacter* cells, int count, const QVector<quint32>& indexes);
+
+    /** Converts @p c into a Character */
+    Character toCharacter(const CompactCharacter& c) const
+    {
+        const CharacterStyle& s = _styles.at(c.style);
+        return Character(c.character, s.foregroundColor, s.backgroundColor, s.rendition);
+    }
+
+    /** Converts @p c into a CompactCharacter, adding its style to the table if necessary */
+    CompactCharacter fromCharacter(const Character& c)
+    {
+        return CompactCharacter(c.character, indexOf(CharacterStyle(c)));
+    }
+
+    /** Converts @p count characters from @p src into @p dest */
+    void toCharacters(const CompactCharacter* src, int count, Character* dest) const;
+    void fromCharacters(const Character* src, int count, CompactCharacter* dest);
+
+    /**
+     * Converts @p count characters from @p src, whose styles are indexes
+     * into @p table, into characters with indexes into this table.
+     */
+    void translate(const CompactCharacter* src, int count, const CharacterStyleTable& table,
+                   CompactCharacter* dest);
+
+private:
+    quint32 insert(const CharacterStyle& style);
+
+    QVector<CharacterStyle> _styles;
+    QHash<CharacterStyle,quint32> _indexes;
+    quint32 _lastIndex;
+    // the number of styles at which needsCompaction() returns true
+    int _compactAt;
+};
+
+/**
+ * The styles of the lines of a history which cannot change the characters
+ * it stores, because they are packed into a stream or compressed.  Lines
+ * are removed oldest first.
+ *
+ * Such a history cannot compact a CharacterStyleTable.  Instead, its lines
+ * take their styles from one of two tables.  Lines are numbered by a
+ * position which grows with every line, such as the number of lines or
+ * blocks added so far.  Lines from the position at which the current table
+ * was started use it, older ones use the previous table.  Once the current
+ * table needs to be compacted and no line of the previous one is left, the
+ * previous table is dropped, the current one takes its place and the next
+ * line starts a new one.  So the tables hold the styles of the lines in
+ * the history and of those added since the previous table was dropped.
+ */
+class CharacterStyleGenerations
+{
+public:
+    CharacterStyleGenerations() : _currentStart(0) {}
+
+    /** Returns the table of the line at @p position */
+    const CharacterStyleTable& at(quint64 position) const
+    {
+        return position < _currentStart ? _previous : _current;
+    }
+
+    /**
+     * Returns the table for a line which is added at @p position, when the
+     * oldest line left in the history is at @p oldest
+     */
+    CharacterStyleTable& tableForNewLine(quint64 position, quint64 oldest);
+
+    /** Returns the number of styles in both tables */
+    int count() const { return _previous.count() + _current.count(); }
+
+    /** Returns roughly the number of bytes of memory the tables take */
+    size_t memoryUsage() const { return _previous.memoryUsage() + _current.memoryUsage(); }
+
+    /** Removes all styles, for a history without lines */
+    void clear();
+
+private:
+    CharacterStyleTable _previous;
+    CharacterStyleTable _current;
+    quint64 _currentStart;
+};
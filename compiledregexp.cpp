@@ -0,0 +1,177 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "compiledregexp.h"
+
+// Qt includes
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+
+namespace
+{
+
+// the number of patterns kept compiled besides those in use
+const int CACHE_SIZE = 64;
+
+typedef QPair<QString, int> PatternKey;
+
+struct ExpressionCache
+{
+    ExpressionCache() : expressions(CACHE_SIZE) {}
+
+    QMutex mutex;
+    QCache<PatternKey, QRegularExpression> expressions;
+};
+
+Q_GLOBAL_STATIC(ExpressionCache, expressionCache)
+
+// Returns the compiled expression for 'pattern', which shares its compiled
+// form with all other expressions returned for it
+QRegularExpression compile(const QString& pattern, QRegularExpression::PatternOptions options)
+{
+    ExpressionCache* cache = expressionCache();
+    const PatternKey key(pattern, int(options));
+
+    QMutexLocker locker(&cache->mutex);
+    if (const QRegularExpression* expression = cache->expressions.object(key))
+        return *expression;
+
+    // compile the pattern now rather than on the first match of each copy
+    QRegularExpression* expression = new QRegularExpression(pattern, options);
+    expression->optimize();
+    const QRegularExpression result = *expression;
+    cache->expressions.insert(key, expression);
+    return result;
+}
+
+// Returns the text 'pattern' matches if it is plain text, whose special
+// characters may be escaped, or an empty string
+QString literalTextOf(const QString& pattern, QRegularExpression::PatternOptions options)
+{
+    // the other options change what the characters of the pattern mean
+    if (options & ~QRegularExpression::CaseInsensitiveOption)
+        return QString();
+
+    static const QString special = QStringLiteral("\\^$.|?*+()[{");
+    QString text;
+    text.reserve(pattern.size());
+    for (int i = 0; i < pattern.size(); i++)
+    {
+        QChar c = pattern.at(i);
+        if (c == QLatin1Char('\\'))
+        {
+            // an escaped letter or digit is a class, an anchor or a reference
+            if (++i == pattern.size() || pattern.at(i).isLetterOrNumber())
+                return QString();
+            c = pattern.at(i);
+        }
+        else if (special.contains(c))
+        {
+            return QString();
+        }
+        text.append(c);
+    }
+    return text;
+}
+
+} // namespace
+
+CompiledRegExp::CompiledRegExp()
+{
+}
+
+CompiledRegExp::CompiledRegExp(const QString& pattern, QRegularExpression::PatternOptions options)
+    : _expression(compile(pattern, options))
+{
+    if (_expression.isValid())
+        _literalText = literalTextOf(pattern, options);
+}
+
+CompiledRegExp CompiledRegExp::fromText(const QString& text, Qt::CaseSensitivity caseSensitivity)
+{
+    CompiledRegExp regExp(QRegularExpression::escape(text),
+                          caseSensitivity == Qt::CaseSensitive ? QRegularExpression::NoPatternOption
+                                                               : QRegularExpression::CaseInsensitiveOption);
+    regExp._literalText = text;
+    return regExp;
+}
+
+Qt::CaseSensitivity CompiledRegExp::caseSensitivity() const
+{
+    return (patternOptions() & QRegularExpression::CaseInsensitiveOption) ? Qt::CaseInsensitive
+                                                                          : Qt::CaseSensitive;
+}
+
+bool CompiledRegExp::isEmpty() const
+{
+    return _expression.pattern().isEmpty() || !_expression.isValid();
+}
+
+int CompiledRegExp::indexIn(const QString& text, int from, int* length, QStringList* capturedTexts) const
+{
+    if (!_literalText.isEmpty())
+    {
+        const int position = text.indexOf(_literalText, from, caseSensitivity());
+        if (position >= 0)
+        {
+            *length = _literalText.size();
+            if (capturedTexts)
+                *capturedTexts = QStringList(text.mid(position, *length));
+        }
+        return position;
+    }
+
+    if (isEmpty())
+        return -1;
+
+    const QRegularExpressionMatch match = _expression.match(text, from);
+    if (!match.hasMatch())
+        return -1;
+
+    *length = match.capturedLength();
+    if (capturedTexts)
+        *capturedTexts = match.capturedTexts();
+    return match.capturedStart();
+}
+
+bool CompiledRegExp::exactMatch(const QString& text) const
+{
+    if (!_literalText.isEmpty())
+        return text.compare(_literalText, caseSensitivity()) == 0;
+    if (isEmpty())
+        return false;
+
+    // the first match found need not be the longest, the anchored pattern
+    // makes the expression try to match all of the text
+    const QRegularExpression anchored = compile(QStringLiteral("\\A(?:") + pattern() + QStringLiteral(")\\z"),
+                                                patternOptions());
+    return anchored.match(text).hasMatch();
+}
+
+bool CompiledRegExp::operator==(const CompiledRegExp& other) const
+{
+    return pattern() == other.pattern() && patternOptions() == other.patternOptions() &&
+           _literalText == other._literalText;
+}
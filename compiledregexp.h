@@ -0,0 +1,84 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Qt includes
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+
+/**
+ * A regular expression as searches and filters use it, in Perl syntax.
+ *
+ * The compiled form of a pattern is shared by all CompiledRegExp objects
+ * with the same pattern and options, in all displays and sessions, through
+ * a cache of the patterns used lately.  Patterns are compiled once, to
+ * machine code where the JIT of PCRE is available.
+ *
+ * Patterns which only match plain text, such as those from fromText(), are
+ * found with QString::indexOf() instead, see literalText().
+ *
+ * Matching does not change the expression, so an expression may be used
+ * on several threads at once.
+ */
+class CompiledRegExp
+{
+public:
+    /** Constructs an expression which matches nothing */
+    CompiledRegExp();
+    explicit CompiledRegExp(const QString& pattern,
+                            QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption);
+
+    /** Returns an expression which matches @p text, and nothing else */
+    static CompiledRegExp fromText(const QString& text, Qt::CaseSensitivity caseSensitivity);
+
+    QString pattern() const { return _expression.pattern(); }
+    QRegularExpression::PatternOptions patternOptions() const { return _expression.patternOptions(); }
+    Qt::CaseSensitivity caseSensitivity() const;
+
+    /** Returns true if the pattern is empty or invalid, such an expression matches nothing */
+    bool isEmpty() const;
+    /** Returns false if the pattern has errors, see QRegularExpression::errorString() */
+    bool isValid() const { return _expression.isValid(); }
+
+    /** Returns the text the expression matches if that is all it matches, or an empty string */
+    QString literalText() const { return _literalText; }
+
+    /**
+     * Returns the position of the first match in @p text at or after @p from
+     * and stores its length in @p length, or returns -1 if there is none.
+     * If @p capturedTexts is given, it receives the text of the match
+     * followed by the texts of the capturing groups.
+     */
+    int indexIn(const QString& text, int from, int* length, QStringList* capturedTexts = 0) const;
+
+    /** Returns true if the expression matches all of @p text */
+    bool exactMatch(const QString& text) const;
+
+    bool operator==(const CompiledRegExp& other) const;
+    bool operator!=(const CompiledRegExp& other) const { return !operator==(other); }
+
+private:
+    QRegularExpression _expression;
+    QString _literalText;
+};
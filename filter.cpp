@@ -320,6 +320,7 @@ void Filter::HotSpot::setType(Type type)
 }
 
 RegExpFilter::RegExpFilter()
+    : _matchesEmpty(false)
 {
 }
 
@@ -342,11 +343,12 @@ QStringList RegExpFilter::HotSpot::capturedTexts() const
     return _capturedTexts;
 }
 
-void RegExpFilter::setRegExp(const QRegExp& regExp) 
+void RegExpFilter::setRegExp(const CompiledRegExp& regExp)
 {
     _searchText = regExp;
+    _matchesEmpty = _searchText.exactMatch(QString());
 }
-QRegExp RegExpFilter::regExp() const
+CompiledRegExp RegExpFilter::regExp() const
 {
     return _searchText;
 }
@@ -363,13 +365,16 @@ void RegExpFilter::process()
 
     // ignore any regular expressions which match an empty string.
     // otherwise the while loop below will run indefinitely
-    static const QString emptyString("");
-    if ( _searchText.exactMatch(emptyString) )
+    if ( _matchesEmpty || _searchText.isEmpty() )
         return;
 
+    // the captured texts come with the match, the expression is not asked
+    // for them again
+    int length = 0;
+    QStringList capturedTexts;
     while(pos >= 0)
     {
-        pos = _searchText.indexIn(*text,pos);
+        pos = _searchText.indexIn(*text,pos,&length,&capturedTexts);
 
         if ( pos >= 0 )
         {
@@ -379,17 +384,17 @@ void RegExpFilter::process()
             int endColumn = 0;
 
             getLineColumn(pos,startLine,startColumn);
-            getLineColumn(pos + _searchText.matchedLength(),endLine,endColumn);
+            getLineColumn(pos + length,endLine,endColumn);
 
             RegExpFilter::HotSpot* spot = newHotSpot(startLine,startColumn,
                                                      endLine,endColumn);
-            spot->setCapturedTexts(_searchText.capturedTexts());
+            spot->setCapturedTexts(capturedTexts);
 
             addHotSpot( spot );
-            pos += _searchText.matchedLength();
+            pos += length;
 
-            // if matchedLength == 0, the program will get stuck in an infinite loop
-            if ( _searchText.matchedLength() == 0 )
+            // if length == 0, the program will get stuck in an infinite loop
+            if ( length == 0 )
                 pos = -1;
         }
     }
@@ -478,18 +483,23 @@ void UrlFilter::HotSpot::activate(QString actionName)
 // used for finding URLs in the text, especially if they are very general and could match very long
 // pieces of text.
 // Please be careful when altering them.
+//
+// They use Unicode properties so that \w and \s match all of Unicode, as they did with QRegExp.
 
 //regexp matches:
 // full url:  
 // protocolname:// or www. followed by anything other than whitespaces, <, >, ' or ", and ends before whitespaces, <, >, ', ", ], !, comma and dot
-const QRegExp UrlFilter::FullUrlRegExp("(www\\.(?!\\.)|[a-z][a-z0-9+.-]*://)[^\\s<>'\"]+[^!,\\.\\s<>'\"\\]]");
+const CompiledRegExp UrlFilter::FullUrlRegExp("(www\\.(?!\\.)|[a-z][a-z0-9+.-]*://)[^\\s<>'\"]+[^!,\\.\\s<>'\"\\]]",
+                                              QRegularExpression::UseUnicodePropertiesOption);
 // email address:
 // [word chars, dots or dashes]@[word chars, dots or dashes].[word chars]
-const QRegExp UrlFilter::EmailAddressRegExp("\\b(\\w|\\.|-)+@(\\w|\\.|-)+\\.\\w+\\b");
+const CompiledRegExp UrlFilter::EmailAddressRegExp("\\b(\\w|\\.|-)+@(\\w|\\.|-)+\\.\\w+\\b",
+                                                   QRegularExpression::UseUnicodePropertiesOption);
 
 // matches full url or email address
-const QRegExp UrlFilter::CompleteUrlRegExp('('+FullUrlRegExp.pattern()+'|'+
-                                           EmailAddressRegExp.pattern()+')');
+const CompiledRegExp UrlFilter::CompleteUrlRegExp('('+FullUrlRegExp.pattern()+'|'+
+                                                  EmailAddressRegExp.pattern()+')',
+                                                  QRegularExpression::UseUnicodePropertiesOption);
 
 UrlFilter::UrlFilter()
 {
@@ -27,6 +27,7 @@
 #pragma once
 
 // Own includes
+#include "compiledregexp.h"
 typedef unsigned char LineProperty;
 class Character;
 
@@ -36,7 +37,6 @@ class Character;
 #include <QObject>
 #include <QStringList>
 #include <QHash>
-#include <QRegExp>
 
 /**
  * A filter processes blocks of text looking for certain patterns (such as URLs or keywords from a list)
@@ -223,9 +223,9 @@ public:
      * Regular expressions which match the empty string are treated as not matching
      * anything.
      */
-    void setRegExp(const QRegExp& text);
+    void setRegExp(const CompiledRegExp& regExp);
     /** Returns the regular expression which the filter searches for in blocks of text */
-    QRegExp regExp() const;
+    CompiledRegExp regExp() const;
 
     /**
      * Reimplemented to search the filter's text buffer for text matching regExp()
@@ -244,7 +244,9 @@ protected:
                                               int endLine,int endColumn);
 
 private:
-    QRegExp _searchText;
+    CompiledRegExp _searchText;
+    // set if _searchText matches the empty string
+    bool _matchesEmpty;
 };
 
 class FilterObject;
@@ -294,11 +296,11 @@ protected:
 
 private:
     
-    static const QRegExp FullUrlRegExp;
-    static const QRegExp EmailAddressRegExp;
+    static const CompiledRegExp FullUrlRegExp;
+    static const CompiledRegExp EmailAddressRegExp;
 
     // combined OR of FullUrlRegExp and EmailAddressRegExp
-    static const QRegExp CompleteUrlRegExp;
+    static const CompiledRegExp CompleteUrlRegExp;
 signals:
     void activated(const QUrl& url);
 };
@@ -0,0 +1,175 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "framescheduler.h"
+
+// Qt includes
+#include <QGuiApplication>
+#include <QScreen>
+
+// Output which arrives within ECHO_TIME ms after user input is shown
+// right away, as long as it does not exceed ECHO_MAXIMUM_BYTES in total
+#define ECHO_TIME          100
+#define ECHO_MAXIMUM_BYTES 4096
+
+// Used if the refresh rate of the screen is not known
+#define DEFAULT_REFRESH_RATE 60
+
+FrameScheduler::FrameScheduler(QObject *parent) :
+    QObject(parent),
+    _maximumFrameRate(0),
+    _minimumFrameInterval(0),
+    _framePending(false),
+    _echoFrame(false),
+    _lastFrameTime(-1),
+    _requestTime(0),
+    _inputTime(-1),
+    _bytesSinceInput(0)
+{
+    _clock.start();
+
+    _timer.setSingleShot(true);
+    _timer.setTimerType(Qt::PreciseTimer);
+    connect(&_timer, SIGNAL(timeout()), this, SLOT(emitFrame()));
+}
+
+void FrameScheduler::setMaximumFrameRate(int fps)
+{
+    _maximumFrameRate = qMax(0, fps);
+}
+
+int FrameScheduler::maximumFrameRate() const
+{
+    return _maximumFrameRate;
+}
+
+void FrameScheduler::setMinimumFrameInterval(int msecs)
+{
+    _minimumFrameInterval = qMax(0, msecs);
+}
+
+int FrameScheduler::frameInterval() const
+{
+    qreal refreshRate = DEFAULT_REFRESH_RATE;
+    if (QScreen *screen = QGuiApplication::primaryScreen())
+    {
+        if (screen->refreshRate() > 0)
+            refreshRate = screen->refreshRate();
+    }
+    if (_maximumFrameRate > 0)
+        refreshRate = qMin<qreal>(refreshRate, _maximumFrameRate);
+
+    return qMax(_minimumFrameInterval, qRound(1000 / refreshRate));
+}
+
+qint64 FrameScheduler::now() const
+{
+    return _clock.nsecsElapsed() / 1000;
+}
+
+void FrameScheduler::notifyInput()
+{
+    _inputTime = now();
+    _bytesSinceInput = 0;
+}
+
+void FrameScheduler::scheduleFrame(int outputBytes)
+{
+    const qint64 time = now();
+
+    // Low-latency path: a little output right after user input, most likely
+    // its echo, is shown as soon as the event loop is back in control.
+    bool echo = false;
+    if (_inputTime >= 0 && outputBytes > 0)
+    {
+        _bytesSinceInput += outputBytes;
+        echo = time - _inputTime <= ECHO_TIME * 1000 &&
+               _bytesSinceInput <= ECHO_MAXIMUM_BYTES;
+    }
+
+    // Throughput path: wait until a frame interval has passed since the
+    // last frame.
+    qint64 delay = 0;
+    if (!echo && _lastFrameTime >= 0)
+        delay = qMax<qint64>(0, _lastFrameTime + frameInterval() * 1000 - time);
+
+    if (_framePending)
+    {
+        if (!echo || _echoFrame)
+            return;
+        // an echo does not wait for the frame which is already scheduled
+        _timer.stop();
+    }
+    else
+    {
+        _requestTime = time;
+    }
+
+    _framePending = true;
+    _echoFrame = echo;
+    _timer.start((delay + 999) / 1000);
+}
+
+void FrameScheduler::cancelFrame()
+{
+    _timer.stop();
+    _framePending = false;
+    _echoFrame = false;
+}
+
+void FrameScheduler::emitFrame()
+{
+    const bool echo = _echoFrame;
+    const qint64 requestTime = _requestTime;
+    const qint64 inputTime = _inputTime;
+    _framePending = false;
+    _echoFrame = false;
+
+    const qint64 start = now();
+
+    emit frame();
+
+    const qint64 frameDuration = now() - start;
+    const qint64 latency = start - requestTime;
+
+    _lastFrameTime = start;
+
+    _statistics.frames++;
+    _statistics.totalLatency += latency;
+    _statistics.maximumLatency = qMax(_statistics.maximumLatency, latency);
+    _statistics.totalDuration += frameDuration;
+    _statistics.maximumDuration = qMax(_statistics.maximumDuration, frameDuration);
+
+    if (echo)
+    {
+        const qint64 echoLatency = start - inputTime;
+        _statistics.echoFrames++;
+        _statistics.totalEchoLatency += echoLatency;
+        _statistics.maximumEchoLatency = qMax(_statistics.maximumEchoLatency, echoLatency);
+    }
+}
+
+void FrameScheduler::resetStatistics()
+{
+    _statistics = FrameStatistics();
+}
@@ -0,0 +1,148 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Qt includes
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/**
+ * Timing statistics of the frames emitted by a FrameScheduler.
+ * All times are in microseconds.
+ */
+struct FrameStatistics
+{
+    FrameStatistics()
+        : frames(0), echoFrames(0),
+          totalLatency(0), maximumLatency(0),
+          totalEchoLatency(0), maximumEchoLatency(0),
+          totalDuration(0), maximumDuration(0)
+    {}
+
+    /** Number of frames emitted */
+    int frames;
+    /** Number of frames emitted on the low-latency path after user input */
+    int echoFrames;
+
+    /** Time from the first request for a frame until the frame was emitted */
+    qint64 totalLatency;
+    qint64 maximumLatency;
+
+    /** Time from user input until the frame showing the echo was emitted */
+    qint64 totalEchoLatency;
+    qint64 maximumEchoLatency;
+
+    /** Time spent in the slots connected to FrameScheduler::frame() */
+    qint64 totalDuration;
+    qint64 maximumDuration;
+
+    qint64 averageLatency() const
+    { return frames ? totalLatency / frames : 0; }
+    qint64 averageEchoLatency() const
+    { return echoFrames ? totalEchoLatency / echoFrames : 0; }
+    qint64 averageDuration() const
+    { return frames ? totalDuration / frames : 0; }
+};
+
+/**
+ * Decides when the views of an emulation are updated.
+ *
+ * Requests for a frame are collected and answered with a single frame()
+ * signal.  Frames are emitted at most at the refresh rate of the screen,
+ * or at the rate set with setMaximumFrameRate() if that is lower.  If only
+ * a little output arrives shortly after user input, which usually is the
+ * terminal program echoing the input, the frame is emitted as soon as
+ * control returns to the event loop instead.
+ */
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameScheduler(QObject *parent = 0);
+
+    /**
+     * Sets the maximum number of frames per second.  A value of 0 limits
+     * the rate to the refresh rate of the screen only, which is the default.
+     */
+    void setMaximumFrameRate(int fps);
+    /** Returns the rate set with setMaximumFrameRate() */
+    int maximumFrameRate() const;
+
+    /**
+     * Sets a minimum time in ms between frames, which overrides the frame
+     * rate while it is longer.  0 removes it.
+     */
+    void setMinimumFrameInterval(int msecs);
+
+    /**
+     * Requests a frame.  @p outputBytes is the amount of output which
+     * caused the request, if any.
+     */
+    void scheduleFrame(int outputBytes = 0);
+
+    /** Tells the scheduler that the user has sent input to the terminal. */
+    void notifyInput();
+
+    /**
+     * Cancels the pending frame.  Called when the views are updated by
+     * other means.
+     */
+    void cancelFrame();
+
+    /** Returns the timing statistics of the frames emitted so far. */
+    const FrameStatistics& statistics() const
+    { return _statistics; }
+    /** Discards the statistics collected so far. */
+    void resetStatistics();
+
+signals:
+    /** Emitted when the views should be updated. */
+    void frame();
+
+private slots:
+    void emitFrame();
+
+private:
+    // the shortest time between frames in ms
+    int frameInterval() const;
+    // the time on _clock in microseconds
+    qint64 now() const;
+
+    int _maximumFrameRate;
+    int _minimumFrameInterval;
+
+    QTimer _timer;
+    bool _framePending;
+    bool _echoFrame;
+
+    // times in microseconds on _clock
+    QElapsedTimer _clock;
+    qint64 _lastFrameTime;
+    qint64 _requestTime;
+    qint64 _inputTime;
+    int _bytesSinceInput;
+
+    FrameStatistics _statistics;
+};
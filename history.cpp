@@ -27,8 +27,10 @@
 
 // Own includes
 #include "history.h"
+#include "blockcodec.h"
 
 // System includes
+#include <algorithm>
 #include <iostream>
 #include <stdlib.h>
 #include <assert.h>
@@ -37,13 +39,14 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 // Qt includes
 #include <QtDebug>
+#include <QVarLengthArray>
 
 // Reasonable line size
 #define LINE_SIZE    1024
-#define KDE_lseek lseek
 
 /*
    An arbitrary long scroll.
@@ -92,93 +95,155 @@ FIXME: There is noticeable decrease in speed, also. Perhaps,
 HistoryFile::HistoryFile()
     : ion(-1),
       length(0),
-      fileMap(0)
+      fileLength(0),
+      error(false),
+      useCount(0)
 {
     if (tmpFile.open())
     {
         tmpFile.setAutoRemove(true);
         ion = tmpFile.handle();
     }
+    else
+    {
+        error = true;
+    }
+
+    for (int i = 0; i < MAPPED_WINDOWS; i++)
+    {
+        windows[i].segment = -1;
+        windows[i].data = 0;
+        windows[i].lastUse = 0;
+    }
 }
 
 HistoryFile::~HistoryFile()
 {
-    if (fileMap)
-        unmap();
+    for (int i = 0; i < MAPPED_WINDOWS; i++)
+    {
+        if (windows[i].data)
+            munmap(windows[i].data, SEGMENT_SIZE);
+    }
 }
 
-//TODO:  Mapping the entire file in will cause problems if the history file becomes exceedingly large,
-//(ie. larger than available memory).  HistoryFile::map() should only map in sections of the file at a time,
-//to avoid this.
-void HistoryFile::map()
+void HistoryFile::writeSegment()
 {
-    assert( fileMap == 0 );
+    Q_ASSERT(tail.size() == SEGMENT_SIZE);
 
-    fileMap = (char*)mmap( 0 , length , PROT_READ , MAP_PRIVATE , ion , 0 );
-
-    //if mmap'ing fails, fall back to the read-lseek combination
-    if ( fileMap == MAP_FAILED )
+    const qint64 offset = length - SEGMENT_SIZE;
+    qint64 written = 0;
+    while (ion >= 0 && written < SEGMENT_SIZE)
     {
-        readWriteBalance = 0;
-        fileMap = 0;
-        qDebug() << __FILE__ << __LINE__ << ": mmap'ing history failed.  errno = " << errno;
+        const ssize_t rc = pwrite(ion, tail.constData() + written, SEGMENT_SIZE - written, offset + written);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("HistoryFile::writeSegment");
+            break;
+        }
+        written += rc;
     }
-}
 
-void HistoryFile::unmap()
-{
-    int result = munmap( fileMap , length );
-    assert( result == 0 ); Q_UNUSED( result );
+    if (written == SEGMENT_SIZE)
+        fileLength = offset + SEGMENT_SIZE;
+    else
+        error = true;
 
-    fileMap = 0;
+    // a reserved capacity survives resize(0), so the next segment is
+    // appended to the same buffer instead of growing a new one
+    tail.reserve(SEGMENT_SIZE);
+    tail.resize(0);
 }
 
-bool HistoryFile::isMapped()
+void HistoryFile::add(const unsigned char* bytes, int len)
 {
-    return (fileMap != 0);
+    while (len > 0)
+    {
+        const int count = qMin(len, SEGMENT_SIZE - tail.size());
+        tail.append(reinterpret_cast<const char*>(bytes), count);
+        length += count;
+        bytes += count;
+        len -= count;
+
+        if (tail.size() == SEGMENT_SIZE)
+            writeSegment();
+    }
 }
 
-void HistoryFile::add(const unsigned char* bytes, int len)
+const char* HistoryFile::window(qint64 segment)
 {
-    if ( fileMap )
-        unmap();
+    // a segment which was not written completely is read as zeros
+    if ((segment + 1) * SEGMENT_SIZE > fileLength)
+        return 0;
 
-    readWriteBalance++;
+    Window* leastRecent = &windows[0];
+    for (int i = 0; i < MAPPED_WINDOWS; i++)
+    {
+        if (windows[i].segment == segment)
+        {
+            windows[i].lastUse = ++useCount;
+            return windows[i].data;
+        }
+        if (windows[i].lastUse < leastRecent->lastUse)
+            leastRecent = &windows[i];
+    }
+
+    if (leastRecent->data)
+        munmap(leastRecent->data, SEGMENT_SIZE);
 
-    int rc = 0;
+    void* data = mmap(0, SEGMENT_SIZE, PROT_READ, MAP_SHARED, ion, segment * SEGMENT_SIZE);
+    if (data == MAP_FAILED)
+    {
+        qDebug() << __FILE__ << __LINE__ << ": mmap'ing history failed.  errno = " << errno;
+        leastRecent->segment = -1;
+        leastRecent->data = 0;
+        leastRecent->lastUse = 0;
+        return 0;
+    }
 
-    rc = KDE_lseek(ion,length,SEEK_SET); if (rc < 0) { perror("HistoryFile::add.seek"); return; }
-    rc = write(ion,bytes,len);       if (rc < 0) { perror("HistoryFile::add.write"); return; }
-    length += rc;
+    leastRecent->segment = segment;
+    leastRecent->data = static_cast<char*>(data);
+    leastRecent->lastUse = ++useCount;
+    return leastRecent->data;
 }
 
-void HistoryFile::get(unsigned char* bytes, int len, int loc)
+void HistoryFile::get(unsigned char* bytes, int len, qint64 loc)
 {
-    //count number of get() calls vs. number of add() calls.
-    //If there are many more get() calls compared with add()
-    //calls (decided by using MAP_THRESHOLD) then mmap the log
-    //file to improve performance.
-    readWriteBalance--;
-    if ( !fileMap && readWriteBalance < MAP_THRESHOLD )
-        map();
-
-    if ( fileMap )
+    if (loc < 0 || len < 0 || loc + len > length)
     {
-        for (int i=0;i<len;i++)
-            bytes[i]=fileMap[loc+i];
+        fprintf(stderr,"getHist(...,%d,%lld): invalid args.\n",len,(long long)loc);
+        return;
     }
-    else
+
+    // the segment in memory starts where the complete segments end
+    const qint64 tailStart = length - tail.size();
+    while (len > 0)
     {
-        int rc = 0;
+        const qint64 segment = loc / SEGMENT_SIZE;
+        const int offset = loc % SEGMENT_SIZE;
+        const int count = qMin(len, SEGMENT_SIZE - offset);
+
+        if (loc >= tailStart)
+        {
+            memcpy(bytes, tail.constData() + (loc - tailStart), count);
+        }
+        else
+        {
+            const char* data = window(segment);
+            if (data)
+                memcpy(bytes, data + offset, count);
+            else if (pread(ion, bytes, count, loc) != count)
+                memset(bytes, 0, count);
+        }
 
-        if (loc < 0 || len < 0 || loc + len > length)
-            fprintf(stderr,"getHist(...,%d,%d): invalid args.\n",len,loc);
-        rc = KDE_lseek(ion,loc,SEEK_SET); if (rc < 0) { perror("HistoryFile::get.seek"); return; }
-        rc = read(ion,bytes,len);     if (rc < 0) { perror("HistoryFile::get.read"); return; }
+        bytes += count;
+        loc += count;
+        len -= count;
     }
 }
 
-int HistoryFile::len()
+qint64 HistoryFile::len()
 {
     return length;
 }
@@ -202,6 +267,30 @@ bool HistoryScroll::hasScroll()
     return true;
 }
 
+void HistoryScroll::getCellsOfLines(int lineno, int count, int stride, Character res[])
+{
+    for (int i = 0; i < count; i++)
+        getCells(lineno + i, 0, qMin(stride, getLineLen(lineno + i)), res + i * stride);
+}
+
+const CompactCharacter* HistoryScroll::getCharacterCells(int lineno, CompactCharacter buffer[])
+{
+    const int count = getLineLen(lineno);
+    QVarLengthArray<Character,256> cells(count);
+    getCells(lineno, 0, count, cells.data());
+    for (int i = 0; i < count; i++)
+        buffer[i] = CompactCharacter(cells[i].character);
+    return buffer;
+}
+
+void HistoryScroll::addCompactCells(const CompactCharacter a[], int count,
+                                    const CharacterStyleTable& styles)
+{
+    QVarLengthArray<Character,256> cells(count);
+    styles.toCharacters(a, count, cells.data());
+    addCells(cells.constData(), count);
+}
+
 // History Scroll File //////////////////////////////////////
 
 /* 
@@ -227,7 +316,7 @@ HistoryScrollFile::~HistoryScrollFile()
 
 int HistoryScrollFile::getLines()
 {
-    return index.len() / sizeof(int);
+    return index.len() / sizeof(qint64);
 }
 
 int HistoryScrollFile::getLineLen(int lineno)
@@ -245,17 +334,13 @@ bool HistoryScrollFile::isWrappedLine(int lineno)
     return false;
 }
 
-int HistoryScrollFile::startOfLine(int lineno)
+qint64 HistoryScrollFile::startOfLine(int lineno)
 {
     if (lineno <= 0) return 0;
     if (lineno <= getLines())
     {
-
-        if (!index.isMapped())
-            index.map();
-
-        int res;
-        index.get((unsigned char*)&res,sizeof(int),(lineno-1)*sizeof(int));
+        qint64 res;
+        index.get((unsigned char*)&res,sizeof(qint64),qint64(lineno-1)*sizeof(qint64));
         return res;
     }
     return cells.len();
@@ -273,11 +358,8 @@ void HistoryScrollFile::addCells(const Character text[], int count)
 
 void HistoryScrollFile::addLine(bool previousWrapped)
 {
-    if (index.isMapped())
-        index.unmap();
-
-    int locn = cells.len();
-    index.add((unsigned char*)&locn,sizeof(int));
+    qint64 locn = cells.len();
+    index.add((unsigned char*)&locn,sizeof(qint64));
     unsigned char flags = previousWrapped ? 0x01 : 0x00;
     lineflags.add((unsigned char*)&flags,sizeof(unsigned char));
 }
@@ -299,7 +381,7 @@ HistoryScrollBuffer::~HistoryScrollBuffer()
     delete[] _historyBuffer;
 }
 
-void HistoryScrollBuffer::addCellsVector(const QVector<Character>& cells)
+HistoryScrollBuffer::HistoryLine& HistoryScrollBuffer::nextLine()
 {
     _head++;
     if ( _usedLines < _maxLineCount )
@@ -310,15 +392,49 @@ void HistoryScrollBuffer::addCellsVector(const QVector<Character>& cells)
         _head = 0;
     }
 
-    _historyBuffer[bufferIndex(_usedLines-1)] = cells;
     _wrappedLine[bufferIndex(_usedLines-1)] = false;
+    return _historyBuffer[bufferIndex(_usedLines-1)];
 }
+
 void HistoryScrollBuffer::addCells(const Character a[], int count)
 {
-    HistoryLine newLine(count);
-    qCopy(a,a+count,newLine.begin());
+    // once the history is full, this is the line which drops out of it,
+    // its buffer is reused
+    HistoryLine& line = nextLine();
+    line.resize(count);
+    _styles.fromCharacters(a, count, line.data());
+
+    if (_styles.needsCompaction())
+        compactStyles();
+}
+
+void HistoryScrollBuffer::addCompactCells(const CompactCharacter a[], int count,
+                                          const CharacterStyleTable& styles)
+{
+    HistoryLine& line = nextLine();
+    line.resize(count);
+    _styles.translate(a, count, styles, line.data());
+
+    if (_styles.needsCompaction())
+        compactStyles();
+}
+
+void HistoryScrollBuffer::compactStyles()
+{
+    // the styles of the lines which dropped out of the history are dropped as well
+    QBitArray used(_styles.count());
+    for (int i = 0; i < _usedLines; i++)
+    {
+        const HistoryLine& line = _historyBuffer[bufferIndex(i)];
+        CharacterStyleTable::markStyles(line.constData(), line.size(), used);
+    }
 
-    addCellsVector(newLine);
+    const QVector<quint32> indexes = _styles.compact(used);
+    for (int i = 0; i < _usedLines; i++)
+    {
+        HistoryLine& line = _historyBuffer[bufferIndex(i)];
+        CharacterStyleTable::renumberStyles(line.data(), line.size(), indexes);
+    }
 }
 
 void HistoryScrollBuffer::addLine(bool previousWrapped)
@@ -378,7 +494,15 @@ void HistoryScrollBuffer::getCells(int lineNumber, int startColumn, int count, C
 
     Q_ASSERT( startColumn <= line.size() - count );
     
-    memcpy(buffer, line.constData() + startColumn , count * sizeof(Character));
+    _styles.toCharacters(line.constData() + startColumn, count, buffer);
+}
+
+const CompactCharacter* HistoryScrollBuffer::getCharacterCells(int lineNumber, CompactCharacter buffer[])
+{
+    if (lineNumber >= _usedLines)
+        return buffer;
+
+    return _historyBuffer[bufferIndex(lineNumber)].constData();
 }
 
 void HistoryScrollBuffer::setMaxNbLines(unsigned int lineCount)
@@ -464,10 +588,16 @@ void HistoryScrollNone::addLine(bool)
 
 // History Scroll BlockArray //////////////////////////////////////
 
+static const quint64 LINE_WRAPPED = Q_UINT64_C(1) << 63;
+
 HistoryScrollBlockArray::HistoryScrollBlockArray(size_t size)
-    : HistoryScroll(new HistoryTypeBlockArray(size))
+    : HistoryScroll(new HistoryTypeBlockArray(size)),
+      m_firstLine(0),
+      m_length(0),
+      m_maxLines(size)
 {
-    m_blockArray.setHistorySize(size); // nb. of lines.
+    // nb. of blocks, a block holds many lines unless they are very long
+    m_blockArray.setHistorySize(size);
 }
 
 HistoryScrollBlockArray::~HistoryScrollBlockArray()
@@ -476,20 +606,47 @@ HistoryScrollBlockArray::~HistoryScrollBlockArray()
 
 int  HistoryScrollBlockArray::getLines()
 {
-    return m_lineLengths.count();
+    return m_lineStarts.size() - m_firstLine;
+}
+
+quint64 HistoryScrollBlockArray::startOfLine(int lineno) const
+{
+    if (lineno >= m_lineStarts.size() - m_firstLine)
+        return m_length;
+    return m_lineStarts[m_firstLine + lineno] & ~LINE_WRAPPED;
 }
 
 int  HistoryScrollBlockArray::getLineLen(int lineno)
 {
-    if ( m_lineLengths.contains(lineno) )
-        return m_lineLengths[lineno];
-    else
+    if (lineno < 0 || lineno >= getLines())
         return 0;
+    return (startOfLine(lineno + 1) - startOfLine(lineno)) / sizeof(CompactCharacter);
 }
 
-bool HistoryScrollBlockArray::isWrappedLine(int /*lineno*/)
+bool HistoryScrollBlockArray::isWrappedLine(int lineno)
 {
-    return false;
+    if (lineno < 0 || lineno >= getLines())
+        return false;
+    return m_lineStarts[m_firstLine + lineno] & LINE_WRAPPED;
+}
+
+void HistoryScrollBlockArray::readBytes(quint64 position, char* bytes, int count)
+{
+    while (count > 0)
+    {
+        const size_t offset = position % ENTRIES;
+        const int n = qMin<size_t>(count, ENTRIES - offset);
+
+        const Block *b = m_blockArray.at(position / ENTRIES);
+        if (b)
+            memcpy(bytes, b->data + offset, n);
+        else
+            memset(bytes, 0, n); // still better than random data
+
+        position += n;
+        bytes += n;
+        count -= n;
+    }
 }
 
 void HistoryScrollBlockArray::getCells(int lineno, int colno,
@@ -497,40 +654,100 @@ void HistoryScrollBlockArray::getCells(int lineno, int colno,
 {
     if (!count) return;
 
-    const Block *b = m_blockArray.at(lineno);
+    Q_ASSERT(colno >= 0 && colno + count <= getLineLen(lineno));
 
-    if (!b) {
-        memset(res, 0, count * sizeof(Character)); // still better than random data
-        return;
+    QVarLengthArray<CompactCharacter,256> cells(count);
+    const quint64 start = startOfLine(lineno);
+    readBytes(start + colno * sizeof(CompactCharacter),
+              reinterpret_cast<char*>(cells.data()), count * sizeof(CompactCharacter));
+    m_styles.at(start).toCharacters(cells.constData(), count, res);
+}
+
+const CompactCharacter* HistoryScrollBlockArray::getCharacterCells(int lineno, CompactCharacter buffer[])
+{
+    // the cells of a line may be spread over blocks
+    readBytes(startOfLine(lineno), reinterpret_cast<char*>(buffer),
+              getLineLen(lineno) * sizeof(CompactCharacter));
+    return buffer;
+}
+
+void HistoryScrollBlockArray::appendBytes(const char* bytes, int count)
+{
+    while (count > 0)
+    {
+        Block *b = m_blockArray.lastBlock();
+        if (!b) return;
+
+        const int n = qMin<size_t>(count, ENTRIES - b->size);
+        memcpy(b->data + b->size, bytes, n);
+        b->size += n;
+        m_length += n;
+        bytes += n;
+        count -= n;
+
+        // the stream continues in the next block
+        if (b->size == ENTRIES)
+            m_blockArray.newBlock();
+    }
+}
+
+void HistoryScrollBlockArray::startLine()
+{
+    // compact the index once most of it has been removed
+    if (m_firstLine >= 1024 && m_firstLine * 2 >= m_lineStarts.size())
+    {
+        m_lineStarts.remove(0, m_firstLine);
+        m_firstLine = 0;
     }
 
-    assert(((colno + count) * sizeof(Character)) < ENTRIES);
-    memcpy(res, b->data + (colno * sizeof(Character)), count * sizeof(Character));
+    m_lineStarts.append(m_length);
 }
 
-void HistoryScrollBlockArray::addCells(const Character a[], int count)
+CharacterStyleTable& HistoryScrollBlockArray::stylesForNewLine()
 {
-    Block *b = m_blockArray.lastBlock();
+    // the lines are numbered by their position in the stream
+    return m_styles.tableForNewLine(m_length, getLines() > 0 ? startOfLine(0) : m_length);
+}
 
-    if (!b) return;
+void HistoryScrollBlockArray::removeOldLines()
+{
+    while (getLines() > 0 &&
+           ((size_t)getLines() > m_maxLines ||
+            !m_blockArray.has(startOfLine(0) / ENTRIES)))
+    {
+        m_firstLine++;
+    }
+}
 
-    // put cells in block's data
-    assert((count * sizeof(Character)) < ENTRIES);
+void HistoryScrollBlockArray::addCells(const Character a[], int count)
+{
+    if (!m_blockArray.lastBlock()) return;
 
-    memset(b->data, 0, ENTRIES);
+    QVarLengthArray<CompactCharacter,256> cells(count);
+    stylesForNewLine().fromCharacters(a, count, cells.data());
 
-    memcpy(b->data, a, count * sizeof(Character));
-    b->size = count * sizeof(Character);
+    startLine();
+    appendBytes(reinterpret_cast<const char*>(cells.constData()), count * sizeof(CompactCharacter));
+    removeOldLines();
+}
 
-    size_t res = m_blockArray.newBlock();
-    assert (res > 0);
-    Q_UNUSED( res );
+void HistoryScrollBlockArray::addCompactCells(const CompactCharacter a[], int count,
+                                              const CharacterStyleTable& styles)
+{
+    if (!m_blockArray.lastBlock()) return;
+
+    QVarLengthArray<CompactCharacter,256> cells(count);
+    stylesForNewLine().translate(a, count, styles, cells.data());
 
-    m_lineLengths.insert(m_blockArray.getCurrent(), count);
+    startLine();
+    appendBytes(reinterpret_cast<const char*>(cells.constData()), count * sizeof(CompactCharacter));
+    removeOldLines();
 }
 
-void HistoryScrollBlockArray::addLine(bool)
+void HistoryScrollBlockArray::addLine(bool previousWrapped)
 {
+    if (getLines() > 0 && previousWrapped)
+        m_lineStarts.last() |= LINE_WRAPPED;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -555,12 +772,37 @@ void CompactHistoryBlock::deallocate ( )
     Q_ASSERT ( allocCount >= 0 );
 }
 
+// allocations are aligned for the pointers in CompactHistoryLine
+static size_t alignedSize ( size_t size )
+{
+    const size_t alignment = sizeof(void*);
+    return ( size+alignment-1 ) & ~( alignment-1 );
+}
+
+CompactHistoryBlockList::CompactHistoryBlockList()
+    : spare(0)
+    , _bytesInUse(0)
+    , _bytesReserved(0)
+{
+}
+
 void* CompactHistoryBlockList::allocate(size_t size)
 {
+    size = alignedSize(size);
+
     CompactHistoryBlock* block;
     if ( list.isEmpty() || list.last()->remaining() < size)
     {
-        block = new CompactHistoryBlock();
+        if ( spare )
+        {
+            block = spare;
+            spare = 0;
+        }
+        else
+        {
+            block = new CompactHistoryBlock();
+            _bytesReserved += block->length();
+        }
         list.append ( block );
         //kDebug() << "new block created, remaining " << block->remaining() << "number of blocks=" << list.size();
     }
@@ -569,30 +811,45 @@ void* CompactHistoryBlockList::allocate(size_t size)
         block = list.last();
         //kDebug() << "old block used, remaining " << block->remaining();
     }
+
+    _bytesInUse += size;
     return block->allocate(size);
 }
 
-void CompactHistoryBlockList::deallocate(void* ptr)
+void CompactHistoryBlockList::deallocate(void* ptr, size_t size)
 {
     Q_ASSERT( !list.isEmpty());
 
+    // lines are released oldest first, so this is nearly always the first block
     int i=0;
-    CompactHistoryBlock *block = list.at(i);
-    while ( i<list.size() && !block->contains(ptr) )
-    {
+    while ( i<list.size() && !list.at(i)->contains(ptr) )
         i++;
-        block=list.at(i);
-    }
 
     Q_ASSERT( i<list.size() );
 
-    block->deallocate();
+    list.at(i)->deallocate();
+    _bytesInUse -= alignedSize(size);
+
+    if ( i == 0 )
+        releaseUnusedBlocks();
+}
 
-    if (!block->isInUse())
+void CompactHistoryBlockList::releaseUnusedBlocks()
+{
+    while ( !list.isEmpty() && !list.first()->isInUse() )
     {
-        list.removeAt(i);
-        delete block;
-        //kDebug() << "block deleted, new size = " << list.size();
+        CompactHistoryBlock* block = list.takeFirst();
+        if ( !spare )
+        {
+            block->reset();
+            spare = block;
+        }
+        else
+        {
+            _bytesReserved -= block->length();
+            delete block;
+        }
+        //kDebug() << "block released, new size = " << list.size();
     }
 }
 
@@ -600,6 +857,7 @@ CompactHistoryBlockList::~CompactHistoryBlockList()
 {
     qDeleteAll ( list.begin(), list.end() );
     list.clear();
+    delete spare;
 }
 
 void* CompactHistoryLine::operator new (size_t size, CompactHistoryBlockList& blockList)
@@ -673,18 +931,29 @@ CompactHistoryLine::~CompactHistoryLine()
 {
     //kDebug() << "~CHL";
     if (length>0) {
-        blockList.deallocate(text);
-        blockList.deallocate(formatArray);
+        blockList.deallocate(text, sizeof(quint16)*length);
+        blockList.deallocate(formatArray, sizeof(CharacterFormat)*formatLength);
     }
-    blockList.deallocate(this);
+    blockList.deallocate(this, sizeof(CompactHistoryLine));
+}
+
+static bool startsBefore ( int column, const CharacterFormat& format )
+{
+    return column < format.startPos;
+}
+
+int CompactHistoryLine::formatIndex ( int column ) const
+{
+    // the formats are sorted by their start position, the first one starts at 0
+    const CharacterFormat* format = std::upper_bound ( formatArray, formatArray+formatLength,
+                                                       column, startsBefore );
+    return format-formatArray-1;
 }
 
 void CompactHistoryLine::getCharacter ( int index, Character &r )
 {
     Q_ASSERT ( index < length );
-    int formatPos=0;
-    while ( ( formatPos+1 ) < formatLength && index >= formatArray[formatPos+1].startPos )
-        formatPos++;
+    int formatPos=formatIndex(index);
 
     r.character=text[index];
     r.rendition = formatArray[formatPos].rendition;
@@ -697,15 +966,36 @@ void CompactHistoryLine::getCharacters ( Character* array, int length, int start
     Q_ASSERT ( startColumn >= 0 && length >= 0 );
     Q_ASSERT ( startColumn+length <= ( int ) getLength() );
 
-    for ( int i=startColumn; i<length+startColumn; i++ )
+    if ( length == 0 )
+        return;
+
+    // walk the formats once, filling the span of each with its format
+    const int endColumn = startColumn+length;
+    int formatPos = formatIndex(startColumn);
+    int column = startColumn;
+    while ( column < endColumn )
     {
-        getCharacter ( i, array[i-startColumn] );
+        const CharacterFormat& format = formatArray[formatPos];
+        formatPos++;
+        const int spanEnd = formatPos < formatLength ?
+                    qMin<int>(formatArray[formatPos].startPos, endColumn) : endColumn;
+
+        for ( ; column < spanEnd; column++ )
+        {
+            Character& c = array[column-startColumn];
+            c.character = text[column];
+            c.rendition = format.rendition;
+            c.foregroundColor = format.fgColor;
+            c.backgroundColor = format.bgColor;
+        }
     }
 }
 
 CompactHistoryScroll::CompactHistoryScroll ( unsigned int maxLineCount )
     : HistoryScroll ( new CompactHistoryType ( maxLineCount ) )
-    ,lines()
+    ,_lines()
+    ,_head(0)
+    ,_usedLines(0)
     ,blockList()
 {
     //kDebug() << "scroll of length " << maxLineCount << " created";
@@ -714,8 +1004,39 @@ CompactHistoryScroll::CompactHistoryScroll ( unsigned int maxLineCount )
 
 CompactHistoryScroll::~CompactHistoryScroll()
 {
-    qDeleteAll ( lines.begin(), lines.end() );
-    lines.clear();
+    // oldest first, so that the blocks are released in order
+    while ( _usedLines > 0 )
+        removeOldestLine();
+}
+
+CompactHistoryLine* CompactHistoryScroll::lineAt ( int lineNumber ) const
+{
+    Q_ASSERT ( lineNumber >= 0 && lineNumber < _usedLines );
+    return _lines[( _head+lineNumber ) % _lines.size()];
+}
+
+void CompactHistoryScroll::appendLine ( CompactHistoryLine* line )
+{
+    if ( _usedLines == _lines.size() )
+    {
+        // grow the ring, putting the oldest line first again
+        QVector<CompactHistoryLine*> lines ( qMax(64, _lines.size()*2) );
+        for ( int i=0; i<_usedLines; i++ )
+            lines[i] = lineAt(i);
+        _lines.swap ( lines );
+        _head = 0;
+    }
+
+    _lines[( _head+_usedLines ) % _lines.size()] = line;
+    _usedLines++;
+}
+
+void CompactHistoryScroll::removeOldestLine()
+{
+    Q_ASSERT ( _usedLines > 0 );
+    delete _lines[_head];
+    _head = ( _head+1 ) % _lines.size();
+    _usedLines--;
 }
 
 void CompactHistoryScroll::addCellsVector ( const TextLine& cells )
@@ -723,11 +1044,11 @@ void CompactHistoryScroll::addCellsVector ( const TextLine& cells )
     CompactHistoryLine *line;
     line = new(blockList) CompactHistoryLine ( cells, blockList );
 
-    if ( lines.size() > ( int ) _maxLineCount )
+    if ( _usedLines > ( int ) _maxLineCount )
     {
-        delete lines.takeAt ( 0 );
+        removeOldestLine();
     }
-    lines.append ( line );
+    appendLine ( line );
 }
 
 void CompactHistoryScroll::addCells ( const Character a[], int count )
@@ -739,20 +1060,19 @@ void CompactHistoryScroll::addCells ( const Character a[], int count )
 
 void CompactHistoryScroll::addLine ( bool previousWrapped )
 {
-    CompactHistoryLine *line = lines.last();
+    CompactHistoryLine *line = lineAt ( _usedLines-1 );
     //kDebug() << "last line at address " << line;
     line->setWrapped(previousWrapped);
 }
 
 int CompactHistoryScroll::getLines()
 {
-    return lines.size();
+    return _usedLines;
 }
 
 int CompactHistoryScroll::getLineLen ( int lineNumber )
 {
-    Q_ASSERT ( lineNumber >= 0 && lineNumber < lines.size() );
-    CompactHistoryLine* line = lines[lineNumber];
+    CompactHistoryLine* line = lineAt ( lineNumber );
     //kDebug() << "request for line at address " << line;
     return line->getLength();
 }
@@ -761,27 +1081,368 @@ int CompactHistoryScroll::getLineLen ( int lineNumber )
 void CompactHistoryScroll::getCells ( int lineNumber, int startColumn, int count, Character buffer[] )
 {
     if ( count == 0 ) return;
-    Q_ASSERT ( lineNumber < lines.size() );
-    CompactHistoryLine* line = lines[lineNumber];
+    CompactHistoryLine* line = lineAt ( lineNumber );
     Q_ASSERT ( startColumn >= 0 );
     Q_ASSERT ( (unsigned int)startColumn <= line->getLength() - count );
     line->getCharacters ( buffer, count, startColumn );
 }
 
+const CompactCharacter* CompactHistoryScroll::getCharacterCells ( int lineNumber, CompactCharacter buffer[] )
+{
+    CompactHistoryLine* line = lineAt ( lineNumber );
+    const int length = line->getLength();
+    for ( int i=0; i<length; i++ )
+        buffer[i] = CompactCharacter ( line->characterAt(i) );
+    return buffer;
+}
+
+void CompactHistoryScroll::getCellsOfLines ( int lineNumber, int count, int stride, Character buffer[] )
+{
+    Q_ASSERT ( lineNumber >= 0 && lineNumber+count <= _usedLines );
+    for ( int i=0; i<count; i++ )
+    {
+        CompactHistoryLine* line = lineAt ( lineNumber+i );
+        line->getCharacters ( buffer+i*stride, qMin<int>(stride, line->getLength()), 0 );
+    }
+}
+
 void CompactHistoryScroll::setMaxNbLines ( unsigned int lineCount )
 {
     _maxLineCount = lineCount;
 
-    while (lines.size() > (int) lineCount) {
-        delete lines.takeAt(0);
+    while ( _usedLines > (int) lineCount ) {
+        removeOldestLine();
     }
     //kDebug() << "set max lines to: " << _maxLineCount;
 }
 
 bool CompactHistoryScroll::isWrappedLine ( int lineNumber )
 {
-    Q_ASSERT ( lineNumber < lines.size() );
-    return lines[lineNumber]->isWrapped();
+    return lineAt ( lineNumber )->isWrapped();
+}
+
+
+////////////////////////////////////////////////////////////////
+// Compressed History Scroll ///////////////////////////////////
+////////////////////////////////////////////////////////////////
+
+CompressedHistoryScroll::CompressedHistoryScroll ( unsigned int maxLineCount, size_t memoryBudget )
+    : HistoryScroll ( new CompressedHistoryType ( maxLineCount, memoryBudget ) )
+    , _removedLines(0)
+    , _removedBlocks(0)
+    , _lineCount(0)
+    , _maxLineCount(maxLineCount)
+    , _memoryBudget(memoryBudget)
+    , _memoryBytes(0)
+    , _firstBlockInMemory(0)
+    , _spillFile(0)
+    , _cache(CACHED_BLOCKS)
+{
+    _openBlock.lineEnds.reserve ( LINES_PER_BLOCK );
+    _openBlock.wrapped.resize ( LINES_PER_BLOCK );
+}
+
+CompressedHistoryScroll::~CompressedHistoryScroll()
+{
+    delete _spillFile;
+}
+
+void CompressedHistoryScroll::locate ( int lineNumber, int& blockIndex, int& line ) const
+{
+    Q_ASSERT ( lineNumber >= 0 && lineNumber < _lineCount );
+    const int n = lineNumber + _removedLines;
+    blockIndex = n / LINES_PER_BLOCK;
+    line = n % LINES_PER_BLOCK;
+}
+
+CompressedHistoryScroll::BlockLines& CompressedHistoryScroll::openBlock()
+{
+    if ( _openBlock.lineEnds.size() == LINES_PER_BLOCK )
+        sealBlock();
+    return _openBlock;
+}
+
+void CompressedHistoryScroll::sealBlock()
+{
+    Q_ASSERT ( _openBlock.lineEnds.size() == LINES_PER_BLOCK );
+
+    // store the cells as byte planes: the lowest byte of every character,
+    // then the next byte of every character and so on, then the styles
+    // the same way.  Most of the planes are runs of zeros.  The lengths of
+    // the lines follow as byte planes as well, then the wrap flags.
+    const int count = _openBlock.cells.size();
+    const int cellBytes = count*sizeof(CompactCharacter);
+    const int lengthBytes = LINES_PER_BLOCK*sizeof(quint32);
+    _planes.resize ( cellBytes+lengthBytes+LINES_PER_BLOCK/8 );
+    quint8* planes = reinterpret_cast<quint8*>( _planes.data() );
+    const CompactCharacter* cells = _openBlock.cells.constData();
+    for ( int i=0; i<count; i++ )
+    {
+        const quint32 character = cells[i].character;
+        const quint32 style = cells[i].style;
+        for ( int b=0; b<4; b++ )
+        {
+            planes[b*count+i] = character >> (8*b);
+            planes[(4+b)*count+i] = style >> (8*b);
+        }
+    }
+
+    quint8* lengths = planes+cellBytes;
+    quint8* wrapped = lengths+lengthBytes;
+    memset ( wrapped, 0, LINES_PER_BLOCK/8 );
+    for ( int line=0; line<LINES_PER_BLOCK; line++ )
+    {
+        const quint32 length = _openBlock.lineEnds[line] - ( line > 0 ? _openBlock.lineEnds[line-1] : 0 );
+        for ( int b=0; b<4; b++ )
+            lengths[b*LINES_PER_BLOCK+line] = length >> (8*b);
+        if ( _openBlock.wrapped.testBit(line) )
+            wrapped[line/8] |= 1 << (line%8);
+    }
+
+    Block block;
+    block.cellCount = count;
+    block.data = QByteArray ( compressBlockBound(_planes.size()), Qt::Uninitialized );
+    block.data.resize ( compressBlock(_planes.constData(), _planes.size(), block.data.data(), block.data.size()) );
+    block.data.squeeze();
+    block.dataSize = block.data.size();
+    _memoryBytes += block.dataSize;
+    _blocks.append ( block );
+
+    // the newest block is the one most likely to be read, so it is cached
+    // with the lines it already has
+    _cache.insert ( _removedBlocks+_blocks.size()-1, new BlockLines(_openBlock) );
+    _openBlock.cells = QVector<CompactCharacter>();
+    _openBlock.lineEnds.clear();
+    _openBlock.wrapped.fill ( false );
+
+    spillBlocks();
+}
+
+size_t CompressedHistoryScroll::memoryUsage() const
+{
+    return _memoryBytes + _blocks.capacity()*sizeof(Block) +
+           _openBlock.cells.capacity()*sizeof(CompactCharacter) +
+           _openBlock.lineEnds.capacity()*sizeof(quint32) + LINES_PER_BLOCK/8 +
+           _styles.memoryUsage();
+}
+
+void CompressedHistoryScroll::spillBlocks()
+{
+    if ( _memoryBudget == 0 )
+        return;
+
+    while ( memoryUsage() > _memoryBudget && _firstBlockInMemory < _blocks.size() )
+    {
+        Block& block = _blocks[_firstBlockInMemory];
+
+        if ( !_spillFile )
+            _spillFile = new HistoryFile();
+
+        if ( _spillFile->hasError() )
+        {
+            // the file is not usable, keep the blocks in memory instead
+            qWarning() << "Could not write history blocks to a file, keeping them in memory";
+            _memoryBudget = 0;
+            return;
+        }
+
+        block.spillOffset = _spillFile->len();
+        _spillFile->add ( reinterpret_cast<const unsigned char*>( block.data.constData() ),
+                          block.dataSize );
+        block.data = QByteArray();
+        _memoryBytes -= block.dataSize;
+        _firstBlockInMemory++;
+    }
+}
+
+void CompressedHistoryScroll::setMemoryBudget ( size_t bytes )
+{
+    _memoryBudget = bytes;
+    static_cast<CompressedHistoryType*>(m_histType)->m_memoryBudget = bytes;
+    spillBlocks();
+}
+
+const CompressedHistoryScroll::BlockLines& CompressedHistoryScroll::linesOfBlock ( int blockIndex )
+{
+    if ( blockIndex == _blocks.size() )
+        return _openBlock;
+
+    const quint64 key = _removedBlocks+blockIndex;
+    BlockLines* lines = _cache.object ( key );
+    if ( lines )
+        return *lines;
+
+    const Block& block = _blocks[blockIndex];
+    const char* data = block.data.constData();
+    if ( block.spillOffset >= 0 )
+    {
+        _spilledData.resize ( block.dataSize );
+        _spillFile->get ( reinterpret_cast<unsigned char*>( _spilledData.data() ),
+                          block.dataSize, block.spillOffset );
+        data = _spilledData.constData();
+    }
+
+    const int count = block.cellCount;
+    const int cellBytes = count*sizeof(CompactCharacter);
+    const int lengthBytes = LINES_PER_BLOCK*sizeof(quint32);
+    _planes.resize ( cellBytes+lengthBytes+LINES_PER_BLOCK/8 );
+
+    lines = new BlockLines();
+    lines->wrapped.resize ( LINES_PER_BLOCK );
+    if ( !decompressBlock ( data, block.dataSize, _planes.data(), _planes.size() ) )
+    {
+        // leave the lines blank rather than showing garbage
+        qWarning() << "Could not decompress history block" << key;
+        lines->cells.resize ( count );
+        lines->lineEnds.fill ( 0, LINES_PER_BLOCK );
+        _cache.insert ( key, lines );
+        return *lines;
+    }
+
+    const quint8* planes = reinterpret_cast<const quint8*>( _planes.constData() );
+    lines->cells.resize ( count );
+    CompactCharacter* dest = lines->cells.data();
+    for ( int i=0; i<count; i++ )
+    {
+        quint32 character = 0;
+        quint32 style = 0;
+        for ( int b=0; b<4; b++ )
+        {
+            character |= quint32(planes[b*count+i]) << (8*b);
+            style |= quint32(planes[(4+b)*count+i]) << (8*b);
+        }
+        dest[i] = CompactCharacter ( character, style );
+    }
+
+    const quint8* lengths = planes+cellBytes;
+    const quint8* wrapped = lengths+lengthBytes;
+    lines->lineEnds.resize ( LINES_PER_BLOCK );
+    quint32 end = 0;
+    for ( int line=0; line<LINES_PER_BLOCK; line++ )
+    {
+        quint32 length = 0;
+        for ( int b=0; b<4; b++ )
+            length |= quint32(lengths[b*LINES_PER_BLOCK+line]) << (8*b);
+        end += length;
+        lines->lineEnds[line] = qMin<quint32> ( end, count );
+        lines->wrapped.setBit ( line, wrapped[line/8] & (1 << (line%8)) );
+    }
+
+    _cache.insert ( key, lines );
+    return *lines;
+}
+
+void CompressedHistoryScroll::removeOldestLines ( int count )
+{
+    Q_ASSERT ( count <= _lineCount );
+    _lineCount -= count;
+    _removedLines += count;
+
+    // blocks are dropped as a whole once all of their lines are gone.  The
+    // space of spilled blocks in the file is not reused.
+    while ( _removedLines >= LINES_PER_BLOCK && !_blocks.isEmpty() )
+    {
+        _cache.remove ( _removedBlocks );
+        if ( _firstBlockInMemory > 0 )
+            _firstBlockInMemory--;
+        else
+            _memoryBytes -= _blocks.first().dataSize;
+        _blocks.remove ( 0 );
+        _removedBlocks++;
+        _removedLines -= LINES_PER_BLOCK;
+    }
+}
+
+CharacterStyleTable& CompressedHistoryScroll::stylesForNewLine()
+{
+    return _styles.tableForNewLine ( firstLine()+_lineCount, firstLine() );
+}
+
+void CompressedHistoryScroll::addCells ( const Character a[], int count )
+{
+    BlockLines& block = openBlock();
+    const int start = block.cells.size();
+    block.cells.resize ( start+count );
+    stylesForNewLine().fromCharacters ( a, count, block.cells.data()+start );
+    block.lineEnds.append ( block.cells.size() );
+    _lineCount++;
+
+    if ( _maxLineCount > 0 && _lineCount > (int) _maxLineCount )
+        removeOldestLines ( _lineCount-_maxLineCount );
+}
+
+void CompressedHistoryScroll::addCompactCells ( const CompactCharacter a[], int count,
+                                                const CharacterStyleTable& styles )
+{
+    BlockLines& block = openBlock();
+    const int start = block.cells.size();
+    block.cells.resize ( start+count );
+    stylesForNewLine().translate ( a, count, styles, block.cells.data()+start );
+    block.lineEnds.append ( block.cells.size() );
+    _lineCount++;
+
+    if ( _maxLineCount > 0 && _lineCount > (int) _maxLineCount )
+        removeOldestLines ( _lineCount-_maxLineCount );
+}
+
+void CompressedHistoryScroll::addLine ( bool previousWrapped )
+{
+    if ( _lineCount == 0 )
+        return;
+
+    // the last line is always in the open block
+    _openBlock.wrapped.setBit ( _openBlock.lineEnds.size()-1, previousWrapped );
+}
+
+int CompressedHistoryScroll::getLines()
+{
+    return _lineCount;
+}
+
+int CompressedHistoryScroll::getLineLen ( int lineNumber )
+{
+    int blockIndex, line;
+    locate ( lineNumber, blockIndex, line );
+    const QVector<quint32>& lineEnds = linesOfBlock(blockIndex).lineEnds;
+    return lineEnds[line] - ( line > 0 ? lineEnds[line-1] : 0 );
+}
+
+void CompressedHistoryScroll::getCells ( int lineNumber, int startColumn, int count, Character buffer[] )
+{
+    if ( count == 0 ) return;
+
+    int blockIndex, line;
+    locate ( lineNumber, blockIndex, line );
+    const BlockLines& lines = linesOfBlock ( blockIndex );
+    const int start = line > 0 ? lines.lineEnds[line-1] : 0;
+    Q_ASSERT ( startColumn >= 0 && start+startColumn+count <= (int) lines.lineEnds[line] );
+
+    _styles.at ( firstLine()+lineNumber ).toCharacters ( lines.cells.constData()+start+startColumn, count, buffer );
+}
+
+const CompactCharacter* CompressedHistoryScroll::getCharacterCells ( int lineNumber, CompactCharacter [] )
+{
+    int blockIndex, line;
+    locate ( lineNumber, blockIndex, line );
+    const BlockLines& lines = linesOfBlock ( blockIndex );
+    const int start = line > 0 ? lines.lineEnds[line-1] : 0;
+    return lines.cells.constData()+start;
+}
+
+bool CompressedHistoryScroll::isWrappedLine ( int lineNumber )
+{
+    int blockIndex, line;
+    locate ( lineNumber, blockIndex, line );
+    return linesOfBlock(blockIndex).wrapped.testBit ( line );
+}
+
+void CompressedHistoryScroll::setMaxNbLines ( unsigned int lineCount )
+{
+    _maxLineCount = lineCount;
+    static_cast<CompressedHistoryType*>(m_histType)->m_nbLines = lineCount;
+
+    if ( lineCount > 0 && _lineCount > (int) lineCount )
+        removeOldestLines ( _lineCount-lineCount );
 }
 
 
@@ -987,3 +1648,49 @@ HistoryScroll* CompactHistoryType::scroll ( HistoryScroll *old ) const
     }
     return new CompactHistoryScroll ( m_nbLines );
 }
+
+CompressedHistoryType::CompressedHistoryType ( unsigned int nbLines, size_t memoryBudget )
+    : m_nbLines ( nbLines )
+    , m_memoryBudget ( memoryBudget )
+{
+}
+
+bool CompressedHistoryType::isEnabled() const
+{
+    return true;
+}
+
+int CompressedHistoryType::maximumLineCount() const
+{
+    return m_nbLines;
+}
+
+HistoryScroll* CompressedHistoryType::scroll ( HistoryScroll *old ) const
+{
+    if ( !old )
+        return new CompressedHistoryScroll ( m_nbLines, m_memoryBudget );
+
+    CompressedHistoryScroll *oldScroll = dynamic_cast<CompressedHistoryScroll*> ( old );
+    if ( oldScroll )
+    {
+        oldScroll->setMaxNbLines ( m_nbLines );
+        oldScroll->setMemoryBudget ( m_memoryBudget );
+        return oldScroll;
+    }
+
+    CompressedHistoryScroll *newScroll = new CompressedHistoryScroll ( m_nbLines, m_memoryBudget );
+    const int lines = old->getLines();
+    const int startLine = m_nbLines > 0 ? qMax ( 0, lines - (int) m_nbLines ) : 0;
+
+    QVector<Character> line;
+    for ( int i = startLine; i < lines; i++ )
+    {
+        const int size = old->getLineLen ( i );
+        line.resize ( size );
+        old->getCells ( i, 0, size, line.data() );
+        newScroll->addCells ( line.constData(), size );
+        newScroll->addLine ( old->isWrappedLine(i) );
+    }
+    delete old;
+    return newScroll;
+}
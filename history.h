@@ -30,52 +30,69 @@
 // Own includes
 #include "blockarray.h"
 #include "character.h"
+#include "characterstyle.h"
 
 // System includes
 #include <sys/mman.h>
 
 // Qt
 #include <QBitRef>
+#include <QCache>
 #include <QHash>
 #include <QVector>
 #include <QTemporaryFile>
 
+/**
+ * An append-only temporary file of bytes.
+ *
+ * The file is made of segments of SEGMENT_SIZE bytes.  The last segment is
+ * kept in memory until it is full and then written to the file with a single
+ * call, so adding bytes does not make a system call.  Complete segments
+ * never change again, they are read through a small cache of memory mapped
+ * windows of one segment each, so reading and adding do not get in each
+ * other's way and the file may grow larger than the address space.
+ */
 class HistoryFile {
 public:
     HistoryFile();
     virtual ~HistoryFile();
 
     virtual void add(const unsigned char* bytes, int len);
-    virtual void get(unsigned char* bytes, int len, int loc);
-    virtual int  len();
+    virtual void get(unsigned char* bytes, int len, qint64 loc);
+    virtual qint64 len();
 
-    //mmaps the file in read-only mode
-    void map();
-    //un-mmaps the file
-    void unmap();
-    //returns true if the file is mmap'ed
-    bool isMapped();
+    /** Returns true if bytes could not be written to the file and are lost */
+    bool hasError() const { return error; }
 
+    enum { SEGMENT_SIZE = 1 << 20, MAPPED_WINDOWS = 8 };
 
 private:
+    // writes the last segment, which is full, to the file
+    void writeSegment();
+    // returns the mapped window of a complete segment, or 0 if it cannot be mapped
+    const char* window(qint64 segment);
+
+    struct Window
+    {
+        qint64 segment;
+        char* data;
+        quint64 lastUse;
+    };
+
     int  ion;
-    int  length;
+    qint64 length;
+    // the number of bytes in the segments written to the file
+    qint64 fileLength;
+    bool error;
     QTemporaryFile tmpFile;
 
-    //pointer to start of mmap'ed file data, or 0 if the file is not mmap'ed
-    char* fileMap;
+    // the bytes of the last segment, which is not in the file yet
+    QByteArray tail;
 
-    //incremented whenver 'add' is called and decremented whenever
-    //'get' is called.
-    //this is used to detect when a large number of lines are being read and processed from the history
-    //and automatically mmap the file for better performance (saves the overhead of many lseek-read calls).
-    int readWriteBalance;
-
-    //when readWriteBalance goes below this threshold, the file will be mmap'ed automatically
-    static const int MAP_THRESHOLD = -1000;
+    Window windows[MAPPED_WINDOWS];
+    quint64 useCount;
 };
 
-
 //////////////////////////////////////////////////////////////////////
 
 //////////////////////////////////////////////////////////////////////
@@ -97,6 +114,19 @@ public:
     virtual void getCells(int lineno, int colno, int count, Character res[]) = 0;
     virtual bool isWrappedLine(int lineno) = 0;
 
+    // copies the first @p stride cells of @p count lines, starting with line
+    // @p lineno, into @p res.  the cells of each line start at a multiple of
+    // @p stride, cells after the end of a shorter line are left untouched.
+    // The default implementation calls getCells() for each line.
+    virtual void getCellsOfLines(int lineno, int count, int stride, Character res[]);
+
+    // returns the cells of line @p lineno for looking at their characters,
+    // their styles are not meaningful.  Histories which keep CompactCharacters
+    // return their own storage, which is valid until the history is changed
+    // or read from again, others copy the characters into @p buffer, which
+    // has room for getLineLen() cells.  The default implementation calls getCells().
+    virtual const CompactCharacter* getCharacterCells(int lineno, CompactCharacter buffer[]);
+
     // backward compatibility (obsolete)
     Character   getCell(int lineno, int colno) { Character res; getCells(lineno,colno,1,&res); return res; }
 
@@ -108,6 +138,10 @@ public:
     {
         addCells(cells.data(),cells.size());
     }
+    // adds characters as they are stored by Screen, whose styles are indexes
+    // into @p styles.  The default implementation converts them into Characters.
+    virtual void addCompactCells(const CompactCharacter a[], int count,
+                                 const CharacterStyleTable& styles);
 
     virtual void addLine(bool previousWrapped=false) = 0;
 
@@ -142,10 +176,10 @@ public:
     virtual void addLine(bool previousWrapped=false);
 
 private:
-    int startOfLine(int lineno);
+    qint64 startOfLine(int lineno);
 
     QString m_logFileName;
-    HistoryFile index; // lines Row(int)
+    HistoryFile index; // lines Row(qint64)
     HistoryFile cells; // text  Row(Character)
     HistoryFile lineflags; // flags Row(unsigned char)
 };
@@ -157,7 +191,7 @@ private:
 class HistoryScrollBuffer : public HistoryScroll
 {
 public:
-    typedef QVector<Character> HistoryLine;
+    typedef QVector<CompactCharacter> HistoryLine;
 
     HistoryScrollBuffer(unsigned int maxNbLines = 1000);
     virtual ~HistoryScrollBuffer();
@@ -165,10 +199,12 @@ public:
     virtual int  getLines();
     virtual int  getLineLen(int lineno);
     virtual void getCells(int lineno, int colno, int count, Character res[]);
+    virtual const CompactCharacter* getCharacterCells(int lineno, CompactCharacter buffer[]);
     virtual bool isWrappedLine(int lineno);
 
     virtual void addCells(const Character a[], int count);
-    virtual void addCellsVector(const QVector<Character>& cells);
+    virtual void addCompactCells(const CompactCharacter a[], int count,
+                                 const CharacterStyleTable& styles);
     virtual void addLine(bool previousWrapped=false);
 
     void setMaxNbLines(unsigned int nbLines);
@@ -177,8 +213,13 @@ public:
 
 private:
     int bufferIndex(int lineNumber);
+    // returns the line to store the next line of output in
+    HistoryLine& nextLine();
+    // removes the styles no line uses from _styles
+    void compactStyles();
 
     HistoryLine* _historyBuffer;
+    CharacterStyleTable _styles;
     QBitArray _wrappedLine;
     int _maxLineCount;
     int _usedLines;
@@ -208,6 +249,15 @@ public:
 //////////////////////////////////////////////////////////////////////
 // BlockArray-based history
 //////////////////////////////////////////////////////////////////////
+/**
+ * A history of at most @p size lines, stored in the blocks of a BlockArray.
+ *
+ * The cells of all lines run through the blocks one after another, a line
+ * which does not fit into the rest of a block continues in the next one, so
+ * lines can be of any length.  The position of each line in this stream of
+ * cells is kept in memory.  When the BlockArray drops its oldest block, the
+ * lines starting in it are dropped as well.
+ */
 class HistoryScrollBlockArray : public HistoryScroll
 {
 public:
@@ -217,14 +267,38 @@ public:
     virtual int  getLines();
     virtual int  getLineLen(int lineno);
     virtual void getCells(int lineno, int colno, int count, Character res[]);
+    virtual const CompactCharacter* getCharacterCells(int lineno, CompactCharacter buffer[]);
     virtual bool isWrappedLine(int lineno);
 
     virtual void addCells(const Character a[], int count);
+    virtual void addCompactCells(const CompactCharacter a[], int count,
+                                 const CharacterStyleTable& styles);
     virtual void addLine(bool previousWrapped=false);
 
 protected:
+    // appends bytes to the stream of cells
+    void appendBytes(const char* bytes, int count);
+    // reads bytes from the stream of cells, bytes which are no longer
+    // available are read as zeros
+    void readBytes(quint64 position, char* bytes, int count);
+    // records the start of a new line at the current end of the stream
+    void startLine();
+    quint64 startOfLine(int lineno) const;
+    // removes the lines which exceed the size or whose start has been dropped
+    void removeOldLines();
+    // returns the table of styles for the line which is added next
+    CharacterStyleTable& stylesForNewLine();
+
     BlockArray m_blockArray;
-    QHash<int,size_t> m_lineLengths;
+    // the styles of the lines by the position of their start in the stream
+    CharacterStyleGenerations m_styles;
+    // the position of each line in the stream, LINE_WRAPPED is set for
+    // wrapped lines.  Lines before m_firstLine have been removed.
+    QVector<quint64> m_lineStarts;
+    int m_firstLine;
+    // the length of the stream
+    quint64 m_length;
+    size_t m_maxLines;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -280,6 +354,8 @@ public:
     virtual bool contains(void *addr) {return addr>=blockStart && addr<(blockStart+blockLength);}
     virtual void deallocate();
     virtual bool isInUse(){ return allocCount!=0; } ;
+    // forgets all allocations, so that the block can be used again
+    virtual void reset() { tail = blockStart; allocCount = 0; }
 
 private:
     size_t blockLength;
@@ -289,16 +365,38 @@ private:
     int allocCount;
 };
 
+/**
+ * The memory of the lines of a CompactHistoryScroll.
+ *
+ * Memory is handed out from the newest block only, and history lines are
+ * released in the order in which they were added, so the blocks run empty
+ * oldest first.  Empty blocks are released from the front of the list, which
+ * keeps the reserved memory within a block or two of the memory in use.  One
+ * released block is kept for reuse, so that a full history does not map and
+ * unmap a block every few thousand lines.
+ */
 class CompactHistoryBlockList {
 public:
-    CompactHistoryBlockList() {};
+    CompactHistoryBlockList();
     ~CompactHistoryBlockList();
 
     void *allocate( size_t size );
-    void deallocate(void *);
+    // 'size' is the size which was passed to allocate()
+    void deallocate(void *, size_t size);
     int length() {return list.size();}
+
+    /** Returns the number of bytes of the allocations which are still in use */
+    size_t bytesInUse() const { return _bytesInUse; }
+    /** Returns the number of bytes of the blocks which are mapped, including the spare block */
+    size_t bytesReserved() const { return _bytesReserved; }
+
 private:
-    QList<CompactHistoryBlock*> list;
+    void releaseUnusedBlocks();
+
+    QList<CompactHistoryBlock*> list; // oldest block first
+    CompactHistoryBlock* spare;
+    size_t _bytesInUse;
+    size_t _bytesReserved;
 };
 
 class CompactHistoryLine
@@ -313,11 +411,15 @@ public:
 
     virtual void getCharacters(Character* array, int length, int startColumn) ;
     virtual void getCharacter(int index, Character &r) ;
+    quint16 characterAt(int index) const { return text[index]; }
     virtual bool isWrapped() const {return wrapped;};
     virtual void setWrapped(bool isWrapped) { wrapped=isWrapped;};
     virtual unsigned int getLength() const {return length;};
 
 protected:
+    // returns the index of the format which applies to 'column'
+    int formatIndex(int column) const;
+
     CompactHistoryBlockList& blockList;
     CharacterFormat* formatArray;
     quint16 length;
@@ -328,8 +430,6 @@ protected:
 
 class CompactHistoryScroll : public HistoryScroll
 {
-    typedef QList<CompactHistoryLine*> HistoryArray;
-
 public:
     CompactHistoryScroll(unsigned int maxNbLines = 1000);
     virtual ~CompactHistoryScroll();
@@ -337,6 +437,8 @@ public:
     virtual int  getLines();
     virtual int  getLineLen(int lineno);
     virtual void getCells(int lineno, int colno, int count, Character res[]);
+    virtual const CompactCharacter* getCharacterCells(int lineno, CompactCharacter buffer[]);
+    virtual void getCellsOfLines(int lineno, int count, int stride, Character res[]);
     virtual bool isWrappedLine(int lineno);
 
     virtual void addCells(const Character a[], int count);
@@ -346,14 +448,153 @@ public:
     void setMaxNbLines(unsigned int nbLines);
     unsigned int maxNbLines() const { return _maxLineCount; }
 
+    /** Returns the number of bytes used by the lines in the history */
+    size_t bytesInUse() const { return blockList.bytesInUse(); }
+    /** Returns the number of bytes reserved for the lines in the history */
+    size_t bytesReserved() const { return blockList.bytesReserved(); }
+
 private:
     bool hasDifferentColors(const TextLine& line) const;
-    HistoryArray lines;
+    CompactHistoryLine* lineAt(int lineNumber) const;
+    void appendLine(CompactHistoryLine* line);
+    void removeOldestLine();
+
+    // the lines form a ring which grows when it is full, the oldest
+    // line is at _head
+    QVector<CompactHistoryLine*> _lines;
+    int _head;
+    int _usedLines;
     CompactHistoryBlockList blockList;
 
     unsigned int _maxLineCount;
 };
 
+//////////////////////////////////////////////////////////////////////
+// Compressed history (lines packed into blocks which are compressed
+// once they are full)
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A history which packs its lines into blocks of LINES_PER_BLOCK lines and
+ * compresses a block with compressBlock() once it is full.  The cells are
+ * split into byte planes before they are compressed, as the high bytes of
+ * characters and styles are nearly always zero.  The lengths and wrap
+ * flags of the lines are compressed along with them.
+ *
+ * The newest block is kept as it is until it is full.  A few decompressed
+ * blocks are cached, so scrolling through the recent history decompresses
+ * each block once.
+ *
+ * With a memory budget, the compressed blocks are kept in memory until the
+ * history takes more than the budget.  Then the oldest of them are written
+ * to an append-only HistoryFile and read back from it when they are
+ * needed.  Of a block in the file, only its size and position stay in
+ * memory, some 24 bytes for LINES_PER_BLOCK lines.  The styles of the
+ * lines stay in memory as well, see CharacterStyleGenerations.
+ *
+ * A maximum of 0 lines means that the number of lines is unlimited.
+ */
+class CompressedHistoryScroll : public HistoryScroll
+{
+public:
+    CompressedHistoryScroll(unsigned int maxNbLines = 1000, size_t memoryBudget = 0);
+    virtual ~CompressedHistoryScroll();
+
+    virtual int  getLines();
+    virtual int  getLineLen(int lineno);
+    virtual void getCells(int lineno, int colno, int count, Character res[]);
+    virtual const CompactCharacter* getCharacterCells(int lineno, CompactCharacter buffer[]);
+    virtual bool isWrappedLine(int lineno);
+
+    virtual void addCells(const Character a[], int count);
+    virtual void addCompactCells(const CompactCharacter a[], int count,
+                                 const CharacterStyleTable& styles);
+    virtual void addLine(bool previousWrapped=false);
+
+    void setMaxNbLines(unsigned int nbLines);
+    unsigned int maxNbLines() const { return _maxLineCount; }
+
+    /**
+     * Sets the number of bytes of memory the history may take before its
+     * oldest blocks are written to a file, 0 to keep all of them in memory.
+     */
+    void setMemoryBudget(size_t bytes);
+    size_t memoryBudget() const { return _memoryBudget; }
+    /** Returns the number of bytes of compressed blocks in memory */
+    size_t compressedBytesInMemory() const { return _memoryBytes; }
+    /**
+     * Returns the number of bytes of memory the history takes, which is
+     * what the budget limits.  The few cached blocks are not counted.
+     */
+    size_t memoryUsage() const;
+
+    enum { LINES_PER_BLOCK = 128, CACHED_BLOCKS = 4 };
+
+private:
+    // a full block, which has been compressed
+    struct Block
+    {
+        Block() : cellCount(0), dataSize(0), spillOffset(-1) {}
+
+        int cellCount;
+        // the compressed lines, unless they have been written to the spill file
+        QByteArray data;
+        int dataSize;
+        // the position of the compressed lines in the spill file, or -1
+        qint64 spillOffset;
+    };
+
+    // the lines of the block which is not full yet, or of a decompressed block
+    struct BlockLines
+    {
+        QVector<CompactCharacter> cells;
+        // the end of each line, as an offset into the cells
+        QVector<quint32> lineEnds;
+        QBitArray wrapped;
+    };
+
+    // returns the lines to add the next line to, sealing them if they are full
+    BlockLines& openBlock();
+    // compresses the lines of the open block into a new block
+    void sealBlock();
+    // returns the lines of a block, decompressing them if necessary.  The
+    // open block comes after the compressed ones.
+    const BlockLines& linesOfBlock(int blockIndex);
+    void removeOldestLines(int count);
+    void locate(int lineNumber, int& blockIndex, int& line) const;
+    // writes the oldest blocks in memory to the spill file until the history fits the budget
+    void spillBlocks();
+    // returns the number of lines removed since the history was created
+    quint64 firstLine() const { return _removedBlocks*LINES_PER_BLOCK+_removedLines; }
+    // returns the table of styles for the line which is added next
+    CharacterStyleTable& stylesForNewLine();
+
+    // the compressed blocks, oldest first
+    QVector<Block> _blocks;
+    BlockLines _openBlock;
+    // the number of lines at the start of the first block which have been removed
+    int _removedLines;
+    // the number of blocks removed so far, blocks are cached by their number
+    // since the history was created
+    quint64 _removedBlocks;
+    int _lineCount;
+    unsigned int _maxLineCount;
+
+    size_t _memoryBudget;
+    // the number of bytes of the compressed blocks in memory
+    size_t _memoryBytes;
+    // blocks before this one have been written to the spill file
+    int _firstBlockInMemory;
+    HistoryFile* _spillFile;
+
+    // the styles of the lines by the number of lines before them since
+    // the history was created
+    CharacterStyleGenerations _styles;
+    QCache<quint64, BlockLines> _cache;
+    QByteArray _planes;
+    QByteArray _spilledData;
+};
+
 //////////////////////////////////////////////////////////////////////
 // History type
 //////////////////////////////////////////////////////////////////////
@@ -451,3 +692,26 @@ public:
 protected:
     unsigned int m_nbLines;
 };
+
+/**
+ * A CompressedHistoryScroll of @p nbLines lines, or of unlimited lines if
+ * @p nbLines is 0.  With a @p memoryBudget, the recent lines are kept as
+ * they are, older lines compressed in memory and the oldest in a file.
+ */
+class CompressedHistoryType : public HistoryType
+{
+    friend class CompressedHistoryScroll;
+
+public:
+    CompressedHistoryType(unsigned int nbLines, size_t memoryBudget = 0);
+
+    virtual bool isEnabled() const;
+    virtual int maximumLineCount() const;
+    size_t memoryBudget() const { return m_memoryBudget; }
+
+    virtual HistoryScroll* scroll(HistoryScroll *) const;
+
+protected:
+    unsigned int m_nbLines;
+    size_t m_memoryBudget;
+};
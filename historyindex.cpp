@@ -0,0 +1,264 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "historyindex.h"
+#include "konsole_wcwidth.h"
+
+// System includes
+#include <algorithm>
+
+static const quint64 TRIGRAM_MASK = (Q_UINT64_C(1) << 48) - 1;
+static const quint32 NO_BLOCK = 0xffffffff;
+
+HistoryIndex::HistoryIndex(size_t memoryLimit, quint64 nextLine)
+    : _memoryLimit(memoryLimit)
+{
+    reset(nextLine);
+}
+
+void HistoryIndex::reset(quint64 nextLine)
+{
+    _blocks.clear();
+    _blockBytes = 0;
+    _baseLine = nextLine;
+    _firstLine = nextLine;
+    _endLine = nextLine;
+    _firstListedBlock = 0;
+    _currentBlock = 0;
+    _window = 0;
+    _windowLength = 0;
+
+    SeenTrigram unused = { 0, NO_BLOCK };
+    _seen.fill(unused, SEEN_SIZE);
+}
+
+void HistoryIndex::addLine(const CompactCharacter* cells, int count, bool wrapped)
+{
+    _currentBlock = blockOf(_endLine);
+
+    // the same characters as PlainTextDecoder gives for the line, which
+    // skips the cells taken by the right half of wide characters
+    for (int i = 0; i < count; )
+    {
+        const quint16 c = quint16(cells[i].character);
+        addCharacter(QChar(c).toCaseFolded());
+        i += qMax(1, konsole_wcwidth(c));
+    }
+
+    // the text of a line which is not wrapped is followed by a line break,
+    // which is not part of any text the index finds
+    if (!wrapped)
+        _windowLength = 0;
+
+    _endLine++;
+    enforceMemoryLimit();
+}
+
+void HistoryIndex::addCharacter(QChar c)
+{
+    _window = ((_window << 16) | c.unicode()) & TRIGRAM_MASK;
+    if (_windowLength < 2)
+    {
+        _windowLength++;
+        return;
+    }
+    addTrigram(_window);
+}
+
+void HistoryIndex::addTrigram(Trigram trigram)
+{
+    // most trigrams occur more than once in a block, the cache of the
+    // trigrams seen in the current block saves looking those up again
+    SeenTrigram& seen = _seen[int((trigram * Q_UINT64_C(0x9e3779b97f4a7c15)) >> 54)];
+    if (seen.trigram == trigram && seen.block == _currentBlock)
+        return;
+    seen.trigram = trigram;
+    seen.block = _currentBlock;
+
+    BlockList& list = _blocks[trigram];
+    if (!list.isEmpty() && list.last() == _currentBlock)
+        return;
+
+    const int capacity = list.capacity();
+    list.append(_currentBlock);
+    _blockBytes += (list.capacity() - capacity) * sizeof(quint32);
+}
+
+void HistoryIndex::removeLinesBefore(quint64 line)
+{
+    if (line <= _firstLine)
+        return;
+    _firstLine = qMin(line, _endLine);
+
+    // the lists are cleaned up once most of the blocks in them are gone,
+    // which keeps the cost of removing a line constant on average
+    const quint32 firstBlock = blockOf(_firstLine);
+    const quint32 deadBlocks = firstBlock - _firstListedBlock;
+    const quint32 liveBlocks = _currentBlock - firstBlock + 1;
+    if (_firstLine == _endLine || deadBlocks > liveBlocks)
+        compact();
+}
+
+void HistoryIndex::compact()
+{
+    if (_firstLine == _endLine)
+    {
+        reset(_endLine);
+        return;
+    }
+
+    const quint32 firstBlock = blockOf(_firstLine);
+    if (firstBlock == _firstListedBlock)
+        return;
+
+    _blockBytes = 0;
+    QHash<Trigram, BlockList>::iterator it = _blocks.begin();
+    while (it != _blocks.end())
+    {
+        BlockList& list = it.value();
+        BlockList::iterator live = std::lower_bound(list.begin(), list.end(), firstBlock);
+        if (live == list.end())
+        {
+            it = _blocks.erase(it);
+            continue;
+        }
+
+        if (live != list.begin())
+        {
+            list.erase(list.begin(), live);
+            list.squeeze();
+        }
+        _blockBytes += list.capacity() * sizeof(quint32);
+        ++it;
+    }
+    _firstListedBlock = firstBlock;
+}
+
+void HistoryIndex::enforceMemoryLimit()
+{
+    if (memoryUsage() <= _memoryLimit)
+        return;
+
+    compact();
+
+    // forget a good part of the lines at once, so that this does not
+    // happen again with the next line
+    while (memoryUsage() > _memoryLimit && _firstLine < _endLine)
+    {
+        const quint64 lines = qMax<quint64>(LINES_PER_BLOCK, (_endLine - _firstLine) / 4);
+        const quint32 block = blockOf(qMin(_firstLine + lines, _endLine));
+        _firstLine = qMin(_baseLine + quint64(block) * LINES_PER_BLOCK, _endLine);
+        if (block == _firstListedBlock)
+            _firstLine = _endLine;
+        compact();
+    }
+}
+
+bool HistoryIndex::canFind(const QString& text)
+{
+    // every line of a match which continues on the next line holds at least
+    // one of its characters, so text shorter than a block of lines starts in
+    // the block before the one it ends in at the earliest
+    return text.size() >= 3 && text.size() < LINES_PER_BLOCK &&
+           !text.contains(QLatin1Char('\n'));
+}
+
+QVector<HistoryIndex::LineRange> HistoryIndex::candidateLines(const QString& text,
+                                                              quint64 first, quint64 last) const
+{
+    QVector<LineRange> ranges;
+    if (!canFind(text) || first > last || _firstLine == _endLine)
+        return ranges;
+
+    const quint64 lastIndexed = qMin(last, _endLine - 1);
+    const quint64 firstIndexed = qMax(first, _firstLine);
+    if (firstIndexed > lastIndexed)
+        return ranges;
+
+    // the lists of blocks of the trigrams of the text, shortest first
+    QVector<const BlockList*> lists;
+    Trigram window = 0;
+    for (int i = 0; i < text.size(); i++)
+    {
+        window = ((window << 16) | text.at(i).toCaseFolded().unicode()) & TRIGRAM_MASK;
+        if (i < 2)
+            continue;
+
+        QHash<Trigram, BlockList>::const_iterator it = _blocks.constFind(window);
+        if (it == _blocks.constEnd())
+            return ranges;
+        if (!lists.contains(&it.value()))
+            lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const BlockList* a, const BlockList* b) { return a->size() < b->size(); });
+
+    // text which starts in a block may end in the next one, so a block is
+    // a candidate if every trigram occurs in it or in the next one
+    const quint32 firstBlock = blockOf(firstIndexed);
+    const quint32 lastBlock = blockOf(lastIndexed);
+    const BlockList& shortest = *lists.first();
+    quint32 nextCandidate = firstBlock;
+
+    BlockList::const_iterator b = std::lower_bound(shortest.constBegin(), shortest.constEnd(), firstBlock);
+    for (; b != shortest.constEnd() && *b <= lastBlock + 1; ++b)
+    {
+        for (quint32 block = qMax(nextCandidate, *b == 0 ? 0 : *b - 1); block <= qMin(*b, lastBlock); block++)
+        {
+            nextCandidate = block + 1;
+
+            bool candidate = true;
+            for (int i = 1; i < lists.size() && candidate; i++)
+            {
+                const BlockList& list = *lists.at(i);
+                BlockList::const_iterator found = std::lower_bound(list.constBegin(), list.constEnd(), block);
+                candidate = found != list.constEnd() && *found <= block + 1;
+            }
+            if (!candidate)
+                continue;
+
+            // a match starting in the block may continue on the lines of the next
+            LineRange range;
+            range.first = qMax(first, _baseLine + quint64(block) * LINES_PER_BLOCK);
+            range.last = qMin(last, _baseLine + quint64(block + 2) * LINES_PER_BLOCK - 1);
+            if (!ranges.isEmpty() && range.first <= ranges.last().last + 1)
+                ranges.last().last = qMax(ranges.last().last, range.last);
+            else
+                ranges.append(range);
+        }
+    }
+
+    return ranges;
+}
+
+size_t HistoryIndex::memoryUsage() const
+{
+    return sizeof(HistoryIndex) + _seen.size() * sizeof(SeenTrigram) +
+           _blocks.size() * ENTRY_OVERHEAD + _blockBytes;
+}
+
+void HistoryIndex::setMemoryLimit(size_t bytes)
+{
+    _memoryLimit = bytes;
+    enforceMemoryLimit();
+}
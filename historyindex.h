@@ -0,0 +1,145 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Own includes
+#include "characterstyle.h"
+
+// Qt includes
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * A trigram index over the lines of a history, which tells which lines may
+ * contain a piece of text, so that a search does not have to look at all
+ * of them.
+ *
+ * Lines are identified by the number of lines added to the history before
+ * them, like HistorySearch does, so line numbers do not change when the
+ * oldest lines are removed from the history.  The lines are grouped into
+ * blocks of LINES_PER_BLOCK lines, and the index keeps a list of blocks for
+ * every trigram of case folded text in them.  A line which continues a
+ * wrapped line gets the trigrams which span both lines as well.
+ *
+ * The index takes at most memoryLimit() bytes.  When it needs more, it
+ * forgets its oldest lines; firstLine() tells the first line it knows.
+ */
+class HistoryIndex
+{
+public:
+    /** A range of lines, from @p first to @p last inclusive */
+    struct LineRange
+    {
+        quint64 first;
+        quint64 last;
+    };
+
+    /**
+     * Constructs an empty index, which takes up to @p memoryLimit bytes.
+     * The first line added is line @p nextLine.
+     */
+    HistoryIndex(size_t memoryLimit, quint64 nextLine);
+
+    /** Forgets all lines, the next line added is line @p nextLine */
+    void reset(quint64 nextLine);
+
+    /** Adds the next line, with @p count characters from @p cells */
+    void addLine(const CompactCharacter* cells, int count, bool wrapped);
+
+    /** Forgets the lines before @p line, after they were removed from the history */
+    void removeLinesBefore(quint64 line);
+
+    /** Returns the first line the index knows */
+    quint64 firstLine() const { return _firstLine; }
+    /** Returns the line after the last line added */
+    quint64 endLine() const { return _endLine; }
+
+    /**
+     * Returns true if the index can find the lines with @p text.  That is the
+     * case for text of at least three characters, which does not span more
+     * than two blocks of lines.
+     */
+    static bool canFind(const QString& text);
+
+    /**
+     * Returns the ranges of lines, between @p first and @p last, in which @p text
+     * may start, in ascending order.  A range includes the lines after it which a
+     * match starting in it may continue on.  Only lines from firstLine() to
+     * endLine() are looked at, see canFind().
+     */
+    QVector<LineRange> candidateLines(const QString& text, quint64 first, quint64 last) const;
+
+    /** Returns the approximate number of bytes the index takes */
+    size_t memoryUsage() const;
+
+    /** Sets the number of bytes the index may take, forgetting old lines if necessary */
+    void setMemoryLimit(size_t bytes);
+    size_t memoryLimit() const { return _memoryLimit; }
+
+private:
+    typedef quint64 Trigram;
+    typedef QVector<quint32> BlockList;
+
+    void addCharacter(QChar c);
+    void addTrigram(Trigram trigram);
+    // drops the blocks before _firstLine from the lists
+    void compact();
+    // forgets old lines until the index fits into its memory limit
+    void enforceMemoryLimit();
+
+    quint32 blockOf(quint64 line) const { return quint32((line - _baseLine) / LINES_PER_BLOCK); }
+
+    // a trigram added to a block
+    struct SeenTrigram
+    {
+        Trigram trigram;
+        quint32 block;
+    };
+
+    static const int LINES_PER_BLOCK = 64;
+    static const int SEEN_SIZE = 1024;
+    // the memory taken by a trigram's entry in the hash besides its list of blocks
+    static const size_t ENTRY_OVERHEAD = 64;
+
+    // the blocks each trigram occurs in, in ascending order
+    QHash<Trigram, BlockList> _blocks;
+    // the bytes allocated for the block lists
+    size_t _blockBytes;
+    size_t _memoryLimit;
+
+    // line 0 of block 0
+    quint64 _baseLine;
+    quint64 _firstLine;
+    quint64 _endLine;
+    // the first block in the lists, blocks before _firstLine's are dropped by compact()
+    quint32 _firstListedBlock;
+    quint32 _currentBlock;
+
+    // the trigrams added to blocks lately, by hash
+    QVector<SeenTrigram> _seen;
+
+    // the last two characters, which form trigrams with the next one
+    Trigram _window;
+    int _windowLength;
+};
@@ -0,0 +1,364 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "historymatches.h"
+#include "literalmatcher.h"
+#include "terminalemulation.h"
+
+// System includes
+#include <algorithm>
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QTimer>
+
+void HistoryMatches::MatchList::clear()
+{
+    matches.clear();
+    first = 0;
+}
+
+bool HistoryMatches::MatchList::removeBefore(quint64 line)
+{
+    const int oldFirst = first;
+    first = lowerBound(line);
+    const bool removed = first != oldFirst;
+
+    // the forgotten matches are dropped once they make up half of the list,
+    // which keeps forgetting cheap while lines drop out of the history
+    if (first > 0 && first >= matches.size() / 2)
+    {
+        matches.remove(0, first);
+        first = 0;
+    }
+    return removed;
+}
+
+static bool sameMatches(const QVector<HistorySearchMatch>& a, const QVector<HistorySearchMatch>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < a.size(); i++)
+    {
+        if (a.at(i).startLine != b.at(i).startLine || a.at(i).endLine != b.at(i).endLine ||
+            a.at(i).startColumn != b.at(i).startColumn || a.at(i).endColumn != b.at(i).endColumn)
+            return false;
+    }
+    return true;
+}
+
+static bool startsBefore(const HistorySearchMatch& match, quint64 line)
+{
+    return match.startLine < line;
+}
+
+int HistoryMatches::MatchList::lowerBound(quint64 line) const
+{
+    return int(std::lower_bound(matches.constBegin() + first, matches.constEnd(), line, startsBefore) -
+               matches.constBegin());
+}
+
+void HistoryMatches::MatchList::collect(quint64 firstLine, quint64 lastLine,
+                                        QVector<HistorySearchMatch>& result) const
+{
+    for (int i = lowerBound(firstLine); i < matches.size() && matches.at(i).startLine <= lastLine; i++)
+        result.append(matches.at(i));
+}
+
+HistoryMatches::HistoryMatches(EmulationPtr emulation, QObject* parent)
+    : QObject(parent),
+      _emulation(emulation),
+      _matcher(0),
+      _historySearchEnd(0),
+      _searchedEnd(0),
+      _searchScheduled(false)
+{
+    if (_emulation)
+    {
+        connect(_emulation, SIGNAL(outputChanged()), this, SLOT(outputChanged()));
+        connect(_emulation, SIGNAL(currentScreenChanged()), this, SLOT(restart()));
+    }
+}
+
+HistoryMatches::~HistoryMatches()
+{
+    if (_historySearch)
+        _historySearch->cancel();
+    delete _matcher;
+}
+
+void HistoryMatches::setRegExp(const CompiledRegExp& regExp)
+{
+    const CompiledRegExp newRegExp = regExp.isEmpty() ? CompiledRegExp() : regExp;
+    if (newRegExp == _regExp)
+        return;
+
+    _regExp = newRegExp;
+    restart();
+}
+
+int HistoryMatches::count() const
+{
+    return _historyMatches.size() + _newMatches.size() + _screenMatches.size();
+}
+
+bool HistoryMatches::isComplete() const
+{
+    return !_historySearch && !_searchScheduled;
+}
+
+QVector<HistorySearchMatch> HistoryMatches::matches(int firstLine, int lastLine) const
+{
+    QVector<HistorySearchMatch> result;
+    if (!_emulation || firstLine > lastLine)
+        return result;
+
+    const quint64 removed = _emulation->removedLineCount();
+    const quint64 first = removed + qMax(0, firstLine);
+    const quint64 last = removed + qMax(0, lastLine);
+
+    _historyMatches.collect(first, last, result);
+    _newMatches.collect(first, last, result);
+    foreach (const HistorySearchMatch& match, _screenMatches)
+    {
+        if (match.startLine >= first && match.startLine <= last)
+            result.append(match);
+    }
+
+    for (int i = 0; i < result.size(); i++)
+    {
+        result[i].startLine -= removed;
+        result[i].endLine -= removed;
+    }
+    return result;
+}
+
+QBitArray HistoryMatches::linesWithMatches(int parts) const
+{
+    QBitArray result(qMax(0, parts));
+    if (!_emulation || parts <= 0 || count() == 0)
+        return result;
+
+    const quint64 removed = _emulation->removedLineCount();
+    const qint64 lineCount = _emulation->lineCount();
+    for (int part = 0; part < parts; part++)
+    {
+        const quint64 first = removed + quint64(lineCount * part / parts);
+        const quint64 last = removed + quint64(qMax(lineCount * (part + 1) / parts - 1, lineCount * part / parts));
+
+        int i = _historyMatches.lowerBound(first);
+        bool found = i < _historyMatches.matches.size() && _historyMatches.matches.at(i).startLine <= last;
+        if (!found)
+        {
+            i = _newMatches.lowerBound(first);
+            found = i < _newMatches.matches.size() && _newMatches.matches.at(i).startLine <= last;
+        }
+        for (int j = 0; j < _screenMatches.size() && !found; j++)
+            found = _screenMatches.at(j).startLine >= first && _screenMatches.at(j).startLine <= last;
+
+        result.setBit(part, found);
+    }
+    return result;
+}
+
+void HistoryMatches::restart()
+{
+    if (_historySearch)
+        _historySearch->cancel();
+    _historySearch = 0;
+    _searchScheduled = false;
+
+    _historyMatches.clear();
+    _newMatches.clear();
+    _screenMatches.clear();
+    delete _matcher;
+    _matcher = 0;
+
+    if (_regExp.isEmpty() || !_emulation)
+    {
+        emit matchesChanged();
+        return;
+    }
+
+    const QString text = _regExp.literalText();
+    if (LiteralMatcher::canMatch(text))
+        _matcher = new LiteralMatcher(text, _regExp.caseSensitivity());
+
+    const quint64 removed = _emulation->removedLineCount();
+    const int historyLines = _emulation->lineCount() - _emulation->imageSize().height();
+    _historySearchEnd = removed + quint64(qMax(0, historyLines));
+    _searchedEnd = _historySearchEnd;
+
+    if (historyLines > 0)
+    {
+        // the search may report matches before search() returns
+        _historySearch = new HistorySearch(_emulation, _regExp, true, 0, 0, this);
+        connect(_historySearch, SIGNAL(matchFound(int,int,int,int)),
+                this, SLOT(historyMatchFound(int,int,int,int)));
+        connect(_historySearch, SIGNAL(progress(int,int)), this, SIGNAL(matchesChanged()));
+        connect(_historySearch, SIGNAL(finished()), this, SLOT(historySearchFinished()));
+        _historySearch->search();
+    }
+
+    findNewMatches();
+    emit matchesChanged();
+}
+
+void HistoryMatches::historyMatchFound(int startColumn, int startLine, int endColumn, int endLine)
+{
+    if (!_emulation || sender() != _historySearch.data())
+        return;
+
+    // the search reports the matches at the line numbers they have now, it
+    // also searches the screen, whose matches searchNewLines() keeps
+    const quint64 removed = _emulation->removedLineCount();
+    HistorySearchMatch match = { removed + quint64(startLine), removed + quint64(endLine),
+                                 startColumn, endColumn };
+    if (match.endLine < _historySearchEnd)
+        _historyMatches.matches.append(match);
+}
+
+void HistoryMatches::historySearchFinished()
+{
+    if (sender() != _historySearch.data())
+        return;
+
+    _historySearch = 0;
+    emit matchesChanged();
+}
+
+void HistoryMatches::outputChanged()
+{
+    if (_regExp.isEmpty() || !_emulation)
+        return;
+
+    // a new history takes the place of the old one when it is cleared,
+    // its lines count as removed as well
+    const quint64 removed = _emulation->removedLineCount();
+    bool changed = _historyMatches.removeBefore(removed);
+    changed = _newMatches.removeBefore(removed) || changed;
+
+    if (!_searchScheduled)
+    {
+        changed = findNewMatches() || changed;
+        // the count is not final while many new lines wait to be searched
+        changed = _searchScheduled || changed;
+    }
+
+    // most output adds no matches, and repainting for it would be wasted
+    if (changed)
+        emit matchesChanged();
+}
+
+void HistoryMatches::scheduleSearch()
+{
+    if (_searchScheduled)
+        return;
+    _searchScheduled = true;
+    QTimer::singleShot(0, this, SLOT(searchNewLines()));
+}
+
+void HistoryMatches::searchNewLines()
+{
+    _searchScheduled = false;
+
+    // the count is final once the search got to the last line
+    if (findNewMatches() || !_searchScheduled)
+        emit matchesChanged();
+}
+
+bool HistoryMatches::findNewMatches()
+{
+    if (_regExp.isEmpty() || !_emulation)
+        return false;
+
+    const int oldCount = _newMatches.size();
+
+    const int lineCount = _emulation->lineCount();
+    const quint64 removed = _emulation->removedLineCount();
+    const quint64 historyEnd = removed + quint64(qMax(0, lineCount - _emulation->imageSize().height()));
+    const quint64 end = removed + quint64(lineCount);
+
+    // lines which dropped out of the history before they were searched are gone
+    _searchedEnd = qBound(removed, _searchedEnd, historyEnd);
+
+    // A match which continues from the last line searched on a new one is
+    // found by searching from that line on again.  Every match is kept
+    // once, by the search which got to the line it ends on.
+    QVector<HistorySearchMatch> found;
+    QElapsedTimer timer;
+    timer.start();
+    while (historyEnd - _searchedEnd > quint64(HistorySearch::CHUNK_LINES) &&
+           timer.elapsed() < HistorySearch::TIME_SLICE)
+    {
+        const quint64 last = _searchedEnd + HistorySearch::CHUNK_LINES - 1;
+        found.clear();
+        findMatches(_searchedEnd > removed ? _searchedEnd - 1 : _searchedEnd, last, removed, found);
+        foreach (const HistorySearchMatch& match, found)
+        {
+            if (match.endLine >= _searchedEnd)
+                _newMatches.matches.append(match);
+        }
+        _searchedEnd = last + 1;
+    }
+
+    // the matches on the screen are found again every time, its lines change
+    QVector<HistorySearchMatch> screenMatches;
+    if (historyEnd - _searchedEnd > quint64(HistorySearch::CHUNK_LINES))
+    {
+        scheduleSearch();
+    }
+    else if (end > removed)
+    {
+        found.clear();
+        findMatches(_searchedEnd > removed ? _searchedEnd - 1 : _searchedEnd, end - 1, removed, found);
+        foreach (const HistorySearchMatch& match, found)
+        {
+            if (match.endLine < _searchedEnd)
+                continue;
+            if (match.endLine < historyEnd)
+                _newMatches.matches.append(match);
+            else
+                screenMatches.append(match);
+        }
+        _searchedEnd = historyEnd;
+    }
+
+    const bool changed = _newMatches.size() != oldCount || !sameMatches(screenMatches, _screenMatches);
+    _screenMatches = screenMatches;
+    return changed;
+}
+
+void HistoryMatches::findMatches(quint64 first, quint64 last, quint64 removed,
+                                 QVector<HistorySearchMatch>& matches)
+{
+    if (_matcher)
+    {
+        HistorySearchWorker::findLiteralMatches(_emulation, *_matcher, first, last, removed, matches);
+        return;
+    }
+
+    HistorySearchChunk chunk;
+    if (chunk.read(_emulation, first, last, removed))
+        HistorySearchWorker::findMatches(_regExp, chunk, matches);
+}
@@ -0,0 +1,137 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Own includes
+#include "historysearch.h"
+
+// Qt includes
+#include <QBitArray>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+class LiteralMatcher;
+
+/**
+ * Keeps all matches of a regular expression in the lines of an emulation,
+ * its history and its screen, for highlighting them.
+ *
+ * The lines of the history when the expression is set are searched by a
+ * HistorySearch, in the background.  After that, only the lines which are
+ * added to the history are searched, when the emulation reports new output,
+ * along with the lines of the screen, which may still change.  Matches in
+ * lines which drop out of the history are forgotten.
+ *
+ * Matches are kept by the number of lines added to the history before
+ * them, like HistorySearch does, and handed out at the line numbers they
+ * have at the time.
+ */
+class HistoryMatches : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryMatches(EmulationPtr emulation, QObject* parent = 0);
+    ~HistoryMatches();
+
+    /** Starts looking for @p regExp, an empty or invalid expression removes all matches */
+    void setRegExp(const CompiledRegExp& regExp);
+    CompiledRegExp regExp() const { return _regExp; }
+
+    /** Returns the number of matches found so far */
+    int count() const;
+
+    /** Returns true if all lines have been searched */
+    bool isComplete() const;
+
+    /**
+     * Returns the matches which start on the lines from @p firstLine to
+     * @p lastLine, in order, at the line numbers they have now
+     */
+    QVector<HistorySearchMatch> matches(int firstLine, int lastLine) const;
+
+    /**
+     * Splits the lines into @p parts parts of equal size and returns which
+     * of them have a match starting in them
+     */
+    QBitArray linesWithMatches(int parts) const;
+
+signals:
+    /** Emitted when matches have been found or forgotten, or all lines have been searched */
+    void matchesChanged();
+
+private slots:
+    void restart();
+    void outputChanged();
+    void searchNewLines();
+    void historyMatchFound(int startColumn, int startLine, int endColumn, int endLine);
+    void historySearchFinished();
+
+private:
+    // matches in ascending order of their start, the first 'first' of
+    // which have been forgotten
+    struct MatchList
+    {
+        MatchList() : first(0) {}
+
+        int size() const { return matches.size() - first; }
+        void clear();
+        // forgets the matches which start before 'line', returns true if there were any
+        bool removeBefore(quint64 line);
+        // returns the index of the first match which starts at or after 'line'
+        int lowerBound(quint64 line) const;
+        // appends the matches which start from 'firstLine' to 'lastLine' to 'result'
+        void collect(quint64 firstLine, quint64 lastLine, QVector<HistorySearchMatch>& result) const;
+
+        QVector<HistorySearchMatch> matches;
+        int first;
+    };
+
+    // appends the matches in the lines from 'first' to 'last' to 'matches'
+    void findMatches(quint64 first, quint64 last, quint64 removed, QVector<HistorySearchMatch>& matches);
+    // searches the lines added since the last time, returns true if the
+    // matches changed
+    bool findNewMatches();
+    void scheduleSearch();
+
+    EmulationPtr _emulation;
+    CompiledRegExp _regExp;
+    // set for plain text, which is found without decoding the lines
+    LiteralMatcher* _matcher;
+
+    // searches the lines of the history there were when the expression was set
+    QPointer<HistorySearch> _historySearch;
+    // the lines _historySearch keeps the matches of end before this one
+    quint64 _historySearchEnd;
+    // the lines of the history after the first searched so far end before this one
+    quint64 _searchedEnd;
+    bool _searchScheduled;
+
+    // the matches _historySearch found
+    MatchList _historyMatches;
+    // the matches in lines added to the history later
+    MatchList _newMatches;
+    // the matches which end on the screen
+    QVector<HistorySearchMatch> _screenMatches;
+};
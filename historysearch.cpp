@@ -26,15 +26,121 @@
 
 // Own includes
 #include "terminalcharacterdecoder.h"
+#include "historyindex.h"
+#include "literalmatcher.h"
 #include "terminalemulation.h"
 #include "historysearch.h"
 
+// System includes
+#include <algorithm>
+
 // Qt includes
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QTextStream>
+#include <QThread>
+#include <QTimer>
 #include <QDebug>
 
-HistorySearch::HistorySearch(EmulationPtr emulation, QRegExp regExp,
+HistorySearchWorker::HistorySearchWorker(const CompiledRegExp& regExp) :
+    QObject(),
+    m_regExp(regExp),
+    m_cancelled(0) {
+}
+
+void HistorySearchWorker::cancel() {
+    m_cancelled.store(1);
+}
+
+static int findLineNumberInString(const QList<int>& linePositions, int lineCount, int position) {
+    // the last line which starts at or before 'position'
+    const QList<int>::const_iterator begin = linePositions.constBegin();
+    const QList<int>::const_iterator end = begin + lineCount;
+    return qMax(0, int(std::upper_bound(begin, end, position) - begin) - 1);
+}
+
+bool HistorySearchChunk::read(TerminalEmulation* emulation, quint64 first, quint64 last, quint64 removed) {
+    firstLine = first;
+    lineCount = int(last - first + 1);
+    text.clear();
+
+    QTextStream stream(&text);
+    PlainTextDecoder decoder;
+    decoder.begin(&stream);
+    decoder.setRecordLinePositions(true);
+    emulation->writeToStream(&decoder, int(first - removed), int(last - removed));
+    decoder.end();
+    stream.flush();
+    linePositions = decoder.linePositions();
+
+    return linePositions.size() >= lineCount;
+}
+
+bool HistorySearchWorker::findMatches(const CompiledRegExp& regExp, const HistorySearchChunk& chunk,
+                                      QVector<HistorySearchMatch>& matches, const QAtomicInt* cancelled) {
+    const int endPosition = chunk.endPosition < 0 ? chunk.text.size() : chunk.endPosition;
+    int position = chunk.startPosition;
+    while (position < endPosition)
+    {
+        int matchLength = 0;
+        const int matchStart = regExp.indexIn(chunk.text, position, &matchLength);
+        if (matchStart < 0 || matchStart >= endPosition)
+            break;
+
+        // empty matches cannot be selected
+        position = matchStart + qMax(1, matchLength);
+        if (matchLength == 0)
+            continue;
+
+        const int matchEnd = matchStart + matchLength - 1;
+        const int startLine = findLineNumberInString(chunk.linePositions, chunk.lineCount, matchStart);
+        const int endLine = findLineNumberInString(chunk.linePositions, chunk.lineCount, matchEnd);
+
+        HistorySearchMatch match;
+        match.startLine = chunk.firstLine + startLine;
+        match.startColumn = matchStart - chunk.linePositions.at(startLine);
+        match.endLine = chunk.firstLine + endLine;
+        match.endColumn = matchEnd - chunk.linePositions.at(endLine);
+        matches.append(match);
+
+        if (cancelled && cancelled->load())
+            return false;
+    }
+    return true;
+}
+
+void HistorySearchWorker::findLiteralMatches(TerminalEmulation* emulation, const LiteralMatcher& matcher,
+                                             quint64 first, quint64 last, quint64 removed,
+                                             QVector<HistorySearchMatch>& matches) {
+    QVector<LiteralMatch> found;
+    emulation->findText(matcher, int(first - removed), int(last - removed), found);
+
+    matches.reserve(matches.size() + found.size());
+    foreach (const LiteralMatch& literalMatch, found) {
+        HistorySearchMatch match;
+        match.startLine = removed + literalMatch.startLine;
+        match.startColumn = literalMatch.startColumn;
+        match.endLine = removed + literalMatch.endLine;
+        match.endColumn = literalMatch.endColumn;
+        matches.append(match);
+    }
+}
+
+void HistorySearchWorker::searchChunk(const HistorySearchChunk& chunk) {
+    if (m_cancelled.load())
+        return;
+
+    QVector<HistorySearchMatch> matches;
+    if (!findMatches(m_regExp, chunk, matches, &m_cancelled))
+        return;
+
+    if (!chunk.forwards)
+        std::reverse(matches.begin(), matches.end());
+
+    emit chunkSearched(matches, chunk.lineCount);
+}
+
+HistorySearch::HistorySearch(EmulationPtr emulation, const CompiledRegExp& regExp,
                              bool forwards, int startColumn, int startLine,
                              QObject* parent) :
     QObject(parent),
@@ -42,126 +148,312 @@ HistorySearch::HistorySearch(EmulationPtr emulation, QRegExp regExp,
     m_regExp(regExp),
     m_forwards(forwards),
     m_startColumn(startColumn),
-    m_startLine(startLine) {
+    m_startLine(startLine),
+    m_nextLine(0),
+    m_lineCount(0),
+    m_linesSearched(0),
+    m_chunksSent(0),
+    m_chunksSearched(0),
+    m_matches(0),
+    m_cancelled(false),
+    m_readScheduled(false),
+    m_matcher(0),
+    m_thread(0),
+    m_worker(0) {
+    qRegisterMetaType<HistorySearchChunk>();
+    qRegisterMetaType<QVector<HistorySearchMatch> >();
 }
 
 HistorySearch::~HistorySearch() {
+    if (m_thread) {
+        // the worker checks for cancellation after each match, so this
+        // does not wait long
+        m_worker->cancel();
+        m_thread->quit();
+        m_thread->wait();
+        delete m_worker;
+        delete m_thread;
+    }
+    delete m_matcher;
 }
 
 void HistorySearch::search() {
-    bool found = false;
-    
-    if (! m_regExp.isEmpty())
+    if (m_regExp.isEmpty() || !m_emulation || m_emulation->lineCount() == 0)
     {
-        if (m_forwards) {
-            found = search(m_startColumn, m_startLine, -1, m_emulation->lineCount()) || search(0, 0, m_startColumn, m_startLine);
-        } else {
-            found = search(0, 0, m_startColumn, m_startLine) || search(m_startColumn, m_startLine, -1, m_emulation->lineCount());
-        }
+        deleteLater();
+        return;
+    }
 
-        if (found) {
-            emit matchFound(m_foundStartColumn, m_foundStartLine, m_foundEndColumn, m_foundEndLine);
-        }
-        else {
-            emit noMatchFound();
-        }
+    // the lines are identified by a number which does not change when lines
+    // are removed from the history while the search runs
+    const quint64 removed = m_emulation->removedLineCount();
+    const int lineCount = m_emulation->lineCount();
+    const quint64 firstLine = removed;
+    const quint64 lastLine = removed + lineCount - 1;
+    const quint64 startLine = removed + qBound(0, m_startLine, lineCount - 1);
+
+    Range afterStart = { startLine, lastLine, m_startColumn, -1 };
+    Range beforeStart = { firstLine, startLine, 0, m_startColumn };
+    const HistoryIndex* index = m_emulation->historyIndex();
+    const QString text = m_regExp.literalText();
+    if (m_forwards) {
+        addRange(afterStart, index, text);
+        addRange(beforeStart, index, text);
+    } else {
+        addRange(beforeStart, index, text);
+        addRange(afterStart, index, text);
+    }
+
+    if (m_ranges.isEmpty()) {
+        finish();
+        return;
     }
+    m_nextLine = m_forwards ? m_ranges.first().firstLine : m_ranges.first().lastLine;
+
+    if (LiteralMatcher::canMatch(text)) {
+        m_matcher = new LiteralMatcher(text, m_regExp.caseSensitivity());
+        readLines();
+        return;
+    }
+
+    m_worker = new HistorySearchWorker(m_regExp);
+    m_thread = new QThread();
+    m_worker->moveToThread(m_thread);
+    connect(this, SIGNAL(chunkReady(HistorySearchChunk)),
+            m_worker, SLOT(searchChunk(HistorySearchChunk)));
+    connect(m_worker, SIGNAL(chunkSearched(QVector<HistorySearchMatch>,int)),
+            this, SLOT(chunkSearched(QVector<HistorySearchMatch>,int)));
+    m_thread->start();
 
+    readLines();
+}
+
+void HistorySearch::cancel() {
+    if (m_cancelled)
+        return;
+
+    m_cancelled = true;
+    if (m_worker)
+        m_worker->cancel();
     deleteLater();
 }
 
-bool HistorySearch::search(int startColumn, int startLine, int endColumn, int endLine) {
-    qDebug() << "search from" << startColumn << "," << startLine
-             <<  "to" << endColumn << "," << endLine;
-    
-    int linesRead = 0;
-    int linesToRead = endLine - startLine + 1;
-    
-    qDebug() << "linesToRead:" << linesToRead;
-    
-    // We read process history from (and including) startLine to (and including) endLine in
-    // blocks of at most 10K lines so that we do not use unhealthy amounts of memory
-    int blockSize;
-    while ((blockSize = qMin(10000, linesToRead - linesRead)) > 0) {
-        
-        QString string;
-        QTextStream searchStream(&string);
-        PlainTextDecoder decoder;
-        decoder.begin(&searchStream);
-        decoder.setRecordLinePositions(true);
-
-        // Calculate lines to read and read them
-        int blockStartLine = m_forwards ? startLine + linesRead : endLine - linesRead - blockSize + 1;
-        int chunkEndLine = blockStartLine + blockSize - 1;
-        m_emulation->writeToStream(&decoder, blockStartLine, chunkEndLine);
-
-        // We search between startColumn in the first line of the string and endColumn in the last
-        // line of the string. First we calculate the position (in the string) of endColumn in the
-        // last line of the string
-        int endPosition;
-        
-        // The String that Emulator.writeToStream produces has a newline at the end, and so ends with an
-        // empty line - we ignore that.
-        int numberOfLinesInString = decoder.linePositions().size() - 1;
-        if (numberOfLinesInString > 0 && endColumn > -1 )
-        {
-            endPosition = decoder.linePositions().at(numberOfLinesInString - 1) + endColumn;
+void HistorySearch::addRange(const Range& range, const HistoryIndex* index, const QString& text) {
+    QVector<HistoryIndex::LineRange> pieces;
+    if (index && HistoryIndex::canFind(text)) {
+        // the lines the index does not know are searched in full, the
+        // screen lines after the history among them
+        if (range.firstLine < index->firstLine()) {
+            HistoryIndex::LineRange before = { range.firstLine, qMin(range.lastLine, index->firstLine() - 1) };
+            pieces << before;
         }
-        else
-        {
-            endPosition = string.size();
+        foreach (const HistoryIndex::LineRange& candidate,
+                 index->candidateLines(text, range.firstLine, range.lastLine)) {
+            if (!pieces.isEmpty() && candidate.first <= pieces.last().last + 1)
+                pieces.last().last = qMax(pieces.last().last, candidate.last);
+            else
+                pieces << candidate;
         }
+        if (range.lastLine >= index->endLine()) {
+            HistoryIndex::LineRange after = { qMax(range.firstLine, index->endLine()), range.lastLine };
+            if (!pieces.isEmpty() && after.first <= pieces.last().last + 1)
+                pieces.last().last = qMax(pieces.last().last, after.last);
+            else
+                pieces << after;
+        }
+    } else {
+        HistoryIndex::LineRange all = { range.firstLine, range.lastLine };
+        pieces << all;
+    }
 
-        // So now we can log for m_regExp in the string between startColumn and endPosition
-        int matchStart;
-        if (m_forwards)
-        {
-            matchStart = string.indexOf(m_regExp, startColumn);
-            if (matchStart >= endPosition)
-                matchStart = -1;
+    // the columns only limit the first and last line of the whole range
+    for (int i = 0; i < pieces.size(); i++) {
+        const HistoryIndex::LineRange& piece = pieces.at(m_forwards ? i : pieces.size() - 1 - i);
+        Range part = { piece.first, piece.last,
+                       piece.first == range.firstLine ? range.startColumn : 0,
+                       piece.last == range.lastLine ? range.endColumn : -1 };
+        m_ranges << part;
+        m_lineCount += int(piece.last - piece.first + 1);
+    }
+}
+
+bool HistorySearch::readChunk() {
+    while (!m_ranges.isEmpty())
+    {
+        const Range range = m_ranges.first();
+
+        // take the next lines of the range, in search order
+        quint64 first, last;
+        if (m_forwards) {
+            first = m_nextLine;
+            last = qMin(range.lastLine, first + CHUNK_LINES - 1);
+        } else {
+            last = m_nextLine;
+            first = last - range.firstLine >= quint64(CHUNK_LINES) ? last - CHUNK_LINES + 1 : range.firstLine;
         }
-        else
-        {
-            matchStart = string.lastIndexOf(m_regExp, endPosition - 1);
-            if (matchStart < startColumn)
-                matchStart = -1;
+
+        const bool rangeDone = m_forwards ? last == range.lastLine : first == range.firstLine;
+        if (rangeDone) {
+            m_ranges.removeFirst();
+            if (!m_ranges.isEmpty())
+                m_nextLine = m_forwards ? m_ranges.first().firstLine : m_ranges.first().lastLine;
+        } else {
+            m_nextLine = m_forwards ? last + 1 : first - 1;
         }
 
-        if (matchStart > -1)
-        {
-            int matchEnd = matchStart + m_regExp.matchedLength() - 1;
-            qDebug() << "Found in string from" << matchStart << "to" << matchEnd;
-            
-            // Translate startPos and endPos to startColum, startLine, endColumn and endLine in history.
-            int startLineNumberInString = findLineNumberInString(decoder.linePositions(), matchStart);
-            m_foundStartColumn = matchStart - decoder.linePositions().at(startLineNumberInString);
-            m_foundStartLine = startLineNumberInString + startLine + linesRead;
-
-            int endLineNumberInString = findLineNumberInString(decoder.linePositions(), matchEnd);
-            m_foundEndColumn = matchEnd - decoder.linePositions().at(endLineNumberInString);
-            m_foundEndLine = endLineNumberInString + startLine + linesRead;
-
-            qDebug() << "m_foundStartColumn" << m_foundStartColumn
-                     << "m_foundStartLine" << m_foundEndLine
-                     << "m_foundEndColumn" << m_foundEndColumn
-                     << "m_foundEndLine" << m_foundEndLine;
+        // lines which have dropped out of the history meanwhile are gone
+        const quint64 removed = m_emulation->removedLineCount();
+        const quint64 available = removed + m_emulation->lineCount();
+        const quint64 readFirst = qMax(first, removed);
+        const quint64 readLast = qMin(last, available - 1);
+        if (readFirst > readLast || available == removed) {
+            m_linesSearched += int(last - first + 1);
+            continue;
+        }
+        m_linesSearched += int((last - first + 1) - (readLast - readFirst + 1));
 
+        if (m_matcher) {
+            const QVector<HistorySearchMatch> matches = findText(range, readFirst, readLast, removed);
+            m_linesSearched += int(readLast - readFirst + 1);
+            reportMatches(matches);
             return true;
         }
-        
-        
-        linesRead += blockSize;
+
+        HistorySearchChunk chunk;
+        chunk.forwards = m_forwards;
+        if (!chunk.read(m_emulation, readFirst, readLast, removed)) {
+            m_linesSearched += chunk.lineCount;
+            continue;
+        }
+
+        if (readFirst == range.firstLine)
+            chunk.startPosition = range.startColumn;
+        if (readLast == range.lastLine && range.endColumn >= 0)
+            chunk.endPosition = chunk.linePositions.at(chunk.lineCount - 1) + range.endColumn;
+
+        m_chunksSent++;
+        emit chunkReady(chunk);
+        return true;
     }
-    
-    qDebug() << "Not found";
+
     return false;
 }
 
+QVector<HistorySearchMatch> HistorySearch::findText(const Range& range, quint64 first, quint64 last,
+                                                    quint64 removed) {
+    // a match which wraps from the line before the chunk onto its first
+    // line is only found by starting on that line, every match is kept by
+    // the chunk it ends in
+    const quint64 scanFirst = first > qMax(range.firstLine, removed) ? first - 1 : first;
+
+    QVector<HistorySearchMatch> found;
+    HistorySearchWorker::findLiteralMatches(m_emulation, *m_matcher, scanFirst, last, removed, found);
+
+    QVector<HistorySearchMatch> matches;
+    matches.reserve(found.size());
+    foreach (const HistorySearchMatch& match, found) {
+        if (match.endLine < first)
+            continue;
+
+        // the range may start after the beginning of its first line and
+        // end before the end of its last one
+        if (match.startLine == range.firstLine && match.startColumn < range.startColumn)
+            continue;
+        if (match.startLine == range.lastLine && range.endColumn >= 0 &&
+                match.startColumn >= range.endColumn)
+            continue;
+        matches.append(match);
+    }
+
+    if (!m_forwards)
+        std::reverse(matches.begin(), matches.end());
+    return matches;
+}
+
+void HistorySearch::readLines() {
+    m_readScheduled = false;
+    if (m_cancelled)
+        return;
+
+    if (!m_emulation) {
+        cancel();
+        return;
+    }
+
+    // read lines for a while, then let the GUI handle its events
+    QElapsedTimer timer;
+    timer.start();
+    while (!m_cancelled && m_chunksSent - m_chunksSearched < MAX_PENDING_CHUNKS &&
+           timer.elapsed() < TIME_SLICE) {
+        if (!readChunk())
+            break;
+    }
+
+    // a match may have been the last thing needed
+    if (m_cancelled)
+        return;
+
+    if (m_matcher)
+        emit progress(m_linesSearched, m_lineCount);
+
+    if (m_ranges.isEmpty()) {
+        if (m_chunksSearched == m_chunksSent)
+            finish();
+        return;
+    }
+
+    // once the worker is busy enough, chunkSearched() continues reading
+    if (m_chunksSent - m_chunksSearched < MAX_PENDING_CHUNKS)
+        scheduleRead();
+}
+
+void HistorySearch::scheduleRead() {
+    if (m_readScheduled)
+        return;
+    m_readScheduled = true;
+    QTimer::singleShot(0, this, SLOT(readLines()));
+}
+
+void HistorySearch::chunkSearched(const QVector<HistorySearchMatch>& matches, int lineCount) {
+    if (m_cancelled)
+        return;
 
-int HistorySearch::findLineNumberInString(QList<int> linePositions, int position) {
-    int lineNum = 0;
-    while (lineNum + 1 < linePositions.size() && linePositions[lineNum + 1] <= position)
-        lineNum++;
+    m_chunksSearched++;
+    m_linesSearched += lineCount;
 
-    return lineNum;
+    reportMatches(matches);
+    if (m_cancelled)
+        return;
+
+    emit progress(m_linesSearched, m_lineCount);
+
+    if (m_ranges.isEmpty()) {
+        if (m_chunksSearched == m_chunksSent)
+            finish();
+    } else {
+        scheduleRead();
+    }
+}
+
+void HistorySearch::reportMatches(const QVector<HistorySearchMatch>& matches) {
+    // report the matches at the line numbers they have now
+    const quint64 removed = m_emulation ? m_emulation->removedLineCount() : 0;
+    for (int i = 0; i < matches.size() && !m_cancelled; i++) {
+        const HistorySearchMatch& match = matches.at(i);
+        if (match.startLine < removed)
+            continue;
+
+        m_matches++;
+        emit matchFound(match.startColumn, int(match.startLine - removed),
+                        match.endColumn, int(match.endLine - removed));
+    }
+}
+
+void HistorySearch::finish() {
+    if (m_matches == 0)
+        emit noMatchFound();
+    emit finished();
+
+    m_cancelled = true;
+    deleteLater();
 }
@@ -27,6 +27,7 @@
 #pragma once
 
 // Own includes
+#include "compiledregexp.h"
 #include "terminalsession.h"
 #include "screenwindow.h"
 #include "terminalemulation.h"
@@ -36,38 +37,202 @@
 #include <QObject>
 #include <QPointer>
 #include <QMap>
+#include <QAtomicInt>
+#include <QMetaType>
+#include <QVector>
+
+class QThread;
+class HistoryIndex;
+class LiteralMatcher;
 
 typedef QPointer<TerminalEmulation> EmulationPtr;
 
+/**
+ * Lines of text taken from the emulation for HistorySearchWorker.
+ *
+ * Lines are identified by their number plus the number of lines removed from
+ * the history at the time, see TerminalEmulation::removedLineCount(), so
+ * that they can be found again after more lines have been removed.
+ */
+struct HistorySearchChunk
+{
+    HistorySearchChunk()
+        : firstLine(0), lineCount(0), startPosition(0), endPosition(-1), forwards(true) {}
+
+    /**
+     * Reads the lines from @p first to @p last of @p emulation, of which
+     * @p removed lines have been removed.  Returns false if some of them
+     * could not be read.
+     */
+    bool read(TerminalEmulation* emulation, quint64 first, quint64 last, quint64 removed);
+
+    QString text;
+    // the position in 'text' at which each line starts
+    QList<int> linePositions;
+    quint64 firstLine;
+    int lineCount;
+    // matches must start at or after startPosition and before endPosition,
+    // -1 for the end of the text
+    int startPosition;
+    int endPosition;
+    bool forwards;
+};
+
+/** A match, its lines are identified like those of HistorySearchChunk */
+struct HistorySearchMatch
+{
+    quint64 startLine;
+    quint64 endLine;
+    int startColumn;
+    int endColumn;
+};
+
+Q_DECLARE_METATYPE(HistorySearchChunk)
+Q_DECLARE_METATYPE(HistorySearchMatch)
+
+/**
+ * Looks for the matches of a regular expression in the chunks of text it is
+ * sent.  Lives on the worker thread of a HistorySearch.
+ */
+class HistorySearchWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HistorySearchWorker(const CompiledRegExp& regExp);
+
+    /** Makes the worker skip the rest of its work, may be called from any thread */
+    void cancel();
+
+    /**
+     * Appends the matches of @p regExp in @p chunk to @p matches, in the
+     * order of the text.  Returns false if @p cancelled was set meanwhile.
+     */
+    static bool findMatches(const CompiledRegExp& regExp, const HistorySearchChunk& chunk,
+                            QVector<HistorySearchMatch>& matches, const QAtomicInt* cancelled = 0);
+
+    /**
+     * Appends the matches of @p matcher in the lines from @p first to
+     * @p last of @p emulation, of which @p removed lines have been removed,
+     * to @p matches, in the order of the text.  Plain text is compared with
+     * the cells of the lines as they are, so this runs on the GUI thread.
+     */
+    static void findLiteralMatches(TerminalEmulation* emulation, const LiteralMatcher& matcher,
+                                   quint64 first, quint64 last, quint64 removed,
+                                   QVector<HistorySearchMatch>& matches);
+
+public slots:
+    void searchChunk(const HistorySearchChunk& chunk);
+
+signals:
+    /** Emitted for every chunk, in the order of the chunks, with its matches in search order */
+    void chunkSearched(const QVector<HistorySearchMatch>& matches, int lineCount);
+
+private:
+    CompiledRegExp m_regExp;
+    QAtomicInt m_cancelled;
+};
+
+/**
+ * Searches the lines of an emulation, its history and its screen, for a
+ * regular expression, starting at a position and wrapping around at the end.
+ *
+ * The search does not block the GUI.  The text of the lines is taken from
+ * the emulation on the GUI thread, a few thousand lines at a time between
+ * events, and searched on a worker thread.  The lines searched are the
+ * lines there were when the search started.  Matches are reported as they
+ * are found, at the line numbers they have when they are reported, even
+ * if lines have dropped out of the history in the meantime.
+ *
+ * Plain text is found by a LiteralMatcher in the cells of the lines, on
+ * the GUI thread, without converting them into text and without the worker.
+ * When the emulation keeps a HistoryIndex, searches for plain text only
+ * look at the lines of the history the index finds.
+ *
+ * The search deletes itself when it is finished or cancelled.
+ */
 class HistorySearch : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit HistorySearch(EmulationPtr emulation, QRegExp regExp, bool forwards,
+    explicit HistorySearch(EmulationPtr emulation, const CompiledRegExp& regExp, bool forwards,
                            int startColumn, int startLine, QObject* parent);
 
     ~HistorySearch();
 
+    /** Starts the search, which runs until finished() or cancel() */
     void search();
 
+    /** Stops the search at once, no more signals are emitted */
+    void cancel();
+
+    /** The number of lines searched at a time */
+    static const int CHUNK_LINES = 2000;
+    /** The time in ms spent searching before the GUI gets to handle events again */
+    static const int TIME_SLICE = 10;
+
 signals:
+    /** Emitted for every match, in search order: the first is the one after the start position */
     void matchFound(int startColumn, int startLine, int endColumn, int endLine);
+    /** Emitted when the search is finished without a match */
     void noMatchFound();
+    /** Emitted as lines have been searched */
+    void progress(int linesSearched, int lineCount);
+    /** Emitted when all lines have been searched */
+    void finished();
+
+    // sends text to the worker thread
+    void chunkReady(const HistorySearchChunk& chunk);
+
+private slots:
+    void readLines();
+    void chunkSearched(const QVector<HistorySearchMatch>& matches, int lineCount);
+
+private:
+    // a range of lines to search, the lines are identified like those of HistorySearchChunk
+    struct Range
+    {
+        quint64 firstLine;
+        quint64 lastLine;
+        // the first column at which a match may start in the first line, and
+        // the column before which it must start in the last line, -1 for none
+        int startColumn;
+        int endColumn;
+    };
+
+    // adds the lines of 'range' to search, only those the index finds for 'text' if possible
+    void addRange(const Range& range, const HistoryIndex* index, const QString& text);
+    // reads the next chunk of lines, returns false if there are none left
+    bool readChunk();
+    // finds the text of m_matcher in a chunk of lines
+    QVector<HistorySearchMatch> findText(const Range& range, quint64 first, quint64 last, quint64 removed);
+    void reportMatches(const QVector<HistorySearchMatch>& matches);
+    void scheduleRead();
+    void finish();
+
+    // chunks sent to the worker which it has not searched yet, at most
+    static const int MAX_PENDING_CHUNKS = 4;
 
-private: 
-    bool search(int startColumn, int startLine, int endColumn, int endLine);
-    int findLineNumberInString(QList<int> linePositions, int position);
-
-    
     EmulationPtr m_emulation;
-    QRegExp m_regExp;
+    CompiledRegExp m_regExp;
     bool m_forwards;
     int m_startColumn;
     int m_startLine;
 
-    int m_foundStartColumn;
-    int m_foundStartLine;
-    int m_foundEndColumn;
-    int m_foundEndLine;
+    QList<Range> m_ranges;
+    // the next line to read in the first range
+    quint64 m_nextLine;
+    int m_lineCount;
+    int m_linesSearched;
+    int m_chunksSent;
+    int m_chunksSearched;
+    int m_matches;
+    bool m_cancelled;
+    bool m_readScheduled;
+
+    // set for plain text which can be found without the worker
+    LiteralMatcher* m_matcher;
+    QThread* m_thread;
+    HistorySearchWorker* m_worker;
 };
@@ -0,0 +1,154 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "linecompare.h"
+
+// System includes
+#include <stddef.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+// Collects the changed columns into ranges
+class RangeBuilder
+{
+public:
+    RangeBuilder(ColumnRange* ranges)
+        : _ranges(ranges), _count(0) {}
+
+    void changed(int column)
+    { changed(column, column); }
+
+    void changed(int first, int last)
+    {
+        if (_count > 0 && _ranges[_count-1].last == first - 1)
+        {
+            _ranges[_count-1].last = last;
+            return;
+        }
+
+        _ranges[_count].first = first;
+        _ranges[_count].last = last;
+        _count++;
+    }
+
+    int count() const
+    { return _count; }
+
+private:
+    ColumnRange* _ranges;
+    int _count;
+};
+}
+
+int compareLinesScalar(const Character* oldLine, const Character* newLine,
+                       int count, ColumnRange* ranges)
+{
+    RangeBuilder builder(ranges);
+    for (int x = 0; x < count; x++)
+    {
+        if (oldLine[x] != newLine[x])
+            builder.changed(x);
+    }
+    return builder.count();
+}
+
+#if defined(__SSE2__)
+// The vectorized comparison looks at the bytes of the characters, so it
+// needs to know which of them are padding.  Character has one byte of
+// padding at its end.
+static_assert(sizeof(Character) == 12 &&
+              offsetof(Character, backgroundColor) + sizeof(CharacterColor) == 11,
+              "compareLines() assumes the layout of Character");
+
+int compareLines(const Character* oldLine, const Character* newLine,
+                 int count, ColumnRange* ranges)
+{
+    // Four characters fill three 16 byte blocks.  The padding bytes are
+    // treated as equal.
+    const quint64 PADDING = (Q_UINT64_C(1) << 11) | (Q_UINT64_C(1) << 23) |
+                            (Q_UINT64_C(1) << 35) | (Q_UINT64_C(1) << 47);
+    const quint64 ALL_EQUAL = (Q_UINT64_C(1) << 48) - 1;
+    const quint64 CHARACTER_EQUAL = (1 << 12) - 1;
+
+    RangeBuilder builder(ranges);
+    const char* oldBytes = (const char*)oldLine;
+    const char* newBytes = (const char*)newLine;
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        const char* o = oldBytes + x * sizeof(Character);
+        const char* n = newBytes + x * sizeof(Character);
+
+        const __m128i equal0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)o),
+                                              _mm_loadu_si128((const __m128i*)n));
+        const __m128i equal1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(o + 16)),
+                                              _mm_loadu_si128((const __m128i*)(n + 16)));
+        const __m128i equal2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(o + 32)),
+                                              _mm_loadu_si128((const __m128i*)(n + 32)));
+
+        const quint64 equal = quint64(_mm_movemask_epi8(equal0)) |
+                              (quint64(_mm_movemask_epi8(equal1)) << 16) |
+                              (quint64(_mm_movemask_epi8(equal2)) << 32) |
+                              PADDING;
+        if (equal == ALL_EQUAL)
+            continue;
+
+        int changedMask = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (((equal >> (12 * i)) & CHARACTER_EQUAL) != CHARACTER_EQUAL)
+                changedMask |= 1 << i;
+        }
+
+        if (changedMask == 0xf)
+        {
+            builder.changed(x, x + 3);
+            continue;
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            if (changedMask & (1 << i))
+                builder.changed(x + i);
+        }
+    }
+
+    for (; x < count; x++)
+    {
+        if (oldLine[x] != newLine[x])
+            builder.changed(x);
+    }
+
+    return builder.count();
+}
+#else
+int compareLines(const Character* oldLine, const Character* newLine,
+                 int count, ColumnRange* ranges)
+{
+    return compareLinesScalar(oldLine, newLine, count, ranges);
+}
+#endif
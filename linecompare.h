@@ -0,0 +1,50 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Own includes
+#include "character.h"
+
+/** A range of columns, from @p first to @p last inclusive. */
+struct ColumnRange
+{
+    int first;
+    int last;
+};
+
+/**
+ * Compares the first @p count characters of @p oldLine and @p newLine and
+ * stores the ranges of columns in which they differ into @p ranges, from
+ * left to right.  Returns the number of ranges, 0 if the lines are equal.
+ *
+ * @p ranges must have room for (count + 1) / 2 ranges.
+ *
+ * Where SSE2 is available the lines are compared several characters at a
+ * time, otherwise this is the same as compareLinesScalar().
+ */
+int compareLines(const Character* oldLine, const Character* newLine,
+                 int count, ColumnRange* ranges);
+
+/** Compares the lines one character at a time, see compareLines(). */
+int compareLinesScalar(const Character* oldLine, const Character* newLine,
+                       int count, ColumnRange* ranges);
@@ -0,0 +1,253 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "literalmatcher.h"
+#include "konsole_wcwidth.h"
+
+// System includes
+#include <algorithm>
+#include <stddef.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Case folds @p c like QString::indexOf() does when the case does not matter
+static inline quint32 foldCase(quint32 c)
+{
+    if (c < 0x80)
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    if (c > 0xffff)
+        return c;
+    return QChar(ushort(c)).toCaseFolded().unicode();
+}
+
+// Returns every code unit as its case folding in the high 16 bits and the
+// code unit in the low ones, sorted, so the code units which fold to the
+// same character are next to each other.  Built the first time it is needed.
+static const QVector<quint32>& foldedCodeUnits()
+{
+    struct Table
+    {
+        Table() : units(0x10000)
+        {
+            for (quint32 u = 0; u <= 0xffff; u++)
+                units[u] = foldCase(u) << 16 | u;
+            std::sort(units.begin(), units.end());
+        }
+        QVector<quint32> units;
+    };
+    static const Table table;
+    return table.units;
+}
+
+LiteralMatcher::LiteralMatcher(const QString& text, Qt::CaseSensitivity caseSensitivity)
+    : _caseSensitivity(caseSensitivity)
+{
+    _text.reserve(text.size());
+    for (int i = 0; i < text.size(); i++)
+    {
+        const quint32 c = text.at(i).unicode();
+        _text.append(caseSensitivity == Qt::CaseSensitive ? c : foldCase(c));
+    }
+
+    _first.count = 0;
+    _last.count = 0;
+    if (!_text.isEmpty())
+    {
+        _first = variantsOf(_text.first());
+        _last = variantsOf(_text.last());
+    }
+}
+
+bool LiteralMatcher::canMatch(const QString& text)
+{
+    if (text.isEmpty())
+        return false;
+
+    for (int i = 0; i < text.size(); i++)
+    {
+        const QChar c = text.at(i);
+        if (c.isSurrogate() || konsole_wcwidth(c.unicode()) != 1)
+            return false;
+    }
+    return true;
+}
+
+LiteralMatcher::Variants LiteralMatcher::variantsOf(quint32 c) const
+{
+    Variants variants;
+    variants.characters[0] = c;
+    variants.count = 1;
+    if (_caseSensitivity == Qt::CaseSensitive)
+        return variants;
+
+    // characters outside the BMP are not folded
+    if (c > 0xffff)
+        return variants;
+
+    // the characters which fold to 'c', only a few for most characters
+    const QVector<quint32>& units = foldedCodeUnits();
+    QVector<quint32>::const_iterator it = std::lower_bound(units.constBegin(), units.constEnd(), c << 16);
+    variants.count = 0;
+    for (; it != units.constEnd() && (*it >> 16) == c; ++it)
+    {
+        if (variants.count == MAX_VARIANTS)
+        {
+            variants.count = 0;
+            return variants;
+        }
+        variants.characters[variants.count++] = *it & 0xffff;
+    }
+    return variants;
+}
+
+inline quint32 LiteralMatcher::unit(const CompactCharacter& cell) const
+{
+    return _caseSensitivity == Qt::CaseSensitive ? cell.character : foldCase(cell.character);
+}
+
+inline bool LiteralMatcher::matchesAt(const CompactCharacter* cells) const
+{
+    const int length = _text.size();
+    for (int i = 0; i < length; i++)
+    {
+        if (unit(cells[i]) != _text.at(i))
+            return false;
+    }
+    return true;
+}
+
+int LiteralMatcher::indexInScalar(const CompactCharacter* cells, int count, int from) const
+{
+    const int length = _text.size();
+    for (int x = qMax(0, from); x + length <= count; x++)
+    {
+        if (matchesAt(cells + x))
+            return x;
+    }
+    return -1;
+}
+
+#if defined(__SSE2__)
+// The vectorized search gathers the characters of four cells into one
+// register, it needs to know where they are.
+static_assert(sizeof(CompactCharacter) == 8 && offsetof(CompactCharacter, character) == 0,
+              "LiteralMatcher::indexIn() assumes the layout of CompactCharacter");
+
+namespace
+{
+// Finds the cells whose character is one of a few
+class Probe
+{
+public:
+    Probe(const quint32* characters, int count)
+    {
+        // upper and lower case ASCII letters differ in one bit, setting it
+        // saves comparing with both.  That works if every character comes
+        // along with the one which differs from it in that bit.
+        bool pairs = true;
+        for (int i = 0; i < count && pairs; i++)
+        {
+            const quint32 other = characters[i] ^ 0x20;
+            pairs = std::find(characters, characters + count, other) != characters + count;
+        }
+
+        _bits = _mm_set1_epi32(pairs ? 0x20 : 0);
+        quint32 values[4];
+        int valueCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const quint32 value = pairs ? characters[i] | 0x20 : characters[i];
+            if (std::find(values, values + valueCount, value) == values + valueCount)
+                values[valueCount++] = value;
+        }
+
+        // unused values repeat the first one
+        for (int i = 0; i < 4; i++)
+            _values[i] = _mm_set1_epi32(int(values[i < valueCount ? i : 0]));
+        _valueCount = valueCount;
+    }
+
+    /** Returns a bit for each of the four cells at @p cells which has one of the characters */
+    int match(const CompactCharacter* cells) const
+    {
+        const __m128 low = _mm_loadu_ps((const float*)cells);
+        const __m128 high = _mm_loadu_ps((const float*)(cells + 2));
+        const __m128i characters = _mm_or_si128(
+                    _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))), _bits);
+
+        __m128i result = _mm_cmpeq_epi32(characters, _values[0]);
+        if (_valueCount > 1)
+        {
+            result = _mm_or_si128(result, _mm_cmpeq_epi32(characters, _values[1]));
+            if (_valueCount > 2)
+            {
+                result = _mm_or_si128(result, _mm_or_si128(_mm_cmpeq_epi32(characters, _values[2]),
+                                                           _mm_cmpeq_epi32(characters, _values[3])));
+            }
+        }
+        return _mm_movemask_ps(_mm_castsi128_ps(result));
+    }
+
+private:
+    __m128i _bits;
+    __m128i _values[4];
+    int _valueCount;
+};
+}
+
+int LiteralMatcher::indexIn(const CompactCharacter* cells, int count, int from) const
+{
+    const int length = _text.size();
+    if (_first.count == 0 || _last.count == 0)
+        return indexInScalar(cells, count, from);
+
+    const Probe first(_first.characters, _first.count);
+    const Probe last(_last.characters, _last.count);
+
+    // eight cells at a time: only the cells which start with the first
+    // character of the text and at which the last one comes at the right
+    // distance are compared with the whole text
+    int x = qMax(0, from);
+    for (; x + length + 7 <= count; x += 8)
+    {
+        const int mask = (first.match(cells + x) & last.match(cells + x + length - 1)) |
+                         ((first.match(cells + x + 4) & last.match(cells + x + length + 3)) << 4);
+        if (mask == 0)
+            continue;
+
+        for (int i = 0; i < 8; i++)
+        {
+            if ((mask & (1 << i)) && matchesAt(cells + x + i))
+                return x + i;
+        }
+    }
+
+    return indexInScalar(cells, count, x);
+}
+#else
+int LiteralMatcher::indexIn(const CompactCharacter* cells, int count, int from) const
+{
+    return indexInScalar(cells, count, from);
+}
+#endif
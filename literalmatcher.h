@@ -0,0 +1,97 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Own includes
+#include "characterstyle.h"
+
+// Qt includes
+#include <QString>
+#include <QVector>
+
+/** A match of a LiteralMatcher, from @p startColumn of @p startLine to @p endColumn of @p endLine inclusive */
+struct LiteralMatch
+{
+    int startLine;
+    int startColumn;
+    int endLine;
+    int endColumn;
+};
+
+/**
+ * Finds a piece of text in the cells of lines as Screen and the history
+ * store them, without turning them into a QString first.
+ *
+ * The cells are compared one character at a time, so the text must not
+ * contain characters which take more or less than one cell, see canMatch().
+ * Columns are cell columns, which is what selections use.
+ *
+ * Where SSE2 is available, the cells are first checked for the first and
+ * the last character of the text several cells at a time, and only the
+ * cells where both are found are compared with the whole text.
+ */
+class LiteralMatcher
+{
+public:
+    LiteralMatcher(const QString& text, Qt::CaseSensitivity caseSensitivity);
+
+    /**
+     * Returns true if @p text can be found by a LiteralMatcher: it is not
+     * empty, does not span lines and every character takes one cell.
+     */
+    static bool canMatch(const QString& text);
+
+    /** Returns the number of characters, and cells, of the text */
+    int length() const { return _text.size(); }
+
+    /**
+     * Returns the first column at or after @p from of the @p count cells
+     * in @p cells at which the text starts, or -1 if there is none.
+     */
+    int indexIn(const CompactCharacter* cells, int count, int from) const;
+
+    /** Finds the text one cell at a time, see indexIn() */
+    int indexInScalar(const CompactCharacter* cells, int count, int from) const;
+
+private:
+    quint32 unit(const CompactCharacter& cell) const;
+    bool matchesAt(const CompactCharacter* cells) const;
+
+    // characters which can stand for a character of the text, at most MAX_VARIANTS
+    struct Variants
+    {
+        quint32 characters[4];
+        int count;
+    };
+    static const int MAX_VARIANTS = 4;
+    Variants variantsOf(quint32 c) const;
+
+    // the text, case folded if the case does not matter
+    QVector<quint32> _text;
+    Qt::CaseSensitivity _caseSensitivity;
+
+    // the cells the first and the last character of the text are looked for
+    // in, count is 0 if there are too many
+    Variants _first;
+    Variants _last;
+};
@@ -39,6 +39,7 @@
 #include "pseudoterminaldevice.h"
 
 #include <QSocketNotifier>
+#include <QElapsedTimer>
 #include <QDebug>
 
 #include <unistd.h>
@@ -54,19 +55,14 @@
 # include <sys/time.h>
 #endif
 
-#if defined(Q_OS_FREEBSD) || defined(Q_OS_MAC)
-// "the other end's output queue size" - kinda braindead, huh?
-# define PTY_BYTES_AVAILABLE TIOCOUTQ
-#elif defined(TIOCINQ)
-// "our end's input queue size"
-# define PTY_BYTES_AVAILABLE TIOCINQ
-#else
-// likewise. more generic ioctl (theoretically)
-# define PTY_BYTES_AVAILABLE FIONREAD
-#endif
-
-
+// The smallest and the default largest number of bytes read from the pty
+// before its data is handed out.
+#define MINIMUM_READ_BUDGET 16384
+#define DEFAULT_MAXIMUM_READ_BUDGET (1 << 20)
 
+// The time the consumer of the data should spend on each batch, in ns.
+// The read budget follows the rate at which the data is consumed.
+#define READ_TIME_SLICE 8000000
 
 //////////////////
 // private data //
@@ -90,71 +86,66 @@ static void qt_ignore_sigpipe()
 bool PseudoTerminalDevicePrivate::_k_canRead()
 {
     Q_Q(PseudoTerminalDevice);
-    qint64 readBytes = 0;
 
-#ifdef Q_OS_IRIX // this should use a config define, but how to check it?
-    size_t available;
-#else
-    int available;
-#endif
-    if (!::ioctl(q->masterFd(), PTY_BYTES_AVAILABLE, (char *) &available)) {
-#ifdef Q_OS_SOLARIS
-        // A Pty is a STREAMS module, and those can be activated
-        // with 0 bytes available. This happens either when ^C is
-        // pressed, or when an application does an explicit write(a,b,0)
-        // which happens in experiments fairly often. When 0 bytes are
-        // available, you must read those 0 bytes to clear the STREAMS
-        // module, but we don't want to hit the !readBytes case further down.
-        if (!available) {
-            char c;
-            // Read the 0-byte STREAMS message
-            NO_INTR(readBytes, read(q->masterFd(), &c, 0));
-            // Should return 0 bytes read; -1 is error
-            if (readBytes < 0) {
-                readNotifier->setEnabled(false);
-                emit q->readEof();
-                return false;
-            }
-            return true;
+    // Drain the pty until it would block or the budget is used up,
+    // so a flood of output is handed out in a few large batches.
+    int totalBytes = 0;
+    while (totalBytes < readBudget) {
+        const int length = readBudget - totalBytes;
+        char *ptr = readBuffer.reserve(length);
+        qint64 readBytes;
+        NO_INTR(readBytes, read(q->masterFd(), ptr, length));
+        readBuffer.unreserve(length - qMax<qint64>(readBytes, 0));
+
+        if (readBytes > 0) {
+            totalBytes += readBytes;
+            continue;
         }
-#endif
-
-        char *ptr = readBuffer.reserve(available);
+        if (readBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
 #ifdef Q_OS_SOLARIS
-        // Even if available > 0, it is possible for read()
-        // to return 0 on Solaris, due to 0-byte writes in the stream.
-        // Ignore them and keep reading until we hit *some* data.
-        // In Solaris it is possible to have 15 bytes available
-        // and to (say) get 0, 0, 6, 0 and 9 bytes in subsequent reads.
-        // Because the stream is set to O_NONBLOCK in finishOpen(),
-        // an EOF read will return -1.
-        readBytes = 0;
-        while (!readBytes)
+        // A Pty is a STREAMS module, and those can be activated with
+        // 0 bytes available, for example when an application does an
+        // explicit write(a,b,0). Because the stream is set to O_NONBLOCK
+        // in finishOpen(), an EOF read will return -1.
+        if (!readBytes)
+            break;
 #endif
-            // Useless block braces except in Solaris
-        {
-            NO_INTR(readBytes, read(q->masterFd(), ptr, available));
-        }
-        if (readBytes < 0) {
-            readBuffer.unreserve(available);
-            q->setErrorString("Error reading from PTY");
-            return false;
-        }
-        readBuffer.unreserve(available - readBytes); // *should* be a no-op
-    }
+        if (totalBytes)
+            break;
 
-    if (!readBytes) {
+        // Linux reports EIO rather than EOF once the slave is closed
         readNotifier->setEnabled(false);
+        if (readBytes < 0)
+            q->setErrorString("Error reading from PTY");
         emit q->readEof();
         return false;
-    } else {
-        if (!emittedReadyRead) {
-            emittedReadyRead = true;
-            emit q->readyRead();
-            emittedReadyRead = false;
-        }
-        return true;
     }
+
+    if (!totalBytes)
+        return false;
+
+    if (!emittedReadyRead) {
+        QElapsedTimer timer;
+        timer.start();
+        emittedReadyRead = true;
+        emit q->readyRead();
+        emittedReadyRead = false;
+        adaptReadBudget(totalBytes, timer.nsecsElapsed());
+    }
+    return true;
+}
+
+void PseudoTerminalDevicePrivate::adaptReadBudget(int bytes, qint64 nsecs)
+{
+    // Small batches say little about the rate the data is consumed at
+    if (bytes < MINIMUM_READ_BUDGET / 4 || nsecs <= 0)
+        return;
+
+    const qint64 budget = qint64(bytes) * READ_TIME_SLICE / nsecs;
+    readBudget = qBound<qint64>(MINIMUM_READ_BUDGET,
+                                (readBudget + budget) / 2,
+                                qMax(maximumReadBudget, MINIMUM_READ_BUDGET));
 }
 
 bool PseudoTerminalDevicePrivate::_k_canWrite()
@@ -296,6 +287,8 @@ void PseudoTerminalDevicePrivate::finishOpen(QIODevice::OpenMode mode)
 PseudoTerminalDevice::PseudoTerminalDevice(QObject *parent) :
     QIODevice(parent),
     d_ptr(new PseudoTerminalDevicePrivate(this)) {
+    d_ptr->maximumReadBudget = DEFAULT_MAXIMUM_READ_BUDGET;
+    d_ptr->readBudget = MINIMUM_READ_BUDGET;
 }
 
 PseudoTerminalDevice::~PseudoTerminalDevice() {
@@ -896,6 +889,37 @@ bool PseudoTerminalDevice::waitForBytesWritten(int msecs)
     return d->doWait(msecs, false);
 }
 
+const char *PseudoTerminalDevice::readBufferPointer() const
+{
+    Q_D(const PseudoTerminalDevice);
+    return d->readBuffer.readPointer();
+}
+
+int PseudoTerminalDevice::readBufferSize() const
+{
+    Q_D(const PseudoTerminalDevice);
+    return d->readBuffer.readSize();
+}
+
+void PseudoTerminalDevice::freeReadBuffer(int bytes)
+{
+    Q_D(PseudoTerminalDevice);
+    d->readBuffer.free(bytes);
+}
+
+void PseudoTerminalDevice::setMaximumReadBudget(int bytes)
+{
+    Q_D(PseudoTerminalDevice);
+    d->maximumReadBudget = bytes;
+    d->readBudget = qBound(MINIMUM_READ_BUDGET, d->readBudget, qMax(bytes, MINIMUM_READ_BUDGET));
+}
+
+int PseudoTerminalDevice::maximumReadBudget() const
+{
+    Q_D(const PseudoTerminalDevice);
+    return d->maximumReadBudget;
+}
+
 void PseudoTerminalDevice::setSuspended(bool suspended)
 {
     Q_D(PseudoTerminalDevice);
@@ -387,6 +387,31 @@ public:
     bool waitForBytesWritten(int msecs = -1);
     bool waitForReadyRead(int msecs = -1);
 
+    /**
+     * Returns the data which has been read from the pty and not been
+     * consumed yet, without copying it.  The data is contiguous, its length
+     * is returned by readBufferSize().  The pointer stays valid until the
+     * pty is read from the next time.
+     */
+    const char *readBufferPointer() const;
+
+    /** Returns the length of the data returned by readBufferPointer(). */
+    int readBufferSize() const;
+
+    /** Consumes @p bytes bytes at the start of the buffered data. */
+    void freeReadBuffer(int bytes);
+
+    /**
+     * Sets the largest number of bytes which are read from the pty before
+     * readyRead() is emitted.  The device drains the pty in batches whose
+     * size follows the rate at which the data is consumed in the slots
+     * connected to readyRead(), up to this limit.  The default is 1 MiB.
+     */
+    void setMaximumReadBudget(int bytes);
+
+    /** Returns the limit set with setMaximumReadBudget(). */
+    int maximumReadBudget() const;
+
 signals:
     /**
      * Emitted when EOF is read from the PTY.
@@ -427,6 +452,8 @@ struct PseudoTerminalDevicePrivate {
     bool _k_canRead();
     bool _k_canWrite();
 
+    void adaptReadBudget(int bytes, qint64 nsecs);
+
     bool doWait(int msecs, bool reading);
     void finishOpen(QIODevice::OpenMode mode);
 
@@ -444,4 +471,8 @@ struct PseudoTerminalDevicePrivate {
     QSocketNotifier *writeNotifier;
     RingBuffer readBuffer;
     RingBuffer writeBuffer;
+
+    // number of bytes to read before handing out a batch
+    int readBudget;
+    int maximumReadBudget;
 };
@@ -37,6 +37,7 @@
 // Own includes
 #include "pseudoterminalprocess.h"
 #include "pseudoterminaldevice.h"
+#include "pseudoterminalreader.h"
 
 // System includes
 #include <stdlib.h>
@@ -52,11 +53,22 @@
 #include <QStringList>
 #include <QFile>
 #include <QDebug>
+#include <QTimer>
+#include <QElapsedTimer>
 
 #define DUMMYENV "_KPROCESS_DUMMY_="
 
+// Default time in ms which may be spent processing output per
+// event loop turn before the output is throttled
+#define DEFAULT_MAXIMUM_PROCESSING_TIME 16
+
+// Time in ms after which the output counts as not throttled
+// anymore if the limit has not been hit again
+#define THROTTLE_RELEASE_TIME 100
+
 PseudoTerminalProcess::PseudoTerminalProcess(QObject *parent) :
-    QProcess(parent) {
+    QProcess(parent),
+    _pseudoTerminalReader(0) {
     _pseudoTerminalDevice = new PseudoTerminalDevice(this);
     _pseudoTerminalDevice->open();
     connect(this, SIGNAL(stateChanged(QProcess::ProcessState)),
@@ -65,7 +77,8 @@ PseudoTerminalProcess::PseudoTerminalProcess(QObject *parent) :
 }
 
 PseudoTerminalProcess::PseudoTerminalProcess(int ptyMasterFd, QObject *parent) :
-    QProcess(parent) {
+    QProcess(parent),
+    _pseudoTerminalReader(0) {
     _pseudoTerminalDevice = new PseudoTerminalDevice(this);
     _pseudoTerminalDevice->open(ptyMasterFd);
     connect(this, SIGNAL(stateChanged(QProcess::ProcessState)),
@@ -79,6 +92,8 @@ PseudoTerminalProcess::~PseudoTerminalProcess() {
         disconnect(SIGNAL(stateChanged(QProcess::ProcessState)),
                    this, SLOT(stateChanged(QProcess::ProcessState)));
     }
+    // the reader thread must be gone before the pty is closed
+    delete _pseudoTerminalReader;
     delete _pseudoTerminalDevice;
 }
 
@@ -95,6 +110,55 @@ QSize PseudoTerminalProcess::windowSize() const {
     return QSize(_windowColumns,_windowLines);
 }
 
+void PseudoTerminalProcess::setThreadedReading(bool enabled) {
+    if (enabled == threadedReading() || pseudoTerminalDevice()->masterFd() < 0)
+        return;
+
+    if (enabled) {
+        // Stop watching the pty here and hand out what has been read so far
+        pseudoTerminalDevice()->setSuspended(true);
+        if (pseudoTerminalDevice()->bytesAvailable() > 0)
+            dataReceived();
+
+        _pseudoTerminalReader = new PseudoTerminalReader(pseudoTerminalDevice()->masterFd(), this);
+        connect(_pseudoTerminalReader, SIGNAL(readyRead()), this, SLOT(threadedDataReceived()));
+        // EOF is reported by the device, as when it reads the pty itself
+        connect(_pseudoTerminalReader, SIGNAL(readEof()), pseudoTerminalDevice(), SIGNAL(readEof()));
+        _pseudoTerminalReader->start();
+    } else {
+        _pseudoTerminalReader->stop();
+        processReaderData(0);
+        delete _pseudoTerminalReader;
+        _pseudoTerminalReader = 0;
+
+        pseudoTerminalDevice()->setSuspended(false);
+    }
+}
+
+bool PseudoTerminalProcess::threadedReading() const {
+    return _pseudoTerminalReader != 0;
+}
+
+void PseudoTerminalProcess::setMaximumProcessingTime(int msecs) {
+    _maximumProcessingTime = msecs;
+}
+
+int PseudoTerminalProcess::maximumProcessingTime() const {
+    return _maximumProcessingTime;
+}
+
+bool PseudoTerminalProcess::isThrottled() const {
+    return _throttled;
+}
+
+void PseudoTerminalProcess::setMaximumReadBudget(int bytes) {
+    pseudoTerminalDevice()->setMaximumReadBudget(bytes);
+}
+
+int PseudoTerminalProcess::maximumReadBudget() const {
+    return pseudoTerminalDevice()->maximumReadBudget();
+}
+
 void PseudoTerminalProcess::setFlowControlEnabled(bool enable) {
     _xonXoff = enable;
 
@@ -275,6 +339,14 @@ void PseudoTerminalProcess::initialize() {
     _xonXoff = true;
     _utf8 = true;
     _addUtmp = false;
+    _maximumProcessingTime = DEFAULT_MAXIMUM_PROCESSING_TIME;
+    _throttled = false;
+    _resumeScheduled = false;
+
+    _throttleTimer = new QTimer(this);
+    _throttleTimer->setSingleShot(true);
+    _throttleTimer->setInterval(THROTTLE_RELEASE_TIME);
+    connect(_throttleTimer, SIGNAL(timeout()), this, SLOT(releaseThrottle()));
 
     connect(pseudoTerminalDevice(), SIGNAL(readyRead()) , this , SLOT(dataReceived()));
     setPseudoTerminalChannels(PseudoTerminalProcess::AllChannels);
@@ -293,8 +365,74 @@ void PseudoTerminalProcess::sendData(const char* data, int length)
 }
 
 void PseudoTerminalProcess::dataReceived() {
-    QByteArray data = pseudoTerminalDevice()->readAll();
-    emit receivedData(data.constData(),data.count());
+    // Hand the data out straight from the device's buffer
+    const int length = pseudoTerminalDevice()->readBufferSize();
+    if (length <= 0)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    emit receivedData(pseudoTerminalDevice()->readBufferPointer(), length);
+    pseudoTerminalDevice()->freeReadBuffer(length);
+
+    if (_maximumProcessingTime > 0 && timer.elapsed() >= _maximumProcessingTime) {
+        // Leave further output in the kernel's buffer, which blocks the
+        // terminal program, until the event loop has had a turn.
+        pseudoTerminalDevice()->setSuspended(true);
+        throttle();
+    }
+}
+
+void PseudoTerminalProcess::threadedDataReceived() {
+    if (_pseudoTerminalReader && !processReaderData(_maximumProcessingTime))
+        throttle();
+}
+
+bool PseudoTerminalProcess::processReaderData(int msecs) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // The data is handed out straight from the reader's ring
+    const char *data;
+    int length;
+    while ((length = _pseudoTerminalReader->peek(&data)) > 0) {
+        emit receivedData(data, length);
+        _pseudoTerminalReader->release(length);
+
+        // The rest is processed after the event loop has had a turn.
+        // Meanwhile the reader fills its ring, once it is full the
+        // output stays in the kernel's buffer.
+        if (msecs > 0 && timer.elapsed() >= msecs)
+            return false;
+    }
+    return true;
+}
+
+void PseudoTerminalProcess::throttle() {
+    if (!_resumeScheduled) {
+        _resumeScheduled = true;
+        QTimer::singleShot(0, this, SLOT(resumeReading()));
+    }
+
+    _throttleTimer->start();
+    if (!_throttled) {
+        _throttled = true;
+        emit throttlingChanged(true);
+    }
+}
+
+void PseudoTerminalProcess::resumeReading() {
+    _resumeScheduled = false;
+
+    if (_pseudoTerminalReader)
+        threadedDataReceived();
+    else if (pseudoTerminalDevice()->masterFd() >= 0)
+        pseudoTerminalDevice()->setSuspended(false);
+}
+
+void PseudoTerminalProcess::releaseThrottle() {
+    _throttled = false;
+    emit throttlingChanged(false);
 }
 
 int PseudoTerminalProcess::foregroundProcessGroup() const {
@@ -38,6 +38,8 @@
 
 // Own includes
 class PseudoTerminalDevice;
+class PseudoTerminalReader;
+class QTimer;
 
 // System includes
 #include <signal.h>
@@ -129,6 +131,49 @@ public:
     /** Returns the size of the window used by this teletype.  See setWindowSize() */
     QSize windowSize() const;
 
+    /**
+     * Sets whether the output of the process is read on a thread of its
+     * own.  The reader thread keeps draining the pty while the thread this
+     * object lives in is busy, so the process does not block on a full pty
+     * buffer.  receivedData() is still emitted in this object's thread,
+     * once for each batch of data, and the readEof() signal of
+     * pseudoTerminalDevice() once the reader thread reads EOF.  Disabled by
+     * default.
+     */
+    void setThreadedReading(bool enabled);
+
+    /** Returns whether the output is read on a thread of its own. */
+    bool threadedReading() const;
+
+    /**
+     * Sets the largest number of bytes which are read from the pty before
+     * receivedData() is emitted, see PseudoTerminalDevice::setMaximumReadBudget().
+     */
+    void setMaximumReadBudget(int bytes);
+
+    /** Returns the limit set with setMaximumReadBudget(). */
+    int maximumReadBudget() const;
+
+    /**
+     * Sets the time in milliseconds which may be spent processing output
+     * in the slots connected to receivedData() per event loop turn.  Once
+     * the limit is hit, no more output is read until the event loop has
+     * processed the other pending events.  Meanwhile the output is left in
+     * the pty, which blocks the terminal program when it is full.  A value
+     * of 0 disables the limit.  The default is 16 ms.
+     */
+    void setMaximumProcessingTime(int msecs);
+
+    /** Returns the limit set with setMaximumProcessingTime(). */
+    int maximumProcessingTime() const;
+
+    /**
+     * Returns true if the output of the process has recently been held
+     * back because processing it took too long.
+     * See setMaximumProcessingTime().
+     */
+    bool isThrottled() const;
+
     /** TODO Document me */
     void setErase(char erase);
 
@@ -384,11 +429,20 @@ signals:
      */
     void receivedData(const char* buffer, int length);
 
+    /**
+     * Emitted when the output of the process starts or stops being
+     * held back.  See isThrottled().
+     */
+    void throttlingChanged(bool throttled);
+
 protected:
     virtual void setupChildProcess();
 
 private slots:
     void dataReceived();
+    void threadedDataReceived();
+    void resumeReading();
+    void releaseThrottle();
     void stateChanged(QProcess::ProcessState newState);
 
 private:
@@ -398,6 +452,11 @@ private:
 
     void appendEnvironmentVariables(QStringList environment);
 
+    // Hands out the data of the reader thread until it is all processed
+    // or @p msecs have passed.  Returns false if data was left over.
+    bool processReaderData(int msecs);
+    void throttle();
+
     int  _windowColumns;
     int  _windowLines;
     char _eraseChar;
@@ -405,6 +464,12 @@ private:
     bool _utf8;
 
     PseudoTerminalDevice *_pseudoTerminalDevice;
+    PseudoTerminalReader *_pseudoTerminalReader;
+
+    int _maximumProcessingTime;
+    bool _throttled;
+    bool _resumeScheduled;
+    QTimer *_throttleTimer;
     PseudoTerminalProcess::PseudoTerminalChannels _pseudoTerminalChannels;
     bool _addUtmp;
 
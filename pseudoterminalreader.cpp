@@ -0,0 +1,179 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "pseudoterminalreader.h"
+#include "ringbuffer.h"
+
+// System includes
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+
+// Qt includes
+#include <QDebug>
+
+// Must be a power of two and a multiple of the page size
+#define RING_SIZE (1 << 20)
+
+#define NO_INTR(ret,func) do { ret = func; } while (ret < 0 && errno == EINTR)
+
+PseudoTerminalReader::PseudoTerminalReader(int masterFd, QObject *parent) :
+    QThread(parent),
+    _masterFd(masterFd),
+    _ring(RingBuffer::allocateMirrored(RING_SIZE)),
+    _mirrored(_ring != 0),
+    _head(0),
+    _tail(0),
+    _notified(0),
+    _waitingForSpace(0),
+    _stopping(0) {
+    if (!_mirrored)
+        _ring = new char[RING_SIZE];
+
+    if (::pipe(_wakeUpPipe) < 0) {
+        qWarning() << "Unable to create the wake up pipe for the pty reader.";
+        _wakeUpPipe[0] = _wakeUpPipe[1] = -1;
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(_wakeUpPipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(_wakeUpPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+}
+
+PseudoTerminalReader::~PseudoTerminalReader() {
+    stop();
+    if (_wakeUpPipe[0] >= 0) {
+        ::close(_wakeUpPipe[0]);
+        ::close(_wakeUpPipe[1]);
+    }
+    if (_mirrored)
+        RingBuffer::releaseMirrored(_ring, RING_SIZE);
+    else
+        delete[] _ring;
+}
+
+void PseudoTerminalReader::stop() {
+    if (!isRunning())
+        return;
+
+    _stopping.storeRelease(1);
+    wakeUp();
+    wait();
+    _stopping.storeRelease(0);
+}
+
+int PseudoTerminalReader::peek(const char **data) {
+    // Clear the flag before looking at the head, so that data which is
+    // published after this point is announced with another readyRead().
+    _notified.fetchAndStoreOrdered(0);
+
+    const uint tail = _tail.load();
+    const uint offset = tail & (RING_SIZE - 1);
+    const uint pending = _head.loadAcquire() - tail;
+
+    *data = _ring + offset;
+    return _mirrored ? pending : qMin<uint>(pending, RING_SIZE - offset);
+}
+
+void PseudoTerminalReader::release(int length) {
+    _tail.storeRelease(_tail.load() + length);
+
+    if (_waitingForSpace.fetchAndStoreOrdered(0))
+        wakeUp();
+}
+
+void PseudoTerminalReader::wakeUp() {
+    const char c = 0;
+    int ret;
+    NO_INTR(ret, ::write(_wakeUpPipe[1], &c, 1));
+}
+
+void PseudoTerminalReader::run() {
+    if (_wakeUpPipe[0] < 0)
+        return;
+
+    while (!_stopping.loadAcquire()) {
+        const uint head = _head.load();
+        uint space = RING_SIZE - (head - _tail.loadAcquire());
+
+        struct pollfd fds[2];
+        fds[0].fd = _wakeUpPipe[0];
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = _masterFd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        nfds_t count = 2;
+
+        if (space == 0) {
+            // Only wait for the consumer.  It may have released space
+            // between the check above and setting the flag, though.
+            _waitingForSpace.fetchAndStoreOrdered(1);
+            space = RING_SIZE - (head - _tail.loadAcquire());
+            if (space > 0) {
+                _waitingForSpace.fetchAndStoreOrdered(0);
+                continue;
+            }
+            count = 1;
+        }
+
+        int ret;
+        NO_INTR(ret, ::poll(fds, count, -1));
+        if (ret < 0) {
+            qWarning() << "Error waiting for the pty:" << strerror(errno);
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char buffer[64];
+            while (::read(_wakeUpPipe[0], buffer, sizeof(buffer)) > 0)
+                ;
+        }
+
+        if (count < 2 || !fds[1].revents)
+            continue;
+
+        // Unless the ring is mapped twice, read up to its end only.
+        // The next round continues at its start.
+        const uint offset = head & (RING_SIZE - 1);
+        const uint length = _mirrored ? space : qMin<uint>(space, RING_SIZE - offset);
+        ssize_t readBytes;
+        NO_INTR(readBytes, ::read(_masterFd, _ring + offset, length));
+        if (readBytes < 0 && errno == EAGAIN)
+            continue;
+
+        if (readBytes <= 0) {
+            // Once the slave side is gone, Linux reports EIO instead of EOF
+            emit readEof();
+            return;
+        }
+
+        _head.storeRelease(head + readBytes);
+
+        if (!_notified.fetchAndStoreOrdered(1))
+            emit readyRead();
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Qt includes
+#include <QThread>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+/**
+ * Reads the output of a terminal program on a thread of its own.
+ *
+ * The thread drains the pty master into a ring buffer which is shared with
+ * the thread the reader was created in, so the terminal program can keep
+ * writing while that thread is busy, for example with painting.  The ring
+ * has a single producer (the reader thread) and a single consumer and is
+ * synchronized with atomic positions only.
+ *
+ * readyRead() is emitted once for each batch of data; it is not emitted
+ * again until the consumer has looked at the ring with peek().  The
+ * consumer processes the pending data in place and hands the space back
+ * with release().
+ */
+class PseudoTerminalReader : public QThread {
+    Q_OBJECT
+
+public:
+    /**
+     * Constructs a reader for the pty master @p masterFd.  The reader does
+     * not take ownership of the descriptor.  Call start() to start reading.
+     */
+    explicit PseudoTerminalReader(int masterFd, QObject *parent = 0);
+
+    /** Stops the reader thread. */
+    virtual ~PseudoTerminalReader();
+
+    /** Asks the reader thread to finish and waits until it has. */
+    void stop();
+
+    /**
+     * Points @p data at the data which has been read from the terminal and
+     * not released yet and returns its length.  The ring is mapped twice
+     * in a row, so the data is contiguous even if it wraps around the end
+     * of the ring.  Where that is not possible, only the part up to the
+     * end is returned; the rest is returned by the next call after
+     * release().
+     *
+     * Must only be called from the thread the reader was created in.
+     */
+    int peek(const char **data);
+
+    /**
+     * Hands @p length bytes at the start of the pending data back to the
+     * reader thread.
+     */
+    void release(int length);
+
+signals:
+    /**
+     * Emitted from the reader thread when new data is available
+     * after the consumer has last called peek().
+     */
+    void readyRead();
+
+    /**
+     * Emitted from the reader thread when EOF is read from the pty, after
+     * which the thread finishes.  Data may still remain in the ring.
+     */
+    void readEof();
+
+protected:
+    virtual void run();
+
+private:
+    void wakeUp();
+
+    int _masterFd;
+    int _wakeUpPipe[2];
+
+    char *_ring;
+    bool _mirrored;
+
+    // Positions of the producer and the consumer.  They only ever grow,
+    // the offset into the ring is the position modulo its size.
+    QAtomicInteger<uint> _head;
+    QAtomicInteger<uint> _tail;
+
+    QAtomicInt _notified;
+    QAtomicInt _waitingForSpace;
+    QAtomicInt _stopping;
+};
@@ -2,19 +2,22 @@ QT += widgets
 
 TEMPLATE = lib
 TARGET = qtterminalwidget
-CONFIG += staticlib
+CONFIG += staticlib c++14
 
 HEADERS += \
            konsole_wcwidth.h \
     terminalwidget.h \
     blockarray.h \
     character.h \
+    characterstyle.h \
     charactercolor.h \
     colorscheme.h \
     defaulttranslatortext.h \
     extendeddefaulttranslator.h \
     filter.h \
     history.h \
+    historyindex.h \
+    historymatches.h \
     historysearch.h \
     keyboardtranslator.h \
     screen.h \
@@ -28,15 +31,25 @@ HEADERS += \
     ringbuffer.h \
     pseudoterminaldevice.h \
     pseudoterminalprocess.h \
-    terminalemulation.h
+    pseudoterminalreader.h \
+    terminalemulation.h \
+    utf8decoder.h \
+    framescheduler.h \
+    linecompare.h \
+    literalmatcher.h \
+    compiledregexp.h \
+    blockcodec.h
 FORMS += SearchBar.ui
 SOURCES += \
            konsole_wcwidth.cpp \
     terminalwidget.cpp \
     blockarray.cpp \
+    characterstyle.cpp \
     colorscheme.cpp \
     filter.cpp \
     history.cpp \
+    historyindex.cpp \
+    historymatches.cpp \
     historysearch.cpp \
     keyboardtranslator.cpp \
     screen.cpp \
@@ -49,7 +62,15 @@ SOURCES += \
     terminalsession.cpp \
     pseudoterminaldevice.cpp \
     pseudoterminalprocess.cpp \
-    terminalemulation.cpp
+    pseudoterminalreader.cpp \
+    ringbuffer.cpp \
+    terminalemulation.cpp \
+    utf8decoder.cpp \
+    framescheduler.cpp \
+    linecompare.cpp \
+    literalmatcher.cpp \
+    compiledregexp.cpp \
+    blockcodec.cpp
 RESOURCES += \
              designer/qtermwidgetplugin.qrc \
     color-schemes/colorschemes.qrc \
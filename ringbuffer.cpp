@@ -0,0 +1,131 @@
+/*
+ * Modifications and refactoring. Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ *
+ * Copyright (C) 2015 Jacob Dawid <jacob@omg-it.works>
+ */
+
+/* This file is part of the KDE libraries
+
+    Copyright (C) 2007 Oswald Buddenhagen <ossi@kde.org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ringbuffer.h"
+
+#include <QDebug>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define INITIAL_CAPACITY 65536
+
+// Returns a file descriptor for anonymous shared memory of the given size
+static int createSharedMemory(int size)
+{
+#ifdef MFD_CLOEXEC
+    int fd = memfd_create("qtterminalwidget-ringbuffer", MFD_CLOEXEC);
+#else
+    static QBasicAtomicInt counter = Q_BASIC_ATOMIC_INITIALIZER(0);
+    const QByteArray name = "/qtterminalwidget-" + QByteArray::number(getpid()) +
+                            "-" + QByteArray::number(counter.fetchAndAddRelaxed(1));
+    int fd = shm_open(name.constData(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+        shm_unlink(name.constData());
+#endif
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, size) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+char *RingBuffer::allocateMirrored(int capacity)
+{
+    int fd = createSharedMemory(capacity);
+    if (fd < 0)
+        return 0;
+
+    // Reserve the address range for both copies first, then put the
+    // same pages into each half of it.
+    char *data = (char *)mmap(0, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data != MAP_FAILED) {
+        if (mmap(data, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(data + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(data, 2 * capacity);
+            data = 0;
+        }
+    } else {
+        data = 0;
+    }
+
+    ::close(fd);
+    return data;
+}
+
+void RingBuffer::releaseMirrored(char *data, int capacity)
+{
+    munmap(data, 2 * capacity);
+}
+
+RingBuffer::~RingBuffer()
+{
+    if (_mirrored)
+        releaseMirrored(_data, _capacity);
+    else
+        delete[] _data;
+}
+
+void RingBuffer::grow(int bytes)
+{
+    const int pageSize = sysconf(_SC_PAGESIZE);
+    int capacity = qMax(INITIAL_CAPACITY, pageSize);
+    while (capacity < bytes)
+        capacity *= 2;
+
+    bool mirrored = true;
+    char *data = allocateMirrored(capacity);
+    if (!data) {
+        if (_data == 0)
+            qWarning() << "Unable to map the ring buffer twice, falling back to copying.";
+        mirrored = false;
+        data = new char[capacity];
+    }
+
+    if (_size > 0)
+        memcpy(data, readPointer(), _size);
+
+    if (_mirrored)
+        releaseMirrored(_data, _capacity);
+    else
+        delete[] _data;
+
+    _data = data;
+    _capacity = capacity;
+    _mirrored = mirrored;
+    _head = 0;
+}
+
+void RingBuffer::compact()
+{
+    memmove(_data, _data + _head, _size);
+    _head = 0;
+}
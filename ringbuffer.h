@@ -27,101 +27,86 @@
 
 #pragma once
 
-#include <QByteArray>
-#include <QLinkedList>
+#include <QtGlobal>
+
+#include <string.h>
 
 #define KMAXINT ((int)(~0U >> 1))
-#define CHUNKSIZE 4096
 
+/**
+ * A byte queue in one contiguous, power-of-two sized block of memory.
+ *
+ * The pages of the block are mapped twice, back to back, so data which
+ * wraps around the end of the block can still be accessed as a single
+ * span: readPointer() always covers all pending bytes and reserve() always
+ * returns contiguous space.  If the system cannot map memory twice, the
+ * pending bytes are moved to the start of the block instead whenever a
+ * reservation would run over its end.
+ *
+ * The block only grows when more bytes are pending than fit into it, it
+ * is not reallocated when the buffer drains.
+ */
 class RingBuffer {
 public:
-    RingBuffer() {
-        clear();
+    RingBuffer() :
+        _data(0),
+        _capacity(0),
+        _mirrored(false),
+        _head(0),
+        _size(0) {
     }
 
+    ~RingBuffer();
+
     void clear() {
-        buffers.clear();
-        QByteArray tmp;
-        tmp.resize(CHUNKSIZE);
-        buffers << tmp;
-        head = tail = 0;
-        totalSize = 0;
+        _head = _size = 0;
     }
 
     inline bool isEmpty() const
     {
-        return buffers.count() == 1 && !tail;
+        return !_size;
     }
 
     inline int size() const
     {
-        return totalSize;
+        return _size;
     }
 
+    // all pending bytes are contiguous
     inline int readSize() const
     {
-        return (buffers.count() == 1 ? tail : buffers.first().size()) - head;
+        return _size;
     }
 
     inline const char *readPointer() const
     {
-        Q_ASSERT(totalSize > 0);
-        return buffers.first().constData() + head;
+        Q_ASSERT(_size > 0);
+        return _data + _head;
     }
 
-    void free(int bytes)
+    inline void free(int bytes)
     {
-        totalSize -= bytes;
-        Q_ASSERT(totalSize >= 0);
-
-        forever {
-            int nbs = readSize();
-
-            if (bytes < nbs) {
-                head += bytes;
-                if (head == tail && buffers.count() == 1) {
-                    buffers.first().resize(CHUNKSIZE);
-                    head = tail = 0;
-                }
-                break;
-            }
-
-            bytes -= nbs;
-            if (buffers.count() == 1) {
-                buffers.first().resize(CHUNKSIZE);
-                head = tail = 0;
-                break;
-            }
-
-            buffers.removeFirst();
-            head = 0;
-        }
+        Q_ASSERT(bytes <= _size);
+        _size -= bytes;
+        _head = _size ? (_head + bytes) & (_capacity - 1) : 0;
     }
 
-    char *reserve(int bytes)
+    inline char *reserve(int bytes)
     {
-        totalSize += bytes;
-
-        char *ptr;
-        if (tail + bytes <= buffers.last().size()) {
-            ptr = buffers.last().data() + tail;
-            tail += bytes;
-        } else {
-            buffers.last().resize(tail);
-            QByteArray tmp;
-            tmp.resize(qMax(CHUNKSIZE, bytes));
-            ptr = tmp.data();
-            buffers << tmp;
-            tail = bytes;
-        }
+        if (_size + bytes > _capacity)
+            grow(_size + bytes);
+        else if (!_mirrored && _head + _size + bytes > _capacity)
+            compact();
+
+        char *ptr = _data + _head + _size;
+        _size += bytes;
         return ptr;
     }
 
     // release a trailing part of the last reservation
     inline void unreserve(int bytes)
     {
-        totalSize -= bytes;
-        tail -= bytes;
+        _size -= bytes;
     }
 
     inline void write(const char *data, int len)
@@ -134,25 +119,14 @@ public:
     // it is smaller than the buffer size. Otherwise -1 is returned.
     int indexAfter(char c, int maxLength = KMAXINT) const
     {
-        int index = 0;
-        int start = head;
-        QLinkedList<QByteArray>::ConstIterator it = buffers.begin();
-        forever {
-            if (!maxLength)
-                return index;
-            if (index == size())
-                return -1;
-            const QByteArray &buf = *it;
-            ++it;
-            int len = qMin((it == buffers.end() ? tail : buf.size()) - start,
-                           maxLength);
-            const char *ptr = buf.data() + start;
-            if (const char *rptr = (const char *)memchr(ptr, c, len))
-                return index + (rptr - ptr) + 1;
-            index += len;
-            maxLength -= len;
-            start = 0;
-        }
+        const int length = qMin(_size, maxLength);
+        if (!length)
+            return maxLength ? -1 : 0;
+
+        const char *ptr = readPointer();
+        if (const char *rptr = (const char *)memchr(ptr, c, length))
+            return (rptr - ptr) + 1;
+        return maxLength <= _size ? maxLength : -1;
     }
 
     inline int lineSize(int maxLength = KMAXINT) const
@@ -167,16 +141,12 @@ public:
 
     int read(char *data, int maxLength)
     {
-        int bytesToRead = qMin(size(), maxLength);
-        int readSoFar = 0;
-        while (readSoFar < bytesToRead) {
-            const char *ptr = readPointer();
-            int bs = qMin(bytesToRead - readSoFar, readSize());
-            memcpy(data + readSoFar, ptr, bs);
-            readSoFar += bs;
-            free(bs);
+        const int bytesToRead = qMin(size(), maxLength);
+        if (bytesToRead > 0) {
+            memcpy(data, readPointer(), bytesToRead);
+            free(bytesToRead);
         }
-        return readSoFar;
+        return bytesToRead;
     }
 
     int readLine(char *data, int maxLength)
@@ -184,8 +154,26 @@ public:
         return read(data, lineSize(qMin(maxLength, size())));
     }
 
+    /**
+     * Maps @p capacity bytes of memory twice, back to back.  @p capacity
+     * must be a multiple of the page size.  Returns 0 if the system does
+     * not support it.
+     */
+    static char *allocateMirrored(int capacity);
+
+    /** Releases memory returned by allocateMirrored(). */
+    static void releaseMirrored(char *data, int capacity);
+
 private:
-    QLinkedList<QByteArray> buffers;
-    int head, tail;
-    int totalSize;
+    Q_DISABLE_COPY(RingBuffer)
+
+    void grow(int bytes);
+    void compact();
+
+    char *_data;
+    int _capacity;
+    bool _mirrored;
+
+    int _head;
+    int _size;
 };
@@ -33,6 +33,7 @@
 #include "terminalcharacterdecoder.h"
 
 // Standard includes
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -69,25 +70,44 @@ Character Screen::defaultChar = Character(' ',
 
 //#define REVERSE_WRAPPED_LINES  // for wrapped line debug
 
+// Number of history lines which writeToStream() decodes at once
+static const int HISTORY_BATCH_LINES = 64;
+
+// Generations of history lines have the top bit set, so that they can never
+// be confused with the generations of screen lines.
+static const quint64 HISTORY_LINE_GENERATION = Q_UINT64_C(1) << 63;
+
 Screen::Screen(int l, int c)
     : lines(l),
       columns(c),
-      screenLines(new ImageLine[lines+1] ),
+      screenLines(new ImageLine*[lines+1] ),
       _scrolledLines(0),
       _droppedLines(0),
+      _generation(0),
+      _addedHistoryLines(0),
+      _selectionGeneration(0),
       history(new HistoryScrollNone()),
+      _historyIndex(0),
       cuX(0), cuY(0),
       currentRendition(0),
       _topMargin(0), _bottomMargin(0),
       selBegin(0), selTopLeft(0), selBottomRight(0),
       blockSelectionMode(false),
       effectiveForeground(CharacterColor()), effectiveBackground(CharacterColor()), effectiveRendition(0),
+      effectiveStyle(0),
       lastPos(-1)
 {
+    for (int i=0;i<lines+1;i++)
+        screenLines[i] = new ImageLine();
+
     lineProperties.resize(lines+1);
     for (int i=0;i<lines+1;i++)
         lineProperties[i]=LINE_DEFAULT;
 
+    lineGenerations.resize(lines+1);
+    for (int i=0;i<lines+1;i++)
+        touchLine(i);
+
     initTabStops();
     clearSelection();
     reset();
@@ -98,8 +118,11 @@ Screen::Screen(int l, int c)
 
 Screen::~Screen()
 {
+    for (int i=0;i<lines+1;i++)
+        delete screenLines[i];
     delete[] screenLines;
     delete history;
+    delete _historyIndex;
 }
 
 void Screen::cursorUp(int n)
@@ -202,29 +225,32 @@ void Screen::deleteChars(int n)
         n = 1;
 
     // if cursor is beyond the end of the line there is nothing to do
-    if ( cuX >= screenLines[cuY].count() )
+    if ( cuX >= screenLines[cuY]->count() )
         return;
 
-    if ( cuX+n > screenLines[cuY].count() )
-        n = screenLines[cuY].count() - cuX;
+    if ( cuX+n > screenLines[cuY]->count() )
+        n = screenLines[cuY]->count() - cuX;
 
     Q_ASSERT( n >= 0 );
-    Q_ASSERT( cuX+n <= screenLines[cuY].count() );
+    Q_ASSERT( cuX+n <= screenLines[cuY]->count() );
 
-    screenLines[cuY].remove(cuX,n);
+    screenLines[cuY]->remove(cuX,n);
+    touchLine(cuY);
 }
 
 void Screen::insertChars(int n)
 {
     if (n == 0) n = 1; // Default
 
-    if ( screenLines[cuY].size() < cuX )
-        screenLines[cuY].resize(cuX);
+    if ( screenLines[cuY]->size() < cuX )
+        screenLines[cuY]->resize(cuX);
+
+    screenLines[cuY]->insert(cuX,n,' ');
 
-    screenLines[cuY].insert(cuX,n,' ');
+    if ( screenLines[cuY]->count() > columns )
+        screenLines[cuY]->resize(columns);
 
-    if ( screenLines[cuY].count() > columns )
-        screenLines[cuY].resize(columns);
+    touchLine(cuY);
 }
 
 void Screen::deleteLines(int n)
@@ -304,18 +330,23 @@ void Screen::resizeImage(int new_lines, int new_columns)
         }
     }
 
-    // create new screen lines and copy from old to new
-
-    ImageLine* newScreenLines = new ImageLine[new_lines+1];
+    // create a new table of screen lines, the line buffers are handed over
+    ImageLine** newScreenLines = new ImageLine*[new_lines+1];
     for (int i=0; i < qMin(lines,new_lines+1) ;i++)
         newScreenLines[i]=screenLines[i];
-    for (int i=lines;(i > 0) && (i<new_lines+1);i++)
-        newScreenLines[i].resize( new_columns );
+    for (int i=qMin(lines,new_lines+1); i < lines+1; i++)
+        delete screenLines[i];
+    for (int i=qMin(lines,new_lines+1); i < new_lines+1; i++)
+        newScreenLines[i] = new ImageLine( new_columns );
 
     lineProperties.resize(new_lines+1);
     for (int i=lines;(i > 0) && (i<new_lines+1);i++)
         lineProperties[i] = LINE_DEFAULT;
 
+    lineGenerations.resize(new_lines+1);
+    for (int i=lines;(i > 0) && (i<new_lines+1);i++)
+        touchLine(i);
+
     clearSelection();
 
     delete[] screenLines;
@@ -399,19 +430,42 @@ void Screen::updateEffectiveRendition()
 
     if (currentRendition & RE_BOLD)
         effectiveForeground.toggleIntensive();
+
+    // every new combination of colors adds a style, most of which are
+    // overwritten or scrolled into the history soon
+    if (_styles.needsCompaction())
+        compactStyles();
+
+    effectiveStyle = _styles.indexOf(CharacterStyle(effectiveRendition,
+                                                    effectiveForeground,
+                                                    effectiveBackground));
+}
+
+void Screen::compactStyles()
+{
+    // the spare line after the last one is rotated into the screen as well
+    QBitArray used(_styles.count());
+    used.setBit(effectiveStyle);
+    for (int i = 0; i < lines + 1; i++)
+        CharacterStyleTable::markStyles(screenLines[i]->constData(), screenLines[i]->count(), used);
+
+    const QVector<quint32> indexes = _styles.compact(used);
+    for (int i = 0; i < lines + 1; i++)
+        CharacterStyleTable::renumberStyles(screenLines[i]->data(), screenLines[i]->count(), indexes);
+    effectiveStyle = indexes.at(effectiveStyle);
 }
 
 void Screen::copyFromHistory(Character* dest, int startLine, int count) const
 {
     Q_ASSERT( startLine >= 0 && count > 0 && startLine + count <= history->getLines() );
 
+    history->getCellsOfLines(startLine,count,columns,dest);
+
     for (int line = startLine; line < startLine + count; line++)
     {
         const int length = qMin(columns,history->getLineLen(line));
         const int destLineOffset  = (line-startLine)*columns;
 
-        history->getCells(line,0,length,dest + destLineOffset);
-
         for (int column = length; column < columns; column++)
             dest[destLineOffset+column] = defaultChar;
 
@@ -433,23 +487,28 @@ void Screen::copyFromScreen(Character* dest , int startLine , int count) const
 {
     Q_ASSERT( startLine >= 0 && count > 0 && startLine + count <= lines );
 
+    // lines end after their last character, the rest is blank
+    const Character blank = _styles.toCharacter(CompactCharacter());
+
     for (int line = startLine; line < (startLine+count) ; line++)
     {
-        int srcLineStartIndex  = line*columns;
-        int destLineStartIndex = (line-startLine)*columns;
+        const ImageLine* source = screenLines[line];
+        Character* destLine = dest + (line-startLine)*columns;
 
-        for (int column = 0; column < columns; column++)
-        {
-            int srcIndex = srcLineStartIndex + column;
-            int destIndex = destLineStartIndex + column;
-
-            dest[destIndex] = screenLines[srcIndex/columns].value(srcIndex%columns,defaultChar);
+        const int length = qMin(columns, source->size());
+        _styles.toCharacters(source->constData(), length, destLine);
+        for (int column = length; column < columns; column++)
+            destLine[column] = blank;
 
-            // invert selected text
-            if (selBegin != -1 && isSelected(column,line + history->getLines()))
-                reverseRendition(dest[destIndex]);
+        // invert selected text
+        if (selBegin != -1)
+        {
+            for (int column = 0; column < columns; column++)
+            {
+                if (isSelected(column,line + history->getLines()))
+                    reverseRendition(destLine[column]);
+            }
         }
-
     }
 }
 
@@ -483,10 +542,12 @@ void Screen::getImage( Character* dest, int size, int startLine, int endLine ) c
             reverseRendition(dest[i]); // for reverse display
     }
 
-    // mark the character at the current cursor position
-    int cursorIndex = loc(cuX, cuY + linesInHistoryBuffer);
-    if(getMode(MODE_Cursor) && cursorIndex < columns*mergedLines)
-        dest[cursorIndex].rendition |= RE_CURSOR;
+    // mark the character at the current cursor position.  the cursor stays
+    // on its line when it waits behind the last column for a wrap, so that
+    // the lines of the image can also be retrieved one at a time.
+    int cursorLine = cuY + history->getLines() - startLine;
+    if(getMode(MODE_Cursor) && cursorLine >= 0 && cursorLine < mergedLines)
+        dest[loc(qMin(cuX, columns-1), cursorLine)].rendition |= RE_CURSOR;
 }
 
 QVector<LineProperty> Screen::getLineProperties( int startLine , int endLine ) const
@@ -523,6 +584,29 @@ QVector<LineProperty> Screen::getLineProperties( int startLine , int endLine ) c
     return result;
 }
 
+quint64 Screen::lineGeneration(int line) const
+{
+    Q_ASSERT( line >= 0 && line < history->getLines() + lines );
+
+    // history lines do not change once they have been added, so their
+    // generation is simply their position in the stream of added lines
+    const int historyLines = history->getLines();
+    if (line < historyLines)
+        return HISTORY_LINE_GENERATION | (_addedHistoryLines - historyLines + line);
+
+    return lineGenerations[line - historyLines];
+}
+
+quint64 Screen::selectionGeneration() const
+{
+    return _selectionGeneration;
+}
+
+void Screen::touchLine(int y)
+{
+    lineGenerations[y] = ++_generation;
+}
+
 void Screen::reset(bool clearScreen)
 {
     setMode(MODE_Wrap  ); saveMode(MODE_Wrap  );  // wrap at end of margin
@@ -539,7 +623,11 @@ void Screen::reset(bool clearScreen)
     saveCursor();
 
     if ( clearScreen )
+    {
         clear();
+        // the styles of the output before are gone with it
+        compactStyles();
+    }
 }
 
 void Screen::clear()
@@ -553,11 +641,14 @@ void Screen::backspace()
     cuX = qMin(columns-1,cuX); // nowrap!
     cuX = qMax(0,cuX-1);
 
-    if (screenLines[cuY].size() < cuX+1)
-        screenLines[cuY].resize(cuX+1);
+    if (screenLines[cuY]->size() < cuX+1)
+        screenLines[cuY]->resize(cuX+1);
 
     if (BS_CLEARS)
-        screenLines[cuY][cuX].character = ' ';
+    {
+        (*screenLines[cuY])[cuX].character = ' ';
+        touchLine(cuY);
+    }
 }
 
 void Screen::tab(int n)
@@ -644,10 +735,10 @@ void Screen::displayCharacter(unsigned short c)
     }
 
     // ensure current line vector has enough elements
-    int size = screenLines[cuY].size();
+    int size = screenLines[cuY]->size();
     if (size < cuX+w)
     {
-        screenLines[cuY].resize(cuX+w);
+        screenLines[cuY]->resize(cuX+w);
     }
 
     if (getMode(MODE_Insert)) insertChars(w);
@@ -657,12 +748,8 @@ void Screen::displayCharacter(unsigned short c)
     // check if selection is still valid.
     checkSelection(lastPos, lastPos);
 
-    Character& currentChar = screenLines[cuY][cuX];
-
-    currentChar.character = c;
-    currentChar.foregroundColor = effectiveForeground;
-    currentChar.backgroundColor = effectiveBackground;
-    currentChar.rendition = effectiveRendition;
+    (*screenLines[cuY])[cuX] = CompactCharacter(c, effectiveStyle);
+    touchLine(cuY);
 
     int i = 0;
     int newCursorX = cuX + w--;
@@ -670,20 +757,107 @@ void Screen::displayCharacter(unsigned short c)
     {
         i++;
 
-        if ( screenLines[cuY].size() < cuX + i + 1 )
-            screenLines[cuY].resize(cuX+i+1);
+        if ( screenLines[cuY]->size() < cuX + i + 1 )
+            screenLines[cuY]->resize(cuX+i+1);
 
-        Character& ch = screenLines[cuY][cuX + i];
-        ch.character = 0;
-        ch.foregroundColor = effectiveForeground;
-        ch.backgroundColor = effectiveBackground;
-        ch.rendition = effectiveRendition;
+        (*screenLines[cuY])[cuX + i] = CompactCharacter(0, effectiveStyle);
 
         w--;
     }
     cuX = newCursorX;
 }
 
+// Returns the number of cells occupied by 'c'.  Printable ASCII is by far
+// the most common input, so it does not need to go through the wcwidth tables.
+static inline int characterWidth(ushort c)
+{
+    if (c >= 0x20 && c < 0x7f)
+        return 1;
+    return konsole_wcwidth(c);
+}
+
+void Screen::displayCharacters(const ushort* chars, int count)
+{
+    // Insert mode shifts the rest of the line for every character,
+    // leave that rare case to displayCharacter()
+    if (getMode(MODE_Insert))
+    {
+        for (int i = 0; i < count; i++)
+            displayCharacter(chars[i]);
+        return;
+    }
+
+    int i = 0;
+    while (i < count)
+    {
+        int w = characterWidth(chars[i]);
+        if (w <= 0)
+        {
+            i++;
+            continue;
+        }
+
+        // Same wrapping rules as in displayCharacter(), applied once
+        // for each line segment.
+        if (cuX+w > columns) {
+            if (getMode(MODE_Wrap)) {
+                lineProperties[cuY] = (LineProperty)(lineProperties[cuY] | LINE_WRAPPED);
+                nextLine();
+            }
+            else
+                cuX = columns-w;
+        }
+
+        // Collect the characters which fit onto the current line. The
+        // first one is always taken, even if it is wider than the screen.
+        int end = i + 1;
+        int lastX = cuX;
+        int endX = cuX + w;
+        while (end < count)
+        {
+            const int cw = characterWidth(chars[end]);
+            if (cw > 0)
+            {
+                if (endX + cw > columns)
+                    break;
+                lastX = endX;
+                endX += cw;
+            }
+            end++;
+        }
+
+        ImageLine& line = *screenLines[cuY];
+        if (line.size() < endX)
+            line.resize(endX);
+
+        lastPos = loc(lastX,cuY);
+
+        // check if selection is still valid.
+        checkSelection(loc(cuX,cuY), lastPos);
+
+        touchLine(cuY);
+
+        CompactCharacter* data = line.data();
+        int x = cuX;
+        for (int j = i; j < end; j++)
+        {
+            int cw = characterWidth(chars[j]);
+            if (cw <= 0)
+                continue;
+
+            data[x] = CompactCharacter(chars[j], effectiveStyle);
+
+            // wide characters are followed by placeholder cells
+            for (int k = 1; k < cw; k++)
+                data[x + k] = CompactCharacter(0, effectiveStyle);
+            x += cw;
+        }
+
+        cuX = endX;
+        i = end;
+    }
+}
+
 void Screen::compose(QString /*compose*/)
 {
     Q_ASSERT( 0 /*Not implemented yet*/ );
@@ -709,6 +883,11 @@ void Screen::resetDroppedLines()
 {
     _droppedLines = 0;
 }
+quint64 Screen::removedHistoryLines() const
+{
+    // setScroll() counts the lines of a new history as added
+    return _addedHistoryLines - history->getLines();
+}
 void Screen::resetScrolledLines()
 {
     _scrolledLines = 0;
@@ -813,20 +992,23 @@ void Screen::clearImage(int loca, int loce, char c)
     int topLine = loca/columns;
     int bottomLine = loce/columns;
 
-    Character clearCh(c,currentForeground,currentBackground,DEFAULT_RENDITION);
+    CompactCharacter clearCh(c,_styles.indexOf(CharacterStyle(DEFAULT_RENDITION,
+                                                                currentForeground,
+                                                                currentBackground)));
 
     //if the character being used to clear the area is the same as the
     //default character, the affected lines can simply be shrunk.
-    bool isDefaultCh = (clearCh == Character());
+    bool isDefaultCh = (clearCh == CompactCharacter());
 
     for (int y=topLine;y<=bottomLine;y++)
     {
         lineProperties[y] = 0;
+        touchLine(y);
 
         int endCol = ( y == bottomLine) ? loce%columns : columns-1;
         int startCol = ( y == topLine ) ? loca%columns : 0;
 
-        QVector<Character>& line = screenLines[y];
+        ImageLine& line = *screenLines[y];
 
         if ( isDefaultCh && endCol == columns-1 )
         {
@@ -837,7 +1019,7 @@ void Screen::clearImage(int loca, int loce, char c)
             if (line.size() < endCol + 1)
                 line.resize(endCol+1);
 
-            Character* data = line.data();
+            CompactCharacter* data = line.data();
             for (int i=startCol;i<=endCol;i++)
                 data[i]=clearCh;
         }
@@ -851,26 +1033,21 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
     int lines=(sourceEnd-sourceBegin)/columns;
 
     //move screen image and line properties:
-    //the source and destination areas of the image may overlap,
-    //so it matters that we do the copy in the right order -
-    //forwards if dest < sourceBegin or backwards otherwise.
-    //(search the web for 'memmove implementation' for details)
-    if (dest < sourceBegin)
-    {
-        for (int i=0;i<=lines;i++)
-        {
-            screenLines[ (dest/columns)+i ] = screenLines[ (sourceBegin/columns)+i ];
-            lineProperties[(dest/columns)+i]=lineProperties[(sourceBegin/columns)+i];
-        }
-    }
-    else
-    {
-        for (int i=lines;i>=0;i--)
-        {
-            screenLines[ (dest/columns)+i ] = screenLines[ (sourceBegin/columns)+i ];
-            lineProperties[(dest/columns)+i]=lineProperties[(sourceBegin/columns)+i];
-        }
-    }
+    //the lines are not copied, the lines covered by the source and the
+    //destination are rotated instead.  the lines which are vacated by the
+    //move therefore hold the buffers of the overwritten lines, which the
+    //caller clears and so reuses.
+    int first = qMin(dest,sourceBegin)/columns;
+    int last = qMax(dest,sourceBegin)/columns + lines;
+    int shift = (sourceBegin-dest)/columns;
+    if (shift < 0)
+        shift += last - first + 1;
+
+    std::rotate(screenLines + first, screenLines + first + shift, screenLines + last + 1);
+    std::rotate(lineProperties.data() + first, lineProperties.data() + first + shift,
+                lineProperties.data() + last + 1);
+    std::rotate(lineGenerations.data() + first, lineGenerations.data() + first + shift,
+                lineGenerations.data() + last + 1);
 
     if (lastPos != -1)
     {
@@ -883,6 +1060,9 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
     // Adjust selection to follow scroll.
     if (selBegin != -1)
     {
+        // the selection may now cover lines which were not moved
+        _selectionGeneration++;
+
         bool beginIsTL = (selBegin == selTopLeft);
         int diff = dest - sourceBegin; // Scroll by this amount
         int scr_TL=loc(0,history->getLines());
@@ -1005,6 +1185,9 @@ void Screen::setBackColor(int space, int color)
 
 void Screen::clearSelection() 
 {
+    if (selBegin != -1 || selTopLeft != -1)
+        _selectionGeneration++;
+
     selBottomRight = -1;
     selTopLeft = -1;
     selBegin = -1;
@@ -1045,6 +1228,7 @@ void Screen::setSelectionStart(const int x, const int y, const bool mode)
     selBottomRight = selBegin;
     selTopLeft = selBegin;
     blockSelectionMode = mode;
+    _selectionGeneration++;
 }
 
 void Screen::setSelectionEnd( const int x, const int y)
@@ -1080,6 +1264,8 @@ void Screen::setSelectionEnd( const int x, const int y)
         selTopLeft = loc(qMin(topColumn,bottomColumn),topRow);
         selBottomRight = loc(qMax(topColumn,bottomColumn),bottomRow);
     }
+
+    _selectionGeneration++;
 }
 
 bool Screen::isSelected( const int x,const int y) const
@@ -1133,6 +1319,13 @@ void Screen::writeToStream(TerminalCharacterDecoder* decoder,
 
     Q_ASSERT( top >= 0 && left >= 0 && bottom >= 0 && right >= 0 );
 
+    // lines from the history are decoded a batch at a time
+    const int historyLines = history->getLines();
+    QVector<Character> historyCells;
+    int batchStart = 0;
+    int batchCount = 0;
+    int batchStride = 0;
+
     for (int y=top;y<=bottom;y++)
     {
         int start = 0;
@@ -1141,10 +1334,28 @@ void Screen::writeToStream(TerminalCharacterDecoder* decoder,
         int count = -1;
         if ( y == bottom || blockSelectionMode ) count = right - start + 1;
 
+        const Character* historyLine = 0;
+        if ( y < historyLines )
+        {
+            if ( y >= batchStart + batchCount )
+            {
+                batchStart = y;
+                batchCount = qMin(HISTORY_BATCH_LINES, qMin(bottom,historyLines-1) - y + 1);
+                batchStride = 0;
+                for (int i = 0; i < batchCount; i++)
+                    batchStride = qMax(batchStride, history->getLineLen(y+i));
+
+                historyCells.resize(batchCount*batchStride);
+                history->getCellsOfLines(batchStart,batchCount,batchStride,historyCells.data());
+            }
+            historyLine = historyCells.constData() + (y-batchStart)*batchStride;
+        }
+
         const bool appendNewLine = ( y != bottom );
         int copied = copyLineToStream( y,
                                        start,
                                        count,
+                                       historyLine,
                                        decoder,
                                        appendNewLine,
                                        preserveLineBreaks );
@@ -1166,6 +1377,7 @@ void Screen::writeToStream(TerminalCharacterDecoder* decoder,
 int Screen::copyLineToStream(int line , 
                              int start,
                              int count,
+                             const Character* historyLine,
                              TerminalCharacterDecoder* decoder,
                              bool appendNewLine,
                              bool preserveLineBreaks) const
@@ -1206,7 +1418,7 @@ int Screen::copyLineToStream(int line ,
         assert( count >= 0 );
         assert( (start+count) <= history->getLineLen(line) );
 
-        history->getCells(line,start,count,characterBuffer);
+        std::copy(historyLine+start, historyLine+start+count, characterBuffer);
 
         if ( history->isWrappedLine(line) )
             currentLineProperties |= LINE_WRAPPED;
@@ -1220,13 +1432,13 @@ int Screen::copyLineToStream(int line ,
 
         const int screenLine = line-history->getLines();
 
-        Character* data = screenLines[screenLine].data();
-        int length = screenLines[screenLine].count();
+        const CompactCharacter* data = screenLines[screenLine]->constData();
+        int length = screenLines[screenLine]->count();
 
         //retrieve line from screen image
         for (int i=start;i < qMin(start+count,length);i++)
         {
-            characterBuffer[i-start] = data[i];
+            characterBuffer[i-start] = _styles.toCharacter(data[i]);
         }
 
         // count cannot be any greater than length
@@ -1258,6 +1470,102 @@ void Screen::writeLinesToStream(TerminalCharacterDecoder* decoder, int fromLine,
     writeToStream(decoder,loc(0,fromLine),loc(columns-1,toLine));
 }
 
+void Screen::findText(const LiteralMatcher& matcher, int fromLine, int toLine,
+                      QVector<LiteralMatch>& matches) const
+{
+    const int historyLines = history->getLines();
+    const int length = matcher.length();
+    QVarLengthArray<CompactCharacter,1024> buffer;
+
+    // the last cells of the wrapped lines before the current one which a
+    // match may start in, and where they are
+    QVarLengthArray<CompactCharacter,64> tail;
+    QVarLengthArray<QPoint,64> tailPositions;
+    QVarLengthArray<CompactCharacter,128> joined;
+
+    for (int line = fromLine; line <= toLine; line++)
+    {
+        const CompactCharacter* cells;
+        int count;
+        bool wrapped;
+        if (line < historyLines)
+        {
+            count = history->getLineLen(line);
+            buffer.resize(count);
+            cells = history->getCharacterCells(line, buffer.data());
+            wrapped = history->isWrappedLine(line);
+        }
+        else
+        {
+            const int screenLine = line - historyLines;
+            cells = screenLines[screenLine]->constData();
+            count = screenLines[screenLine]->count();
+            wrapped = lineProperties[screenLine] & LINE_WRAPPED;
+        }
+
+        // matches which start on the lines before and end on this one
+        int from = 0;
+        if (!tail.isEmpty())
+        {
+            const int head = qMin(count, length - 1);
+            joined.resize(tail.size() + head);
+            std::copy(tail.constData(), tail.constData() + tail.size(), joined.data());
+            std::copy(cells, cells + head, joined.data() + tail.size());
+
+            int at = matcher.indexIn(joined.constData(), joined.size(), 0);
+            while (at >= 0 && at < tail.size())
+            {
+                const int end = at + length - 1 - tail.size();
+                if (end >= 0)
+                {
+                    LiteralMatch match = { tailPositions[at].y(), tailPositions[at].x(), line, end };
+                    matches.append(match);
+                    from = end + 1;
+                    at = matcher.indexIn(joined.constData(), joined.size(), at + length);
+                }
+                else
+                {
+                    at = matcher.indexIn(joined.constData(), joined.size(), at + 1);
+                }
+            }
+        }
+
+        for (int at = matcher.indexIn(cells, count, from); at >= 0;
+             at = matcher.indexIn(cells, count, at + length))
+        {
+            LiteralMatch match = { line, at, line, at + length - 1 };
+            matches.append(match);
+            from = at + length;
+        }
+
+        // keep the cells at the end of a wrapped line which a match may
+        // start in, those after the last match
+        if (!wrapped || length == 1)
+        {
+            tail.clear();
+            tailPositions.clear();
+            continue;
+        }
+
+        if (from > 0)
+        {
+            tail.clear();
+            tailPositions.clear();
+        }
+        for (int x = qMax(from, count - (length - 1)); x < count; x++)
+        {
+            tail.append(cells[x]);
+            tailPositions.append(QPoint(x, line));
+        }
+        if (tail.size() > length - 1)
+        {
+            const int drop = tail.size() - (length - 1);
+            tail.erase(tail.begin(), tail.begin() + drop);
+            tailPositions.erase(tailPositions.begin(), tailPositions.begin() + drop);
+        }
+    }
+}
+
 void Screen::addHistLine()
 {
     // add line to history buffer
@@ -1267,8 +1575,16 @@ void Screen::addHistLine()
     {
         int oldHistLines = history->getLines();
 
-        history->addCellsVector(screenLines[0]);
+        const ImageLine& line = *screenLines[0];
+        history->addCompactCells(line.constData(), line.size(), _styles);
         history->addLine( lineProperties[0] & LINE_WRAPPED );
+        _addedHistoryLines++;
+
+        if (_historyIndex)
+        {
+            _historyIndex->addLine(line.constData(), line.size(), lineProperties[0] & LINE_WRAPPED);
+            _historyIndex->removeLinesBefore(removedHistoryLines());
+        }
 
         int newHistLines = history->getLines();
 
@@ -1291,6 +1607,8 @@ void Screen::addHistLine()
 
         if (selBegin != -1)
         {
+            _selectionGeneration++;
+
             // Scroll selection in history up
             int top_BR = loc(0, 1+newHistLines);
 
@@ -1334,6 +1652,14 @@ void Screen::setScroll(const HistoryType& t , bool copyPreviousScroll)
         history = t.scroll(0);
         delete oldScroll;
     }
+
+    // the lines of the new history get generations which have not been
+    // handed out before
+    _addedHistoryLines += history->getLines();
+
+    // the lines of the new history are not in the index
+    if (_historyIndex)
+        _historyIndex->reset(_addedHistoryLines);
 }
 
 bool Screen::hasScroll() const
@@ -1341,6 +1667,24 @@ bool Screen::hasScroll() const
     return history->hasScroll();
 }
 
+void Screen::setHistoryIndexMemoryLimit(size_t bytes)
+{
+    if (bytes == 0)
+    {
+        delete _historyIndex;
+        _historyIndex = 0;
+    }
+    else if (_historyIndex)
+        _historyIndex->setMemoryLimit(bytes);
+    else
+        _historyIndex = new HistoryIndex(bytes, _addedHistoryLines);
+}
+
+const HistoryIndex* Screen::historyIndex() const
+{
+    return _historyIndex;
+}
+
 const HistoryType& Screen::getScroll() const
 {
     return history->getType();
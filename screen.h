@@ -31,7 +31,10 @@
 
 // Own includes
 #include "character.h"
+#include "characterstyle.h"
 #include "history.h"
+#include "historyindex.h"
+#include "literalmatcher.h"
 #define MODE_Origin    0
 #define MODE_Wrap      1
 #define MODE_Insert    2
@@ -343,7 +346,18 @@ public:
      * character already at the current cursor position.
      */
     void displayCharacter(unsigned short c);
-    
+
+    /**
+     * Displays a run of @p count characters starting at the current cursor
+     * position.  The result is the same as calling displayCharacter() for each
+     * character in @p chars, but wrapping, the line size and the selection are
+     * dealt with once per line segment instead of once per character.
+     *
+     * The characters must already have been translated by the emulation's
+     * character set and must not contain control characters.
+     */
+    void displayCharacters(const ushort* chars, int count);
+
     // Do composition with last shown character FIXME: Not implemented yet for KDE 4
     void compose(QString compose);
     
@@ -378,6 +392,25 @@ public:
      * other attributes control the size of characters in the line.
      */
     QVector<LineProperty> getLineProperties( int startLine , int endLine ) const;
+
+    /**
+     * Returns the generation of @p line, where 0 is the first line in the
+     * history.  The generation changes whenever the characters on the line
+     * change, lines which are moved by scrolling keep their generation.
+     * Two lines with the same generation have the same characters, so
+     * views can use it to copy and repaint only the lines which changed.
+     *
+     * The selection, the cursor and the MODE_Screen inversion which
+     * getImage() applies on top of the characters are not included.
+     * See selectionGeneration().
+     */
+    quint64 lineGeneration(int line) const;
+
+    /**
+     * Returns a counter which changes whenever the selection changes in a
+     * way which may change the appearance of lines in getImage().
+     */
+    quint64 selectionGeneration() const;
     
 
     /** Return the number of lines. */
@@ -402,6 +435,14 @@ public:
      */
     bool hasScroll() const;
 
+    /**
+     * Keeps an index of the lines added to the history, which takes up to
+     * @p bytes of memory, see HistoryIndex.  0 removes the index.
+     */
+    void setHistoryIndexMemoryLimit(size_t bytes);
+    /** Returns the index of the lines of the history, or 0 if there is none */
+    const HistoryIndex* historyIndex() const;
+
     /**
      * Sets the start of the selection.
      *
@@ -456,6 +497,16 @@ public:
      */
     void writeLinesToStream(TerminalCharacterDecoder* decoder, int fromLine, int toLine) const;
 
+    /**
+     * Finds the text of @p matcher in the lines from @p fromLine to @p toLine,
+     * looking at the characters where the history and the screen keep them,
+     * and appends the matches to @p matches in order.  Matches do not overlap,
+     * they may continue from a wrapped line on the next one but not after
+     * @p toLine.
+     */
+    void findText(const LiteralMatcher& matcher, int fromLine, int toLine,
+                  QVector<LiteralMatch>& matches) const;
+
     /**
      * Copies the selected characters, set using @see setSelBeginXY and @see setSelExtentXY
      * into a stream.
@@ -540,6 +591,15 @@ public:
      */
     void resetDroppedLines();
 
+    /**
+     * Returns the number of lines which have been removed from the start of
+     * the history since the screen was created, including lines removed by
+     * clearing the history or changing its type.  Adding this to the number
+     * of a line gives a number which stays the same while the line moves up
+     * through the history.
+     */
+    quint64 removedHistoryLines() const;
+
     /**
       * Fills the buffer @p dest with @p count instances of the default (ie. blank)
       * Character style.
@@ -557,12 +617,14 @@ private:
       *          history->getLines() + lines - 1
       * start - the first column on the line to copy
       * count - the number of characters on the line to copy
+      * historyLine - the characters of the line if it is in the history, otherwise unused
       * decoder - a decoder which converts terminal characters (an Character array) into text
       * appendNewLine - if true a new line character (\n) is appended to the end of the line
       */
     int  copyLineToStream(int line,
                           int start,
                           int count,
+                          const Character* historyLine,
                           TerminalCharacterDecoder* decoder,
                           bool appendNewLine,
                           bool preserveLineBreaks) const;
@@ -579,7 +641,9 @@ private:
       * the parameters are specified as offsets from the start of the screen image.
       * the loc(x,y) macro can be used to generate these values from a column,line pair.
       *
-      * NOTE: moveImage() can only move whole lines
+      * NOTE: moveImage() can only move whole lines.  The lines are rotated
+      * rather than copied, so the vacated lines hold the buffers of the lines
+      * which were overwritten.
       */
     void moveImage(int dest, int sourceBegin, int sourceEnd);
 
@@ -591,10 +655,15 @@ private:
 
     void addHistLine();
 
+    /** gives screen line 'y' a new generation, see lineGeneration() */
+    void touchLine(int y);
+
     void initTabStops();
 
     void updateEffectiveRendition();
     void reverseRendition(Character& p) const;
+    // removes the styles no character on the screen uses from _styles
+    void compactStyles();
 
     bool isSelectionValid() const;
 
@@ -622,8 +691,11 @@ private:
     int lines;
     int columns;
 
-    typedef QVector<Character> ImageLine;      // [0..columns]
-    ImageLine*          screenLines;    // [lines]
+    typedef QVector<CompactCharacter> ImageLine;      // [0..columns]
+    ImageLine**         screenLines;    // [lines], rotated when scrolling
+
+    // styles of the characters in screenLines
+    CharacterStyleTable _styles;
 
     int _scrolledLines;
     QRect _lastScrolledRegion;
@@ -631,9 +703,17 @@ private:
     int _droppedLines;
 
     QVarLengthArray<LineProperty,64> lineProperties;
+
+    // generations of the lines in screenLines, rotated along with them
+    QVarLengthArray<quint64,64> lineGenerations;
+    quint64 _generation;           // last generation handed out
+    quint64 _addedHistoryLines;    // lines added to the history so far
+    quint64 _selectionGeneration;
     
     // history buffer ---------------
     HistoryScroll* history;
+    // index of the lines added to the history, if enabled
+    HistoryIndex* _historyIndex;
     
     // cursor location
     int cuX;
@@ -666,6 +746,7 @@ private:
     CharacterColor effectiveForeground; // These are derived from
     CharacterColor effectiveBackground; // the cu_* variables above
     quint8 effectiveRendition;          // to speed up operation
+    quint32 effectiveStyle;             // index of the above in _styles
 
     class SavedState
     {
@@ -31,15 +31,26 @@
 // Qt includes
 #include <QtDebug>
 
+// Generation of lines which need to be copied from the screen again
+static const quint64 INVALID_LINE_GENERATION = 0;
+// Generation of lines beyond the end of the screen, which are left blank
+static const quint64 UNUSED_LINE_GENERATION = ~Q_UINT64_C(0);
+
 ScreenWindow::ScreenWindow(QObject* parent)
     : QObject(parent)
+    , _screen(0)
     , _windowBuffer(0)
     , _windowBufferSize(0)
     , _bufferNeedsUpdate(true)
+    , _lastVersion(0)
+    , _selectionGeneration(0)
+    , _cursorVisible(false)
+    , _screenReversed(false)
     , _windowLines(1)
     , _currentLine(0)
     , _trackOutput(true)
     , _scrollCount(0)
+    , _fastForwarding(false)
 {
 }
 ScreenWindow::~ScreenWindow()
@@ -50,7 +61,12 @@ void ScreenWindow::setScreen(Screen* screen)
 {
     Q_ASSERT( screen );
 
+    // generations of different screens can not be compared
+    if (screen != _screen)
+        invalidateLines();
+
     _screen = screen;
+    _bufferNeedsUpdate = true;
 }
 
 Screen* ScreenWindow::screen() const
@@ -62,19 +78,66 @@ Character* ScreenWindow::getImage()
 {
     // reallocate internal buffer if the window size has changed
     int size = windowLines() * windowColumns();
-    if (_windowBuffer == 0 || _windowBufferSize != size)
+    if (_windowBuffer == 0 || _windowBufferSize != size ||
+        _lineGenerations.count() != windowLines())
     {
         delete[] _windowBuffer;
         _windowBufferSize = size;
         _windowBuffer = new Character[size];
+        _lineGenerations.resize(windowLines());
+        _lineVersions.resize(windowLines());
+        invalidateLines();
         _bufferNeedsUpdate = true;
     }
 
     if (!_bufferNeedsUpdate)
         return _windowBuffer;
 
-    _screen->getImage(_windowBuffer,size,
-                      currentLine(),endWindowLine());
+    // the selection and the screen modes are applied on top of the
+    // characters, when they change every line needs to be copied again
+    const bool cursorVisible = _screen->getMode(MODE_Cursor);
+    const bool screenReversed = _screen->getMode(MODE_Screen);
+    if (_selectionGeneration != _screen->selectionGeneration() ||
+        _cursorVisible != cursorVisible ||
+        _screenReversed != screenReversed)
+    {
+        invalidateLines();
+        _selectionGeneration = _screen->selectionGeneration();
+        _cursorVisible = cursorVisible;
+        _screenReversed = screenReversed;
+    }
+
+    // when the cursor moves, the lines it moves from and to are copied again
+    const QPoint cursor(_screen->getCursorX(),
+                        _screen->getHistLines() + _screen->getCursorY() - currentLine());
+    if (cursor != _cursorPosition)
+    {
+        if (_cursorPosition.y() >= 0 && _cursorPosition.y() < windowLines())
+            _lineGenerations[_cursorPosition.y()] = INVALID_LINE_GENERATION;
+        if (cursor.y() >= 0 && cursor.y() < windowLines())
+            _lineGenerations[cursor.y()] = INVALID_LINE_GENERATION;
+        _cursorPosition = cursor;
+    }
+
+    // copy the runs of lines whose generation has changed
+    const int lastScreenLine = endWindowLine() - currentLine();
+    int line = 0;
+    while (line <= lastScreenLine)
+    {
+        if (_lineGenerations[line] == _screen->lineGeneration(currentLine() + line))
+        {
+            line++;
+            continue;
+        }
+
+        int lastLine = line;
+        while (lastLine < lastScreenLine &&
+               _lineGenerations[lastLine+1] != _screen->lineGeneration(currentLine() + lastLine + 1))
+            lastLine++;
+
+        updateLines(line, lastLine);
+        line = lastLine + 1;
+    }
 
     // this window may look beyond the end of the screen, in which
     // case there will be an unused area which needs to be filled
@@ -85,15 +148,48 @@ Character* ScreenWindow::getImage()
     return _windowBuffer;
 }
 
+const QVector<quint64>& ScreenWindow::lineVersions() const
+{
+    return _lineVersions;
+}
+
+void ScreenWindow::updateLines(int firstLine, int lastLine)
+{
+    const int columns = windowColumns();
+
+    _screen->getImage(_windowBuffer + firstLine * columns,
+                      (lastLine - firstLine + 1) * columns,
+                      currentLine() + firstLine,
+                      currentLine() + lastLine);
+
+    for (int line = firstLine; line <= lastLine; line++)
+    {
+        _lineGenerations[line] = _screen->lineGeneration(currentLine() + line);
+        _lineVersions[line] = ++_lastVersion;
+    }
+}
+
+void ScreenWindow::invalidateLines()
+{
+    _lineGenerations.fill(INVALID_LINE_GENERATION);
+}
+
 void ScreenWindow::fillUnusedArea()
 {
     int screenEndLine = _screen->getHistLines() + _screen->getLines() - 1;
     int windowEndLine = currentLine() + windowLines() - 1;
 
     int unusedLines = windowEndLine - screenEndLine;
-    int charsToFill = unusedLines * windowColumns();
 
-    Screen::fillWithDefaultChar(_windowBuffer + _windowBufferSize - charsToFill,charsToFill);
+    for (int line = windowLines() - unusedLines; line < windowLines(); line++)
+    {
+        if (_lineGenerations[line] == UNUSED_LINE_GENERATION)
+            continue;
+
+        Screen::fillWithDefaultChar(_windowBuffer + line * windowColumns(), windowColumns());
+        _lineGenerations[line] = UNUSED_LINE_GENERATION;
+        _lineVersions[line] = ++_lastVersion;
+    }
 }
 
 // return the index of the line at the end of this window, or if this window 
@@ -294,4 +390,14 @@ void ScreenWindow::notifyOutputChanged()
     emit outputChanged();
 }
 
+void ScreenWindow::setFastForwarding(bool fastForwarding)
+{
+    _fastForwarding = fastForwarding;
+}
+
+bool ScreenWindow::isFastForwarding() const
+{
+    return _fastForwarding;
+}
+
 //#include "ScreenWindow.moc"
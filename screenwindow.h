@@ -34,6 +34,7 @@ class Screen;
 #include <QObject>
 #include <QPoint>
 #include <QRect>
+#include <QVector>
 
 /**
  * Provides a window onto a section of a terminal screen.  A terminal widget can then render
@@ -80,9 +81,19 @@ public:
      *
      * The returned buffer is managed by the ScreenWindow instance and does not need to be
      * deleted by the caller.
+     *
+     * Only the lines whose contents changed since the previous call are copied
+     * from the screen, see lineVersions().
      */
     Character* getImage();
 
+    /**
+     * Returns a version number for each line of the image returned by getImage().
+     * The version of a line changes whenever the line is copied from the screen
+     * again, so views can skip lines whose version they have already seen.
+     */
+    const QVector<quint64>& lineVersions() const;
+
     /**
      * Returns the line attributes associated with the lines of characters which
      * are currently visible through this window
@@ -217,6 +228,13 @@ public:
      */
     QString selectedText( bool preserveLineBreaks ) const;
 
+    /**
+     * Returns true while the emulation skips through a burst of output.
+     * Views should avoid expensive work which is redone on every update
+     * until the burst is over.  See TerminalEmulation::isFastForwarding()
+     */
+    bool isFastForwarding() const;
+
 public slots:
     /**
      * Notifies the window that the contents of the associated terminal screen have changed.
@@ -225,6 +243,9 @@ public slots:
      */
     void notifyOutputChanged();
 
+    /** Sets whether the emulation is skipping through a burst of output. */
+    void setFastForwarding(bool fastForwarding);
+
 signals:
     /**
      * Emitted when the contents of the associated terminal screen (see screen()) changes.
@@ -244,14 +265,27 @@ signals:
 private:
     int endWindowLine() const;
     void fillUnusedArea();
+    void updateLines(int firstLine, int lastLine);
+    void invalidateLines();
 
     Screen* _screen;
     Character* _windowBuffer;
     int _windowBufferSize;
     bool _bufferNeedsUpdate;
 
+    // the screen line generations of the lines in _windowBuffer and the
+    // state applied on top of them when they were copied
+    QVector<quint64> _lineGenerations;
+    QVector<quint64> _lineVersions;
+    quint64 _lastVersion;
+    quint64 _selectionGeneration;
+    QPoint _cursorPosition;
+    bool _cursorVisible;
+    bool _screenReversed;
+
     int  _windowLines;
     int  _currentLine;
     bool _trackOutput;
     int  _scrollCount;
+    bool _fastForwarding;
 };
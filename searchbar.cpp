@@ -32,6 +32,8 @@
 #include <QAction>
 #include <QRegExp>
 #include <QDebug>
+#include <QHideEvent>
+#include <QShowEvent>
 
 SearchBar::SearchBar(QWidget *parent) : QWidget(parent)
 {
@@ -100,6 +102,19 @@ void SearchBar::noMatchFound()
 }
 
 
+void SearchBar::setMatchCount(int count, bool complete)
+{
+    if (complete)
+        widget.matchCountLabel->setText(tr("%n match(es)", 0, count));
+    else
+        widget.matchCountLabel->setText(tr("%n match(es) so far", 0, count));
+}
+
+void SearchBar::clearMatchCount()
+{
+    widget.matchCountLabel->clear();
+}
+
 void SearchBar::keyReleaseEvent(QKeyEvent* keyEvent)
 {
     if (keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter)
@@ -119,6 +134,20 @@ void SearchBar::keyReleaseEvent(QKeyEvent* keyEvent)
     }
 }
 
+void SearchBar::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    if (!event->spontaneous())
+        emit visibilityChanged(true);
+}
+
+void SearchBar::hideEvent(QHideEvent* event)
+{
+    QWidget::hideEvent(event);
+    if (!event->spontaneous())
+        emit visibilityChanged(false);
+}
+
 void SearchBar::clearBackgroundColor()
 {
     QPalette p;
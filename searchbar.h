@@ -46,15 +46,22 @@ public:
 
 public slots:
     void noMatchFound();
+    /** Shows the number of matches, @p complete is false while they are still counted */
+    void setMatchCount(int count, bool complete);
+    void clearMatchCount();
 
 signals:
     void searchCriteriaChanged();
     void highlightMatchesChanged(bool highlightMatches);
+    /** Emitted when the search bar is shown or hidden */
+    void visibilityChanged(bool visible);
     void findNext();
     void findPrevious();
 
 protected:
     virtual void keyReleaseEvent(QKeyEvent* keyEvent);
+    virtual void showEvent(QShowEvent* event);
+    virtual void hideEvent(QHideEvent* event);
 
 private slots:
     void clearBackgroundColor();
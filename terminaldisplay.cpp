@@ -30,7 +30,9 @@
 // Own includes
 #include "terminaldisplay.h"
 #include "filter.h"
+#include "historymatches.h"
 #include "konsole_wcwidth.h"
+#include "linecompare.h"
 #include "screenwindow.h"
 #include "terminalcharacterdecoder.h"
 
@@ -49,6 +51,7 @@
 #include <QPixmap>
 #include <QScrollBar>
 #include <QStyle>
+#include <QStyleOptionSlider>
 #include <QTimer>
 #include <QToolTip>
 #include <QtDebug>
@@ -158,6 +161,9 @@ void TerminalDisplay::setScreenWindow(ScreenWindow* window)
         connect( _screenWindow , SIGNAL(scrolled(int)) , this , SLOT(updateFilters()) );
         window->setWindowLines(_lines);
     }
+
+    // the versions of the lines are only meaningful for the window they came from
+    _lineVersions.fill(0);
 }
 
 const ColorEntry* TerminalDisplay::colorTable() const
@@ -384,7 +390,7 @@ TerminalDisplay::TerminalDisplay(QWidget *parent)
 
     // create scroll bar for scrolling output up and down
     // set the scroll bar's slider to occupy the whole area of the scroll bar initially
-    _scrollBar = new QScrollBar(this);
+    _scrollBar = new MarkerScrollBar(this);
     setScroll(0,0);
     _scrollBar->setCursor( Qt::ArrowCursor );
     connect(_scrollBar, SIGNAL(valueChanged(int)), this,
@@ -919,6 +925,25 @@ void TerminalDisplay::scrollImage(int lines , const QRect& screenWindowRegion)
 
     Q_ASSERT(scrollRect.isValid() && !scrollRect.isEmpty());
 
+    // the highlights of search matches move along with the lines
+    if (_searchMatchRanges.size() == _lines)
+    {
+        if (lines > 0)
+        {
+            for (int line = region.top(); line < region.top() + linesToMove; line++)
+                _searchMatchRanges[line] = _searchMatchRanges.at(line + lines);
+        }
+        else
+        {
+            for (int line = region.top() + linesToMove - 1; line >= region.top(); line--)
+                _searchMatchRanges[line - lines] = _searchMatchRanges.at(line);
+        }
+    }
+
+    // the scrolled lines no longer match their versions
+    for (int line = region.top(); line <= region.bottom() && line < _lineVersions.count(); line++)
+        _lineVersions[line] = 0;
+
     //scroll the display vertically to match internal _image
     scroll( 0 , _fontHeight * (-lines) , scrollRect );
 }
@@ -1000,6 +1025,7 @@ void TerminalDisplay::updateImage()
     }
 
     Character* const newimg = _screenWindow->getImage();
+    const QVector<quint64>& newVersions = _screenWindow->lineVersions();
     int lines = _screenWindow->windowLines();
     int columns = _screenWindow->windowColumns();
 
@@ -1008,22 +1034,19 @@ void TerminalDisplay::updateImage()
     Q_ASSERT( this->_usedLines <= this->_lines );
     Q_ASSERT( this->_usedColumns <= this->_columns );
 
-    int y,x,len;
+    int y,x;
 
     QPoint tL  = contentsRect().topLeft();
     int    tLx = tL.x();
     int    tLy = tL.y();
-    _hasBlinker = false;
-
-    CharacterColor cf;       // undefined
-    CharacterColor _clipboard;       // undefined
-    int cr  = -1;   // undefined
 
     const int linesToUpdate = qMin(this->_lines, qMax(0,lines  ));
     const int columnsToUpdate = qMin(this->_columns,qMax(0,columns));
 
-    QChar *disstrU = new QChar[columnsToUpdate];
-    char *dirtyMask = new char[columnsToUpdate+2];
+    // at most every other column starts a new range of changed columns
+    if (_dirtyRanges.size() < (columnsToUpdate + 1) / 2)
+        _dirtyRanges.resize((columnsToUpdate + 1) / 2);
+    ColumnRange* const dirtyRanges = _dirtyRanges.data();
     QRegion dirtyRegion;
 
     // debugging variable, this records the number of lines that are found to
@@ -1033,109 +1056,71 @@ void TerminalDisplay::updateImage()
 
     for (y = 0; y < linesToUpdate; ++y)
     {
+        //both the top and bottom halves of double height _lines must always be redrawn
+        //although both top and bottom halves contain the same characters, only
+        //the top one is actually
+        //drawn.
+        const bool doubleHeight = _lineProperties.count() > y &&
+                (_lineProperties[y] & LINE_DOUBLEHEIGHT);
+
+        // lines which the screen window did not copy again since the last
+        // update are the same as before, their characters need not be compared
+        if (!doubleHeight && newVersions[y] == _lineVersions[y])
+            continue;
+
         const Character*       currentLine = &_image[y*this->_columns];
         const Character* const newLine = &newimg[y*columns];
 
-        bool updateLine = false;
-
-        // The dirty mask indicates which characters need repainting. We also
-        // mark surrounding neighbours dirty, in case the character exceeds
-        // its cell boundaries
-        memset(dirtyMask, 0, columnsToUpdate+2);
+        const int rangeCount = compareLines(currentLine, newLine, columnsToUpdate, dirtyRanges);
 
-        for( x = 0 ; x < columnsToUpdate ; ++x)
-        {
-            if ( newLine[x] != currentLine[x] )
-            {
-                dirtyMask[x] = true;
-            }
-        }
+        bool updateLine = false;
+        bool blinkingLine = false;
 
         if (!_resizing) // not while _resizing, we're expecting a paintEvent
+        {
             for (x = 0; x < columnsToUpdate; ++x)
-            {
-                _hasBlinker |= (newLine[x].rendition & RE_BLINK);
-
-                // Start drawing if this character or the next one differs.
-                // We also take the next one into account to handle the situation
-                // where characters exceed their cell width.
-                if (dirtyMask[x])
-                {
-                    quint16 c = newLine[x+0].character;
-                    if ( !c )
-                        continue;
-                    int p = 0;
-                    disstrU[p++] = c; //fontMap(c);
-                    bool lineDraw = isLineChar(c);
-                    bool doubleWidth = (x+1 == columnsToUpdate) ? false : (newLine[x+1].character == 0);
-                    cr = newLine[x].rendition;
-                    _clipboard = newLine[x].backgroundColor;
-                    if (newLine[x].foregroundColor != cf) cf = newLine[x].foregroundColor;
-                    int lln = columnsToUpdate - x;
-                    for (len = 1; len < lln; ++len)
-                    {
-                        const Character& ch = newLine[x+len];
-
-                        if (!ch.character)
-                            continue; // Skip trailing part of multi-col chars.
-
-                        bool nextIsDoubleWidth = (x+len+1 == columnsToUpdate) ? false : (newLine[x+len+1].character == 0);
-
-                        if (  ch.foregroundColor != cf ||
-                              ch.backgroundColor != _clipboard ||
-                              ch.rendition != cr ||
-                              !dirtyMask[x+len] ||
-                              isLineChar(c) != lineDraw ||
-                              nextIsDoubleWidth != doubleWidth )
-                            break;
-
-                        disstrU[p++] = c; //fontMap(c);
-                    }
-
-                    QString unistr(disstrU, p);
-
-                    bool saveFixedFont = _fixedFont;
-                    if (lineDraw)
-                        _fixedFont = false;
-                    if (doubleWidth)
-                        _fixedFont = false;
-
-                    updateLine = true;
-
-                    _fixedFont = saveFixedFont;
-                    x += len - 1;
-                }
+                blinkingLine |= (newLine[x].rendition & RE_BLINK);
 
+            // add the span from the first to the last changed column to the
+            // region which needs to be repainted.  the neighbours are
+            // included, in case the characters exceed their cell boundaries
+            if (rangeCount > 0)
+            {
+                const int first = qMax(0, dirtyRanges[0].first - 1);
+                const int last = qMin(columnsToUpdate - 1, dirtyRanges[rangeCount-1].last + 1);
+
+                dirtyRegion |= QRect( _leftMargin+tLx+_fontWidth*first ,
+                                      _topMargin+tLy+_fontHeight*y ,
+                                      _fontWidth * (last - first + 1) ,
+                                      _fontHeight );
+                updateLine = true;
             }
+        }
 
-        //both the top and bottom halves of double height _lines must always be redrawn
-        //although both top and bottom halves contain the same characters, only
-        //the top one is actually
-        //drawn.
-        if (_lineProperties.count() > y)
-            updateLine |= (_lineProperties[y] & LINE_DOUBLEHEIGHT);
+        if (doubleHeight)
+        {
+            updateLine = true;
+            dirtyRegion |= QRect( _leftMargin+tLx ,
+                                  _topMargin+tLy+_fontHeight*y ,
+                                  _fontWidth * columnsToUpdate ,
+                                  _fontHeight );
+        }
 
-        // if the characters on the line are different in the old and the new _image
-        // then this line must be repainted.
         if (updateLine)
-        {
             dirtyLineCount++;
 
-            // add the area occupied by this line to the region which needs to be
-            // repainted
-            QRect dirtyRect = QRect( _leftMargin+tLx ,
-                                     _topMargin+tLy+_fontHeight*y ,
-                                     _fontWidth * columnsToUpdate ,
-                                     _fontHeight );
-
-            dirtyRegion |= dirtyRect;
-        }
-
         // replace the line of characters in the old _image with the
         // current line of the new _image
-        memcpy((void*)currentLine,(const void*)newLine,columnsToUpdate*sizeof(Character));
+        if (rangeCount > 0)
+            memcpy((void*)currentLine,(const void*)newLine,columnsToUpdate*sizeof(Character));
+        _lineVersions[y] = newVersions[y];
+        _blinkingLines.setBit(y, blinkingLine);
     }
 
+    _hasBlinker = false;
+    for (y = 0; y < linesToUpdate && !_hasBlinker; ++y)
+        _hasBlinker = _blinkingLines.testBit(y);
+
     // if the new _image is smaller than the previous _image, then ensure that the area
     // outside the new _image is cleared
     if ( linesToUpdate < _usedLines )
@@ -1161,11 +1146,12 @@ void TerminalDisplay::updateImage()
     // update the parts of the display which have changed
     update(dirtyRegion);
 
+    // highlights move with the window even if the matches stay the same
+    if (_searchMatches)
+        updateSearchMatchLines();
+
     if ( _hasBlinker && !_blinkTimer->isActive()) _blinkTimer->start( TEXT_BLINK_DELAY );
     if (!_hasBlinker && _blinkTimer->isActive()) { _blinkTimer->stop(); _blinking = false; }
-    delete[] dirtyMask;
-    delete[] disstrU;
-
 }
 
 void TerminalDisplay::showResizeNotification()
@@ -1268,6 +1254,7 @@ void TerminalDisplay::paintEvent( QPaintEvent* pe )
         drawContents(paint, rect);
     }
     drawInputMethodPreeditString(paint,preeditRect());
+    paintSearchMatches(paint);
     paintFilters(paint);
 }
 
@@ -1428,6 +1415,111 @@ void TerminalDisplay::paintFilters(QPainter& painter)
         }
     }
 }
+
+void TerminalDisplay::setSearchMatches(HistoryMatches* matches)
+{
+    if (_searchMatches)
+        disconnect(_searchMatches, 0, this, 0);
+
+    _searchMatches = matches;
+    if (_searchMatches)
+        connect(_searchMatches, SIGNAL(matchesChanged()), this, SLOT(searchMatchesChanged()));
+
+    searchMatchesChanged();
+}
+
+void TerminalDisplay::searchMatchesChanged()
+{
+    updateSearchMarkers();
+    updateSearchMatchLines();
+}
+
+void TerminalDisplay::updateSearchMarkers()
+{
+    if (!_searchMatches || _scrollBar->isHidden())
+    {
+        _scrollBar->setMarkers(QBitArray());
+        return;
+    }
+
+    // one part of the lines per pixel of the scroll bar
+    _scrollBar->setMarkers(_searchMatches->linesWithMatches(_scrollBar->markerSpan()));
+}
+
+QVector<QVector<ColumnRange> > TerminalDisplay::searchMatchRanges() const
+{
+    QVector<QVector<ColumnRange> > ranges(_lines);
+    if (!_searchMatches || !_screenWindow)
+        return ranges;
+
+    // a match which starts above the window may continue into it
+    const int firstLine = _screenWindow->currentLine();
+    const int lastLine = firstLine + _lines - 1;
+    foreach (const HistorySearchMatch& match, _searchMatches->matches(firstLine - _lines, lastLine))
+    {
+        const int startLine = int(match.startLine) - firstLine;
+        const int endLine = int(match.endLine) - firstLine;
+        for (int line = qMax(0, startLine); line <= qMin(endLine, _lines - 1); line++)
+        {
+            ColumnRange range;
+            range.first = (line == startLine) ? match.startColumn : 0;
+            range.last = (line == endLine) ? match.endColumn : _columns - 1;
+            ranges[line].append(range);
+        }
+    }
+    return ranges;
+}
+
+static bool sameRanges(const QVector<ColumnRange>& a, const QVector<ColumnRange>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < a.size(); i++)
+    {
+        if (a.at(i).first != b.at(i).first || a.at(i).last != b.at(i).last)
+            return false;
+    }
+    return true;
+}
+
+void TerminalDisplay::updateSearchMatchLines()
+{
+    const QVector<QVector<ColumnRange> > ranges = searchMatchRanges();
+
+    // the lines whose text changed are repainted anyway, along with their
+    // highlights, so only lines whose matches changed are added here
+    QRegion dirtyRegion;
+    for (int line = 0; line < ranges.size(); line++)
+    {
+        const QVector<ColumnRange> oldRanges = line < _searchMatchRanges.size() ? _searchMatchRanges.at(line)
+                                                                                : QVector<ColumnRange>();
+        if (!sameRanges(oldRanges, ranges.at(line)))
+            dirtyRegion |= imageToWidget(QRect(0, line, _columns, 1));
+    }
+    _searchMatchRanges = ranges;
+
+    if (!dirtyRegion.isEmpty())
+        update(dirtyRegion);
+}
+
+void TerminalDisplay::paintSearchMatches(QPainter& painter)
+{
+    if (!_searchMatches || !_screenWindow)
+        return;
+
+    QColor color = palette().color(QPalette::Highlight);
+    color.setAlpha(SEARCH_MATCH_ALPHA);
+
+    // updateSearchMatchLines() keeps the ranges up to date with the matches
+    // and the window, so a repaint does not look up the matches again
+    const int lines = qMin(_searchMatchRanges.size(), _lines);
+    for (int line = 0; line < lines; line++)
+    {
+        foreach (const ColumnRange& range, _searchMatchRanges.at(line))
+            painter.fillRect(imageToWidget(QRect(range.first, line, range.last - range.first + 1, 1)), color);
+    }
+}
+
 void TerminalDisplay::drawContents(QPainter &paint, const QRect &rect)
 {
     QPoint tL  = contentsRect().topLeft();
@@ -1610,6 +1702,7 @@ void TerminalDisplay::resizeEvent(QResizeEvent*)
 {
     updateImageSize();
     processFilters();
+    updateSearchMarkers();
 }
 
 void TerminalDisplay::propagateSize()
@@ -1713,12 +1806,18 @@ void TerminalDisplay::setScroll(int cursor, int slines)
         return;
     }
 
+    const bool rangeChanged = _scrollBar->maximum() != (slines - _lines);
+
     disconnect(_scrollBar, SIGNAL(valueChanged(int)), this, SLOT(scrollBarPositionChanged(int)));
     _scrollBar->setRange(0,slines - _lines);
     _scrollBar->setSingleStep(1);
     _scrollBar->setPageStep(_lines);
     _scrollBar->setValue(cursor);
     connect(_scrollBar, SIGNAL(valueChanged(int)), this, SLOT(scrollBarPositionChanged(int)));
+
+    // the markers are spread over the lines, which changed in number
+    if (rangeChanged)
+        updateSearchMarkers();
 }
 
 void TerminalDisplay::scrollToEnd()
@@ -2247,6 +2346,17 @@ void TerminalDisplay::updateFilters()
     if ( !_screenWindow )
         return;
 
+    // scanning the whole screen on every update of a burst of output is
+    // wasted effort, the filters run again on the update after the burst
+    if ( _screenWindow->isFastForwarding() ) {
+        QRegion staleHotSpots = hotSpotRegion();
+        if ( !staleHotSpots.isEmpty() ) {
+            _filterChain->reset();
+            update( staleHotSpots );
+        }
+        return;
+    }
+
     processFilters();
 }
 
@@ -2834,6 +2944,9 @@ void TerminalDisplay::swapColorTable()
 
 void TerminalDisplay::clearImage()
 {
+    _lineVersions.fill(0, _lines);
+    _blinkingLines.fill(false, _lines);
+
     // We initialize _image[_imageSize] too. See makeImage()
     for (int i = 0; i <= _imageSize; i++)
     {
@@ -3116,4 +3229,54 @@ bool AutoScrollHandler::eventFilter(QObject* watched,QEvent* event)
     return false;
 }
 
+MarkerScrollBar::MarkerScrollBar(QWidget* parent)
+    : QScrollBar(parent)
+{
+}
+
+QRect MarkerScrollBar::grooveRect() const
+{
+    QStyleOptionSlider option;
+    initStyleOption(&option);
+    return style()->subControlRect(QStyle::CC_ScrollBar, &option, QStyle::SC_ScrollBarGroove, this);
+}
+
+int MarkerScrollBar::markerSpan() const
+{
+    return qMax(0, grooveRect().height());
+}
+
+void MarkerScrollBar::setMarkers(const QBitArray& markers)
+{
+    if (markers == _markers)
+        return;
+
+    _markers = markers;
+    update();
+}
+
+void MarkerScrollBar::paintEvent(QPaintEvent* event)
+{
+    QScrollBar::paintEvent(event);
+
+    const int count = _markers.size();
+    if (count == 0)
+        return;
+
+    // the markers are drawn over the slider, down the middle of the groove
+    const QRect groove = grooveRect();
+    const QRect strip = groove.adjusted(groove.width() / 4, 0, -groove.width() / 4, 0);
+    const int height = qMax(2, groove.height() / count);
+    const QColor color = palette().color(QPalette::Highlight);
+
+    QPainter painter(this);
+    for (int i = 0; i < count; i++)
+    {
+        if (!_markers.testBit(i))
+            continue;
+        const int top = strip.top() + int(qint64(i) * strip.height() / count);
+        painter.fillRect(QRect(strip.left(), top, strip.width(), height), color);
+    }
+}
+
 //#include "TerminalDisplay.moc"
@@ -30,11 +30,16 @@
 // Own includes
 #include "filter.h"
 #include "character.h"
+#include "linecompare.h"
 class ScreenWindow;
+class HistoryMatches;
+class MarkerScrollBar;
 
 // Qt
+#include <QBitArray>
 #include <QColor>
 #include <QPointer>
+#include <QScrollBar>
 #include <QWidget>
 class QDrag;
 class QDragEnterEvent;
@@ -162,6 +167,13 @@ public:
      */
     QList<QAction*> filterActions(const QPoint& position);
 
+    /**
+     * Highlights the matches kept by @p matches in the display and marks
+     * the lines with matches in the scroll bar, 0 for none.  The display
+     * follows the matches as they change.
+     */
+    void setSearchMatches(HistoryMatches* matches);
+
     /** Returns true if the cursor is set to blink or false otherwise. */
     bool blinkingCursor() { return _hasBlinkingCursor; }
     /** Specifies whether or not the cursor blinks. */
@@ -637,6 +649,7 @@ private slots:
 
     void swapColorTable();
     void tripleClickTimeout();  // resets possibleTripleClick
+    void searchMatchesChanged();
 
 private:
 
@@ -695,6 +708,13 @@ private:
     void makeImage();
     
     void paintFilters(QPainter& painter);
+    void paintSearchMatches(QPainter& painter);
+    void updateSearchMarkers();
+    // returns the columns of each line of the display which belong to a
+    // search match
+    QVector<QVector<ColumnRange> > searchMatchRanges() const;
+    // repaints the lines whose search matches differ from _searchMatchRanges
+    void updateSearchMatchLines();
 
     // returns a region covering all of the areas of the widget which contain
     // a hotspot
@@ -744,6 +764,14 @@ private:
     int _imageSize;
     QVector<LineProperty> _lineProperties;
 
+    // versions of the lines in _image, see ScreenWindow::lineVersions(),
+    // and which of them contain blinking characters
+    QVector<quint64> _lineVersions;
+    QBitArray _blinkingLines;
+
+    // changed columns of a line, see updateImage()
+    QVector<ColumnRange> _dirtyRanges;
+
     ColorEntry _colorTable[TABLE_COLORS];
     uint _randomSeed;
 
@@ -763,7 +791,7 @@ private:
     bool    _columnSelectionMode;
 
     QClipboard*  _clipboard;
-    QScrollBar* _scrollBar;
+    MarkerScrollBar* _scrollBar;
     ScrollBarPosition _scrollbarLocation;
     QString     _wordCharacters;
     int         _bellMode;
@@ -809,6 +837,12 @@ private:
     TerminalImageFilterChain* _filterChain;
     QRegion _mouseOverHotspotArea;
 
+    // the matches of the search to highlight, if any
+    QPointer<HistoryMatches> _searchMatches;
+    // the columns of each line which were highlighted as search matches
+    // when the lines were last updated
+    QVector<QVector<ColumnRange> > _searchMatchRanges;
+
     KeyboardCursorShape _cursorShape;
 
     // custom cursor color.  if this is invalid then the foreground
@@ -829,6 +863,8 @@ private:
 
     //the delay in milliseconds between redrawing blinking text
     static const int TEXT_BLINK_DELAY = 500;
+    //the opacity of the highlight color over search matches
+    static const int SEARCH_MATCH_ALPHA = 120;
     static const int DEFAULT_LEFT_MARGIN = 1;
     static const int DEFAULT_TOP_MARGIN = 1;
 
@@ -852,3 +888,32 @@ private:
     QWidget* widget() const { return static_cast<QWidget*>(parent()); }
     int _timerId;
 };
+
+/**
+ * The scroll bar of a TerminalDisplay, which marks parts of its range next
+ * to the slider, like the lines with search matches.
+ */
+class MarkerScrollBar : public QScrollBar
+{
+    Q_OBJECT
+
+public:
+    explicit MarkerScrollBar(QWidget* parent);
+
+    /** Returns the number of pixels the markers are spread over */
+    int markerSpan() const;
+
+    /**
+     * Marks the parts of the range whose bits are set in @p markers, which
+     * splits the range into parts of equal size
+     */
+    void setMarkers(const QBitArray& markers);
+
+protected:
+    virtual void paintEvent(QPaintEvent* event);
+
+private:
+    QRect grooveRect() const;
+
+    QBitArray _markers;
+};
@@ -54,15 +54,19 @@ TerminalEmulation::TerminalEmulation() :
     _codec(0),
     _decoder(0),
     _keyTranslator(0),
-    _usesMouse(false)
+    _usesMouse(false),
+    _fastForwarding(false),
+    _throughputBytes(0)
 {
     // create screens with a default size
     _screen[0] = new Screen(40,80);
     _screen[1] = new Screen(40,80);
     _currentScreen = _screen[0];
 
-    QObject::connect(&_bulkTimer1, SIGNAL(timeout()), this, SLOT(showBulk()) );
-    QObject::connect(&_bulkTimer2, SIGNAL(timeout()), this, SLOT(showBulk()) );
+    QObject::connect(&_frameScheduler, SIGNAL(frame()), this, SLOT(showBulk()) );
+
+    _fastForwardTimer.setSingleShot(true);
+    QObject::connect(&_fastForwardTimer, SIGNAL(timeout()), this, SLOT(endFastForward()) );
 
     // listen for mouse status changes
     connect( this , SIGNAL(programUsesMouseChanged(bool)) ,
@@ -90,6 +94,10 @@ ScreenWindow* TerminalEmulation::createWindow()
 
     connect(this , SIGNAL(outputChanged()),
             window , SLOT(notifyOutputChanged()) );
+
+    window->setFastForwarding(_fastForwarding);
+    connect(this , SIGNAL(fastForwardingChanged(bool)),
+            window , SLOT(setFastForwarding(bool)) );
     return window;
 }
 
@@ -116,6 +124,8 @@ void TerminalEmulation::setScreen(int n)
         // tell all windows onto this emulation to switch to the newly active screen
         foreach(ScreenWindow* window,_windows)
             window->setScreen(_currentScreen);
+
+        emit currentScreenChanged();
     }
 }
 
@@ -135,6 +145,17 @@ const HistoryType& TerminalEmulation::history() const
     return _screen[0]->getScroll();
 }
 
+void TerminalEmulation::setHistoryIndexMemoryLimit(size_t bytes)
+{
+    // the alternate screen has no history
+    _screen[0]->setHistoryIndexMemoryLimit(bytes);
+}
+
+const HistoryIndex* TerminalEmulation::historyIndex() const
+{
+    return _currentScreen->historyIndex();
+}
+
 void TerminalEmulation::setCodec(const QTextCodec * qtc)
 {
     if (qtc)
@@ -144,6 +165,7 @@ void TerminalEmulation::setCodec(const QTextCodec * qtc)
 
     delete _decoder;
     _decoder = _codec->makeDecoder();
+    _utf8Decoder.reset();
 
     emit useUtf8Request(utf8());
 }
@@ -187,10 +209,18 @@ void TerminalEmulation::receiveChar(int c)
     };
 }
 
+void TerminalEmulation::receiveChars(const ushort* chars, int count)
+{
+    for (int i = 0; i < count; i++)
+        receiveChar(chars[i]);
+}
+
 void TerminalEmulation::sendKeyEvent( QKeyEvent* ev )
 {
     emit stateSet(NOTIFYNORMAL);
 
+    notifyUserInput();
+
     if (!ev->text().isEmpty())
     { // A block of text
         // Note that the text is proper unicode.
@@ -218,17 +248,28 @@ void TerminalEmulation::receiveData(const char* text, int length)
 {
     emit stateSet(NOTIFYACTIVITY);
 
-    bufferedUpdate();
+    updateThroughput(length);
+    _frameScheduler.scheduleFrame(length);
+
+    if (utf8())
+    {
+        // the UTF-8 decoder looks for the z-modem indicator while decoding
+        const int count = _utf8Decoder.decode(text,length);
+
+        //send characters to terminal emulator
+        receiveChars(_utf8Decoder.buffer(), count);
+
+        for (int i=0;i<_utf8Decoder.zmodemMarkers();i++)
+            emit zmodemDetected();
+        return;
+    }
 
     QString unicodeText = _decoder->toUnicode(text,length);
 
     //send characters to terminal emulator
-    for (int i=0;i<unicodeText.length();i++)
-        receiveChar(unicodeText[i].unicode());
+    receiveChars(unicodeText.utf16(), unicodeText.length());
 
     //look for z-modem indicator
-    //-- someone who understands more about z-modems that I do may be able to move
-    //this check into the above for loop?
     for (int i=0;i<length;i++)
     {
         if (text[i] == '\030')
@@ -295,19 +336,36 @@ void TerminalEmulation::writeToStream( TerminalCharacterDecoder* _decoder ,
     _currentScreen->writeLinesToStream(_decoder,startLine,endLine);
 }
 
+void TerminalEmulation::findText(const LiteralMatcher& matcher, int startLine, int endLine,
+                                 QVector<LiteralMatch>& matches) const
+{
+    _currentScreen->findText(matcher, startLine, endLine, matches);
+}
+
 int TerminalEmulation::lineCount() const
 {
     // sum number of lines currently on _screen plus number of lines in history
     return _currentScreen->getLines() + _currentScreen->getHistLines();
 }
 
-#define BULK_TIMEOUT1 10
-#define BULK_TIMEOUT2 40
+quint64 TerminalEmulation::removedLineCount() const
+{
+    return _currentScreen->removedHistoryLines();
+}
+
+// Output counts as a burst while more than FAST_FORWARD_THRESHOLD bytes
+// arrive within FAST_FORWARD_PERIOD ms.  During a burst the views are
+// updated at most every FAST_FORWARD_TIMEOUT ms, the burst is over when no output
+// arrives for FAST_FORWARD_SETTLE_TIME ms or the rate drops below the
+// threshold.
+#define FAST_FORWARD_THRESHOLD  262144
+#define FAST_FORWARD_PERIOD     100
+#define FAST_FORWARD_TIMEOUT    100
+#define FAST_FORWARD_SETTLE_TIME 100
 
 void TerminalEmulation::showBulk()
 {
-    _bulkTimer1.stop();
-    _bulkTimer2.stop();
+    _frameScheduler.cancelFrame();
 
     emit outputChanged();
 
@@ -317,15 +375,86 @@ void TerminalEmulation::showBulk()
 
 void TerminalEmulation::bufferedUpdate()
 {
-    _bulkTimer1.setSingleShot(true);
-    _bulkTimer1.start(BULK_TIMEOUT1);
-    if (!_bulkTimer2.isActive())
+    _frameScheduler.scheduleFrame();
+}
+
+void TerminalEmulation::notifyUserInput()
+{
+    _frameScheduler.notifyInput();
+}
+
+void TerminalEmulation::setMaximumFrameRate(int fps)
+{
+    _frameScheduler.setMaximumFrameRate(fps);
+}
+
+int TerminalEmulation::maximumFrameRate() const
+{
+    return _frameScheduler.maximumFrameRate();
+}
+
+const FrameStatistics& TerminalEmulation::frameStatistics() const
+{
+    return _frameScheduler.statistics();
+}
+
+void TerminalEmulation::resetFrameStatistics()
+{
+    _frameScheduler.resetStatistics();
+}
+
+void TerminalEmulation::updateThroughput(int length)
+{
+    if (_fastForwarding)
+        _fastForwardTimer.start(FAST_FORWARD_SETTLE_TIME);
+
+    if (!_throughputTimer.isValid())
+        _throughputTimer.start();
+
+    _throughputBytes += length;
+
+    const qint64 elapsed = _throughputTimer.elapsed();
+    if (elapsed < FAST_FORWARD_PERIOD)
+        return;
+
+    setFastForwarding(_throughputBytes * FAST_FORWARD_PERIOD / elapsed >= FAST_FORWARD_THRESHOLD);
+
+    _throughputBytes = 0;
+    _throughputTimer.restart();
+}
+
+void TerminalEmulation::endFastForward()
+{
+    setFastForwarding(false);
+}
+
+void TerminalEmulation::setFastForwarding(bool fastForwarding)
+{
+    if (fastForwarding == _fastForwarding)
+        return;
+
+    _fastForwarding = fastForwarding;
+    emit fastForwardingChanged(fastForwarding);
+
+    if (fastForwarding)
+    {
+        _frameScheduler.setMinimumFrameInterval(FAST_FORWARD_TIMEOUT);
+        _fastForwardTimer.start(FAST_FORWARD_SETTLE_TIME);
+    }
+    else
     {
-        _bulkTimer2.setSingleShot(true);
-        _bulkTimer2.start(BULK_TIMEOUT2);
+        // the final update, which also runs the views' filters again
+        _frameScheduler.setMinimumFrameInterval(0);
+        _fastForwardTimer.stop();
+        showBulk();
     }
 }
 
+bool TerminalEmulation::isFastForwarding() const
+{
+    return _fastForwarding;
+}
+
 char TerminalEmulation::eraseChar() const
 {
     return '\b';
@@ -30,8 +30,13 @@
 #pragma once
 
 // Own includes
+#include "utf8decoder.h"
+#include "framescheduler.h"
 class KeyboardTranslator;
 class HistoryType;
+class HistoryIndex;
+class LiteralMatcher;
+struct LiteralMatch;
 class Screen;
 class ScreenWindow;
 class TerminalCharacterDecoder;
@@ -44,6 +49,8 @@ class TerminalCharacterDecoder;
 #include <QTextCodec>
 #include <QTextStream>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
 
 /** 
  * This enum describes the available states which
@@ -141,6 +148,36 @@ public:
    */
     int lineCount() const;
 
+    /**
+   * Returns the number of lines removed from the start of the history of the
+   * current screen, see Screen::removedHistoryLines()
+   */
+    quint64 removedLineCount() const;
+
+    /**
+   * Returns true while the emulation skips through a burst of output.
+   *
+   * When the terminal program writes a lot of output for a while, the
+   * emulation updates its views at a reduced rate and the views stop
+   * running their filters.  Once the output settles, the views receive
+   * a final full update.
+   */
+    bool isFastForwarding() const;
+
+    /**
+   * Sets the maximum number of times per second the views are updated.
+   * A value of 0 limits the updates to the refresh rate of the screen only,
+   * which is the default.
+   */
+    void setMaximumFrameRate(int fps);
+    /** Returns the rate set with setMaximumFrameRate() */
+    int maximumFrameRate() const;
+
+    /** Returns timing statistics of the updates of the views */
+    const FrameStatistics& frameStatistics() const;
+    /** Discards the statistics returned by frameStatistics() */
+    void resetFrameStatistics();
+
     /**
    * Sets the history store used by this emulation.  When new lines
    * are added to the output, older lines at the top of the screen are transferred to a history
@@ -155,6 +192,18 @@ public:
     /** Clears the history scroll. */
     void clearHistory();
 
+    /**
+   * Keeps an index of the lines added to the history, which lets searches
+   * for text skip the lines which do not contain it.  The index takes up
+   * to @p bytes of memory, 0 removes it.
+   */
+    void setHistoryIndexMemoryLimit(size_t bytes);
+    /**
+   * Returns the index of the lines of the history of the current screen,
+   * or 0 if there is none.  See setHistoryIndexMemoryLimit()
+   */
+    const HistoryIndex* historyIndex() const;
+
     /**
    * Copies the output history from @p startLine to @p endLine
    * into @p stream, using @p decoder to convert the terminal
@@ -168,6 +217,13 @@ public:
    */
     virtual void writeToStream(TerminalCharacterDecoder* decoder,int startLine,int endLine);
 
+    /**
+   * Finds the text of @p matcher in the lines from @p startLine to @p endLine
+   * without converting them into text first, see Screen::findText()
+   */
+    void findText(const LiteralMatcher& matcher, int startLine, int endLine,
+                  QVector<LiteralMatch>& matches) const;
+
     /** Returns the codec used to decode incoming characters.  See setCodec() */
     const QTextCodec* codec() const { return _codec; }
     /** Sets the codec used to decode incoming characters.  */
@@ -248,12 +304,13 @@ public slots:
 
     /**
    * Processes an incoming stream of characters.  receiveData() decodes the incoming
-   * character buffer using the current codec(), and then calls receiveChar() for
-   * each unicode character in the resulting buffer.
+   * character buffer using the current codec(), and then passes the resulting
+   * unicode characters to receiveChars().
    *
-   * receiveData() also starts a timer which causes the outputChanged() signal
-   * to be emitted when it expires.  The timer allows multiple updates in quick
-   * succession to be buffered into a single outputChanged() signal emission.
+   * receiveData() also schedules an emission of the outputChanged() signal.
+   * Updates in quick succession are buffered into a single emission, at most
+   * one per refresh of the screen.  A little output which follows user input,
+   * such as the echo of a key press, is shown without delay.
    *
    * @param buffer A string of characters received from the terminal program.
    * @param len The length of @p buffer
@@ -324,6 +381,18 @@ signals:
    */
     void outputChanged();
 
+    /**
+   * Emitted when the emulation starts or stops skipping through a burst of
+   * output.  See isFastForwarding()
+   */
+    void fastForwardingChanged(bool fastForwarding);
+
+    /**
+   * Emitted when the emulation switches between the primary and the
+   * alternate screen, which have their own lines.  See setScreen()
+   */
+    void currentScreenChanged();
+
     /**
    * Emitted when the program running in the terminal wishes to update the
    * session's title.  This also allows terminal programs to customize other
@@ -394,6 +463,13 @@ protected:
    */
     virtual void receiveChar(int ch);
 
+    /**
+   * Processes a buffer of @p count incoming characters.  The default
+   * implementation calls receiveChar() for each of them, emulations may
+   * override this to handle runs of characters in one go.  See receiveData()
+   */
+    virtual void receiveChars(const ushort* chars, int count);
+
     /**
    * Sets the active screen.  The terminal has two screens, primary and alternate.
    * The primary screen is used by default.  When certain interactive programs such
@@ -426,8 +502,16 @@ protected:
     //the current text codec.  (this allows for rendering of non-ASCII characters in text files etc.)
     const QTextCodec* _codec;
     QTextDecoder* _decoder;
+    //used instead of _decoder if the codec is UTF-8, which is the common case
+    Utf8Decoder _utf8Decoder;
     const KeyboardTranslator* _keyTranslator; // the keyboard layout
 
+    /**
+   * Tells the emulation that the user has sent input to the terminal
+   * program.  Output which follows shortly after is shown right away.
+   */
+    void notifyUserInput();
+
 protected slots:
     /**
    * Schedules an update of attached views.
@@ -442,12 +526,23 @@ private slots:
     // view
     void showBulk();
 
+    // triggered by timer once the output has settled after a burst
+    void endFastForward();
+
     void usesMouseChanged(bool usesMouse);
 
 private:
+    void updateThroughput(int length);
+    void setFastForwarding(bool fastForwarding);
+
     bool _usesMouse;
-    QTimer _bulkTimer1;
-    QTimer _bulkTimer2;
+    FrameScheduler _frameScheduler;
+
+    // detection of output bursts
+    bool _fastForwarding;
+    qint64 _throughputBytes;
+    QElapsedTimer _throughputTimer;
+    QTimer _fastForwardTimer;
 
 };
 
@@ -92,6 +92,8 @@ TerminalSession::TerminalSession(QObject* parent) :
              SLOT(sendData(const char *,int)) );
     connect( _terminalEmulation,SIGNAL(useUtf8Request(bool)),_shellProcess,SLOT(setUtf8Mode(bool)) );
 
+    connect( _shellProcess,SIGNAL(throttlingChanged(bool)), this, SIGNAL(throttlingChanged(bool)) );
+
     connect( _shellProcess,SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(done(int)) );
     // not in kprocess anymore connect( _shellProcess,SIGNAL(done(int)), this, SLOT(done(int)) );
 
@@ -647,6 +649,11 @@ const HistoryType & TerminalSession::historyType() const
     return _terminalEmulation->history();
 }
 
+void TerminalSession::setHistoryIndexMemoryLimit(size_t bytes)
+{
+    _terminalEmulation->setHistoryIndexMemoryLimit(bytes);
+}
+
 void TerminalSession::clearHistory()
 {
     _terminalEmulation->clearHistory();
@@ -730,6 +737,41 @@ bool TerminalSession::flowControlEnabled() const
     return _flowControl;
 }
 
+void TerminalSession::setThreadedReading(bool enabled)
+{
+    _shellProcess->setThreadedReading(enabled);
+}
+
+bool TerminalSession::threadedReading() const
+{
+    return _shellProcess->threadedReading();
+}
+
+void TerminalSession::setMaximumReadBudget(int bytes)
+{
+    _shellProcess->setMaximumReadBudget(bytes);
+}
+
+int TerminalSession::maximumReadBudget() const
+{
+    return _shellProcess->maximumReadBudget();
+}
+
+void TerminalSession::setMaximumProcessingTime(int msecs)
+{
+    _shellProcess->setMaximumProcessingTime(msecs);
+}
+
+int TerminalSession::maximumProcessingTime() const
+{
+    return _shellProcess->maximumProcessingTime();
+}
+
+bool TerminalSession::isThrottled() const
+{
+    return _shellProcess->isThrottled();
+}
+
 void TerminalSession::onReceiveBlock( const char * buf, int len )
 {
     _terminalEmulation->receiveData( buf, len );
@@ -211,6 +211,11 @@ public:
      * Returns the type of history store used by this session.
      */
     const HistoryType & historyType() const;
+    /**
+     * Sets the memory the index of the history, which speeds up searches,
+     * may take.  0 disables the index.
+     */
+    void setHistoryIndexMemoryLimit(size_t bytes);
     /**
      * Clears the history store used by this session.
      */
@@ -307,6 +312,37 @@ public:
     /** Returns whether flow control is enabled for this terminal session. */
     bool flowControlEnabled() const;
 
+    /**
+     * Sets whether the output of the terminal program is read on a
+     * separate thread, see PseudoTerminalProcess::setThreadedReading().
+     */
+    void setThreadedReading(bool enabled);
+
+    /** Returns whether the output is read on a separate thread. */
+    bool threadedReading() const;
+
+    /**
+     * Sets the largest number of bytes which are read from the terminal
+     * program at once, see PseudoTerminalDevice::setMaximumReadBudget().
+     */
+    void setMaximumReadBudget(int bytes);
+
+    /** Returns the limit set with setMaximumReadBudget(). */
+    int maximumReadBudget() const;
+
+    /**
+     * Sets the time in milliseconds which may be spent processing the output
+     * of the terminal program per event loop turn before the output is held
+     * back, see PseudoTerminalProcess::setMaximumProcessingTime().
+     */
+    void setMaximumProcessingTime(int msecs);
+
+    /** Returns the limit set with setMaximumProcessingTime(). */
+    int maximumProcessingTime() const;
+
+    /** Returns true if the output is currently being held back. */
+    bool isThrottled() const;
+
     /**
      * Sends @p text to the current foreground terminal program.
      */
@@ -439,6 +475,12 @@ signals:
      */
     void flowControlEnabledChanged(bool enabled);
 
+    /**
+     * Emitted when the output of the terminal program starts or stops
+     * being held back because processing it takes too long.
+     */
+    void throttlingChanged(bool throttled);
+
     void silence();
     void activity();
 
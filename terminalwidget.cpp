@@ -33,6 +33,7 @@
 #include "keyboardtranslator.h"
 #include "colorscheme.h"
 #include "searchbar.h"
+#include "historymatches.h"
 #include "terminalwidget.h"
 
 // Qt includes
@@ -45,7 +46,9 @@
 #define STEP_ZOOM 1
 
 TerminalWidget::TerminalWidget(QWidget *parent, bool startSession)
-    : QWidget(parent) {
+    : QWidget(parent)
+    , _historySize(1000)
+    , _historyMemoryBudget(4 * 1024 * 1024) {
     initialize(startSession);
 }
 
@@ -75,19 +78,49 @@ void TerminalWidget::search(bool forwards, bool next) {
         _terminalDisplay->screenWindow()->screen()->getSelectionStart(startColumn, startLine);
     }
 
-    QRegExp regExp(_searchBar->searchText());
-    regExp.setPatternSyntax(_searchBar->useRegularExpression() ? QRegExp::RegExp : QRegExp::FixedString);
-    regExp.setCaseSensitivity(_searchBar->matchCase() ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    const CompiledRegExp regExp = searchRegExp();
 
-    HistorySearch *historySearch =
+    // a search still running for the previous text is of no use any more
+    if (_historySearch)
+        _historySearch->cancel();
+
+    _historySearch =
             new HistorySearch(_terminalSession->emulation(), regExp, forwards, startColumn, startLine, this);
-    connect(historySearch, SIGNAL(matchFound(int, int, int, int)), this, SLOT(matchFound(int, int, int, int)));
-    connect(historySearch, SIGNAL(noMatchFound()), this, SLOT(noMatchFound()));
-    connect(historySearch, SIGNAL(noMatchFound()), _searchBar, SLOT(noMatchFound()));
-    historySearch->search();
+    connect(_historySearch, SIGNAL(matchFound(int, int, int, int)), this, SLOT(matchFound(int, int, int, int)));
+    connect(_historySearch, SIGNAL(noMatchFound()), this, SLOT(noMatchFound()));
+    connect(_historySearch, SIGNAL(noMatchFound()), _searchBar, SLOT(noMatchFound()));
+    _historySearch->search();
+}
+
+CompiledRegExp TerminalWidget::searchRegExp() const {
+    const Qt::CaseSensitivity caseSensitivity = _searchBar->matchCase() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (!_searchBar->useRegularExpression())
+        return CompiledRegExp::fromText(_searchBar->searchText(), caseSensitivity);
+
+    return CompiledRegExp(_searchBar->searchText(), caseSensitivity == Qt::CaseSensitive
+                          ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
+}
+
+void TerminalWidget::updateSearchMatches() {
+    // the matches are only kept up to date while they are shown
+    if (!_searchBar->isHidden() && _searchBar->highlightAllMatches())
+        _historyMatches->setRegExp(searchRegExp());
+    else
+        _historyMatches->setRegExp(CompiledRegExp());
+}
+
+void TerminalWidget::searchMatchesChanged() {
+    if (_historyMatches->regExp().isEmpty())
+        _searchBar->clearMatchCount();
+    else
+        _searchBar->setMatchCount(_historyMatches->count(), _historyMatches->isComplete());
 }
 
 void TerminalWidget::matchFound(int startColumn, int startLine, int endColumn, int endLine) {
+    // the first match is the one to select, the search can stop there
+    if (_historySearch && sender() == _historySearch)
+        _historySearch->cancel();
+
     ScreenWindow* sw = _terminalDisplay->screenWindow();
     qDebug() << "Scroll to" << startLine;
     sw->scrollTo(startLine);
@@ -148,6 +181,7 @@ void TerminalWidget::initialize(bool startSession) {
     connect(_terminalSession, SIGNAL(bellRequest(QString)), _terminalDisplay, SLOT(bell(QString)));
     connect(_terminalSession, SIGNAL(activity()), this, SIGNAL(activity()));
     connect(_terminalSession, SIGNAL(silence()), this, SIGNAL(silence()));
+    connect(_terminalSession, SIGNAL(throttlingChanged(bool)), this, SIGNAL(throttlingChanged(bool)));
 
     _searchBar = new SearchBar(this);
     _searchBar->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Maximum);
@@ -156,6 +190,13 @@ void TerminalWidget::initialize(bool startSession) {
     connect(_searchBar, SIGNAL(findPrevious()), this, SLOT(findPrevious()));
     _searchBar->hide();
 
+    _historyMatches = new HistoryMatches(_terminalSession->emulation(), this);
+    connect(_historyMatches, SIGNAL(matchesChanged()), this, SLOT(searchMatchesChanged()));
+    connect(_searchBar, SIGNAL(searchCriteriaChanged()), this, SLOT(updateSearchMatches()));
+    connect(_searchBar, SIGNAL(highlightMatchesChanged(bool)), this, SLOT(updateSearchMatches()));
+    connect(_searchBar, SIGNAL(visibilityChanged(bool)), this, SLOT(updateSearchMatches()));
+    _terminalDisplay->setSearchMatches(_historyMatches);
+
     // Set fonts
     QFont font = QApplication::font();
     font.setFamily("Monospace");
@@ -197,7 +238,7 @@ void TerminalWidget::createSession() {
     _terminalSession->setAutoClose(true);
     _terminalSession->setCodec(QTextCodec::codecForName("UTF-8"));
     _terminalSession->setFlowControlEnabled(true);
-    _terminalSession->setHistoryType(HistoryTypeBuffer(1000));
+    _terminalSession->setHistoryType(HistoryTypeBuffer(_historySize));
     _terminalSession->setKeyBindings("");
 
     connect(_terminalSession, SIGNAL(finished()), this, SLOT(sessionFinished()));
@@ -356,12 +397,26 @@ void TerminalWidget::setSize(int h, int v) {
 }
 
 void TerminalWidget::setHistorySize(int lines) {
+    _historySize = lines;
+
+    // unlimited history is compressed, and written to a file once it
+    // takes more than its memory budget
     if (lines < 0)
-        _terminalSession->setHistoryType(HistoryTypeFile());
+        _terminalSession->setHistoryType(CompressedHistoryType(0, _historyMemoryBudget));
     else
         _terminalSession->setHistoryType(HistoryTypeBuffer(lines));
 }
 
+void TerminalWidget::setHistoryMemorySize(int kilobytes) {
+    _historyMemoryBudget = size_t(qMax(0, kilobytes)) * 1024;
+    if (_historySize < 0)
+        setHistorySize(_historySize);
+}
+
+void TerminalWidget::setHistoryIndexSize(int kilobytes) {
+    _terminalSession->setHistoryIndexMemoryLimit(size_t(qMax(0, kilobytes)) * 1024);
+}
+
 void TerminalWidget::setScrollBarPosition(ScrollBarPosition pos) {
     if (!_terminalDisplay)
         return;
@@ -450,6 +505,46 @@ bool TerminalWidget::flowControlEnabled(void) {
     return _terminalSession->flowControlEnabled();
 }
 
+void TerminalWidget::setThreadedReading(bool enabled) {
+    _terminalSession->setThreadedReading(enabled);
+}
+
+bool TerminalWidget::threadedReading() {
+    return _terminalSession->threadedReading();
+}
+
+void TerminalWidget::setMaximumReadBudget(int bytes) {
+    _terminalSession->setMaximumReadBudget(bytes);
+}
+
+int TerminalWidget::maximumReadBudget() {
+    return _terminalSession->maximumReadBudget();
+}
+
+void TerminalWidget::setMaximumProcessingTime(int msecs) {
+    _terminalSession->setMaximumProcessingTime(msecs);
+}
+
+int TerminalWidget::maximumProcessingTime() {
+    return _terminalSession->maximumProcessingTime();
+}
+
+void TerminalWidget::setMaximumFrameRate(int fps) {
+    _terminalSession->emulation()->setMaximumFrameRate(fps);
+}
+
+int TerminalWidget::maximumFrameRate() {
+    return _terminalSession->emulation()->maximumFrameRate();
+}
+
+const FrameStatistics& TerminalWidget::frameStatistics() {
+    return _terminalSession->emulation()->frameStatistics();
+}
+
+void TerminalWidget::resetFrameStatistics() {
+    _terminalSession->emulation()->resetFrameStatistics();
+}
+
 void TerminalWidget::setFlowControlWarningEnabled(bool enabled) {
     if (flowControlEnabled()) {
         // Do not show warning label if flow control is disabled
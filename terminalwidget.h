@@ -27,12 +27,16 @@
 
 // Own includes
 #include "filter.h"
+#include "framescheduler.h"
 #include "terminaldisplay.h"
 #include "terminalsession.h"
 class SearchBar;
+class HistorySearch;
+class HistoryMatches;
 
 // Qt includes
 #include <QWidget>
+#include <QPointer>
 class QVBoxLayout;
 class QUrl;
 
@@ -116,8 +120,26 @@ public:
     /** Sets the terminal screen size. */
     void setSize(int h, int v);
 
-    /** Sets the history size for scrolling in lines. */
-    void setHistorySize(int lines); //infinite if lines < 0
+    /**
+     * Sets the history size for scrolling in lines.  If @p lines is
+     * negative the history is unlimited, older lines are then kept
+     * compressed and the oldest are written to a temporary file.
+     */
+    void setHistorySize(int lines);
+
+    /**
+     * Sets the memory in kilobytes an unlimited history may take before
+     * its oldest lines are written to a temporary file.  0 keeps all of
+     * them in memory.  The default is 4096.
+     */
+    void setHistoryMemorySize(int kilobytes);
+
+    /**
+     * Sets the memory in kilobytes the index of the history may take.  The
+     * index lets searches for plain text skip the parts of the history
+     * which do not contain it.  0, the default, disables the index.
+     */
+    void setHistoryIndexSize(int kilobytes);
 
     /** Sets the scrollbar position. */
     void setScrollBarPosition(ScrollBarPosition);
@@ -134,6 +156,51 @@ public:
     /** @returns whether flow control is enabled */
     bool flowControlEnabled(void);
 
+    /**
+     * Sets whether the output of the terminal program is read on a
+     * separate thread, so it keeps flowing while the widget is busy.
+     */
+    void setThreadedReading(bool enabled);
+
+    /** @returns whether the output is read on a separate thread */
+    bool threadedReading();
+
+    /**
+     * Sets the largest number of bytes which are read from the terminal
+     * program before they are processed.
+     */
+    void setMaximumReadBudget(int bytes);
+
+    /** @returns the largest number of bytes read before processing */
+    int maximumReadBudget();
+
+    /**
+     * Sets the time in milliseconds which may be spent processing output
+     * per event loop turn before the output is held back.
+     */
+    void setMaximumProcessingTime(int msecs);
+
+    /** @returns the time which may be spent processing output per turn */
+    int maximumProcessingTime();
+
+    /**
+     * Sets the maximum number of times per second the terminal is redrawn
+     * while output arrives.  0 means the refresh rate of the screen.
+     */
+    void setMaximumFrameRate(int fps);
+
+    /** @returns the maximum number of redraws per second */
+    int maximumFrameRate();
+
+    /**
+     * @returns timing statistics of the redraws since the terminal was
+     * created or resetFrameStatistics() was called
+     */
+    const FrameStatistics& frameStatistics();
+
+    /** Discards the statistics returned by frameStatistics() */
+    void resetFrameStatistics();
+
     /**
      * Sets whether the flow control warning box should be shown
      * when the flow control stop key (Ctrl+S) is pressed.
@@ -201,6 +268,9 @@ signals:
     void activity();
     void silence();
 
+    /** Emitted when output starts or stops being held back. */
+    void throttlingChanged(bool throttled);
+
 public slots:
     /** Copies selection to clipboard. */
     void copyClipboard();
@@ -238,9 +308,12 @@ private slots:
     void findPrevious();
     void matchFound(int startColumn, int startLine, int endColumn, int endLine);
     void noMatchFound();
+    void updateSearchMatches();
+    void searchMatchesChanged();
 
 private:
     void search(bool forwards, bool next);
+    CompiledRegExp searchRegExp() const;
     void setZoom(int step);
     void initialize(bool startSession);
     void createSession();
@@ -249,5 +322,12 @@ private:
     TerminalDisplay *_terminalDisplay;
     TerminalSession *_terminalSession;
     SearchBar *_searchBar;
+    // the search which is running, if any
+    QPointer<HistorySearch> _historySearch;
+    // all matches of the search text, while they are highlighted
+    HistoryMatches *_historyMatches;
     QVBoxLayout *_layout;
+    // the arguments of setHistorySize() and setHistoryMemorySize()
+    int _historySize;
+    size_t _historyMemoryBudget;
 };
@@ -0,0 +1,213 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own includes
+#include "utf8decoder.h"
+
+// System includes
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define REPLACEMENT_CHARACTER 0xfffd
+#define BYTE_ORDER_MARK       0xfeff
+
+// The first byte of the sequence "\030B00" which is sent
+// at the start of a ZModem transfer
+#define ZMODEM_START '\030'
+
+Utf8Decoder::Utf8Decoder()
+    : _out(0),
+      _zmodemMarkers(0)
+{
+    reset();
+}
+
+void Utf8Decoder::reset()
+{
+    _codePoint = 0;
+    _bytesNeeded = 0;
+    _bytesSeen = 0;
+    _lowerBoundary = 0x80;
+    _upperBoundary = 0xbf;
+    _atStreamStart = true;
+}
+
+int Utf8Decoder::decode(const char* data, int length)
+{
+    // Each byte yields at most one code unit.  A sequence left over from
+    // the previous block may add a second unit for its last byte.
+    if (_buffer.size() < length + 2)
+        _buffer.resize(length + 2);
+    _out = _buffer.data();
+    _zmodemMarkers = 0;
+
+    const uchar* bytes = (const uchar*)data;
+    int i = 0;
+    while (i < length)
+    {
+        if (_bytesNeeded == 0)
+        {
+            // Convert runs of ASCII characters a block at a time.  Blocks
+            // which contain other characters or the start of a ZModem
+            // sequence are left to the byte-wise decoding below.
+#if defined(__SSE2__)
+            const __m128i zmodemStart = _mm_set1_epi8(ZMODEM_START);
+            const __m128i zero = _mm_setzero_si128();
+            while (i + 16 <= length)
+            {
+                const __m128i block = _mm_loadu_si128((const __m128i*)(bytes + i));
+                const __m128i special = _mm_or_si128(block, _mm_cmpeq_epi8(block, zmodemStart));
+                if (_mm_movemask_epi8(special))
+                    break;
+
+                _mm_storeu_si128((__m128i*)_out, _mm_unpacklo_epi8(block, zero));
+                _mm_storeu_si128((__m128i*)(_out + 8), _mm_unpackhi_epi8(block, zero));
+                _out += 16;
+                i += 16;
+                _atStreamStart = false;
+            }
+#else
+            while (i + 8 <= length)
+            {
+                quint64 block;
+                memcpy(&block, bytes + i, 8);
+                const quint64 zmodem = block ^ Q_UINT64_C(0x1818181818181818);
+                const quint64 hasZmodemStart = (zmodem - Q_UINT64_C(0x0101010101010101)) &
+                                               ~zmodem & Q_UINT64_C(0x8080808080808080);
+                if ((block & Q_UINT64_C(0x8080808080808080)) || hasZmodemStart)
+                    break;
+
+                for (int j = 0; j < 8; j++)
+                    _out[j] = bytes[i + j];
+                _out += 8;
+                i += 8;
+                _atStreamStart = false;
+            }
+#endif
+            if (i >= length)
+                break;
+
+            const uchar byte = bytes[i];
+            if (byte < 0x80)
+            {
+                if (byte == ZMODEM_START && i + 4 < length && strncmp(data + i + 1, "B00", 3) == 0)
+                    _zmodemMarkers++;
+
+                *_out++ = byte;
+                _atStreamStart = false;
+                i++;
+                continue;
+            }
+        }
+
+        if (decodeByte(bytes[i]))
+            i++;
+    }
+
+    return _out - _buffer.constData();
+}
+
+bool Utf8Decoder::decodeByte(uchar byte)
+{
+    if (_bytesNeeded == 0)
+    {
+        if (byte >= 0xc2 && byte <= 0xdf)
+        {
+            _bytesNeeded = 1;
+            _codePoint = byte & 0x1f;
+        }
+        else if (byte >= 0xe0 && byte <= 0xef)
+        {
+            // reject overlong forms and UTF-16 surrogates
+            if (byte == 0xe0)
+                _lowerBoundary = 0xa0;
+            if (byte == 0xed)
+                _upperBoundary = 0x9f;
+            _bytesNeeded = 2;
+            _codePoint = byte & 0x0f;
+        }
+        else if (byte >= 0xf0 && byte <= 0xf4)
+        {
+            // reject overlong forms and code points above U+10FFFF
+            if (byte == 0xf0)
+                _lowerBoundary = 0x90;
+            if (byte == 0xf4)
+                _upperBoundary = 0x8f;
+            _bytesNeeded = 3;
+            _codePoint = byte & 0x07;
+        }
+        else
+        {
+            appendCodePoint(REPLACEMENT_CHARACTER);
+        }
+        return true;
+    }
+
+    if (byte < _lowerBoundary || byte > _upperBoundary)
+    {
+        // the sequence is invalid, 'byte' may start the next one
+        _codePoint = 0;
+        _bytesNeeded = 0;
+        _bytesSeen = 0;
+        _lowerBoundary = 0x80;
+        _upperBoundary = 0xbf;
+        appendCodePoint(REPLACEMENT_CHARACTER);
+        return false;
+    }
+
+    _lowerBoundary = 0x80;
+    _upperBoundary = 0xbf;
+    _codePoint = (_codePoint << 6) | (byte & 0x3f);
+    _bytesSeen++;
+
+    if (_bytesSeen == _bytesNeeded)
+    {
+        const uint codePoint = _codePoint;
+        _codePoint = 0;
+        _bytesNeeded = 0;
+        _bytesSeen = 0;
+        appendCodePoint(codePoint);
+    }
+    return true;
+}
+
+void Utf8Decoder::appendCodePoint(uint codePoint)
+{
+    if (_atStreamStart)
+    {
+        _atStreamStart = false;
+        if (codePoint == BYTE_ORDER_MARK)
+            return;
+    }
+
+    if (codePoint >= 0x10000)
+    {
+        *_out++ = 0xd800 + ((codePoint - 0x10000) >> 10);
+        *_out++ = 0xdc00 + ((codePoint - 0x10000) & 0x3ff);
+    }
+    else
+    {
+        *_out++ = codePoint;
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Part of QtTerminalWidget:
+ * https://github.com/cybercatalyst/qtterminalwidget
+ */
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#pragma once
+
+// Qt includes
+#include <QVector>
+
+/**
+ * A streaming UTF-8 to UTF-16 decoder for the output of the terminal program.
+ *
+ * Incomplete sequences at the end of a block are kept and completed by the
+ * next call to decode(), so the program's output can be decoded in the
+ * chunks it is read from the terminal.  The decoded characters are written
+ * into a buffer owned by the decoder, which is reused between calls.
+ *
+ * Runs of ASCII characters are converted several bytes at a time.  While
+ * scanning, the decoder also looks for the sequence which indicates the
+ * start of a ZModem transfer, so the emulation does not have to scan the
+ * incoming data a second time.
+ *
+ * Malformed input is decoded to U+FFFD, one replacement character for each
+ * maximal invalid subsequence.  A byte order mark at the start of the
+ * stream is skipped, like QTextDecoder does.
+ */
+class Utf8Decoder
+{
+public:
+    Utf8Decoder();
+
+    /** Discards any incomplete sequence and starts a new stream. */
+    void reset();
+
+    /**
+     * Decodes @p length bytes from @p data.  Returns the number of UTF-16
+     * code units available from buffer() afterwards.
+     */
+    int decode(const char* data, int length);
+
+    /**
+     * Returns the characters decoded by the last call to decode().
+     * The buffer is valid until the next call to decode().
+     */
+    const ushort* buffer() const
+    { return _buffer.constData(); }
+
+    /**
+     * Returns the number of ZModem start sequences ("\030B00") found
+     * by the last call to decode().
+     */
+    int zmodemMarkers() const
+    { return _zmodemMarkers; }
+
+private:
+    // Decodes a byte which is not part of an ASCII run.  Returns false
+    // if the byte ended an invalid sequence and has to be decoded again.
+    bool decodeByte(uchar byte);
+    void appendCodePoint(uint codePoint);
+
+    QVector<ushort> _buffer;
+    ushort* _out;
+
+    // state of the sequence which is currently being decoded
+    uint _codePoint;
+    int _bytesNeeded;
+    int _bytesSeen;
+    uchar _lowerBoundary;
+    uchar _upperBoundary;
+    bool _atStreamStart;
+
+    int _zmodemMarkers;
+};
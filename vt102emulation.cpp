@@ -60,7 +60,6 @@ Vt102Emulation::Vt102Emulation()
     _titleUpdateTimer->setSingleShot(true);
     QObject::connect(_titleUpdateTimer , SIGNAL(timeout()) , this , SLOT(updateTitle()));
 
-    initTokenizer();
     reset();
 }
 
@@ -75,8 +74,9 @@ void Vt102Emulation::clearEntireScreen()
 
 void Vt102Emulation::reset()
 {
-    resetTokenizer();
+    // the tokenizer's initial state depends on MODE_Ansi
     resetModes();
+    resetTokenizer();
     resetCharset(0);
     _screen[0]->reset();
     resetCharset(1);
@@ -167,7 +167,8 @@ void Vt102Emulation::reset()
 /* The tokenizer's state
 
    The state is represented by the buffer (tokenBuffer, tokenBufferPos),
-   and accompanied by decoded arguments kept in (argv,argc).
+   and accompanied by decoded arguments kept in (argv,argc) and the
+   current state of the parser (parserState).
    Note that they are kept internal in the tokenizer.
 */
 
@@ -177,6 +178,7 @@ void Vt102Emulation::resetTokenizer()
     argc = 0;
     argv[0] = 0;
     argv[1] = 0;
+    parserState = getMode(MODE_Ansi) ? StateGround : StateVt52Ground;
 }
 
 void Vt102Emulation::addDigit(int digit)
@@ -197,137 +199,313 @@ void Vt102Emulation::addToCurrentToken(int cc)
     tokenBufferPos = qMin(tokenBufferPos+1,MAX_TOKEN_LENGTH-1);
 }
 
-// Character Class flags used while decoding
+/* The parser
 
-#define CTL  1  // Control character
-#define CHR  2  // Printable character
-#define CPN  4  // TODO: Document me 
-#define DIG  8  // Digit
-#define SCS 16  // TODO: Document me  
-#define GRP 32  // TODO: Document me
-#define CPS 64  // Character which indicates end of window resize
-// escape sequence '\e[8;<row>;<col>t'
+   The tokenizer is a DEC style state machine.  Every incoming character
+   is looked up in a transition table using the current state, which
+   yields an action to perform and the next state.
 
-void Vt102Emulation::initTokenizer()
-{ 
-    int i;
-    quint8* s;
-    for(i = 0;i < 256; ++i)
-        charClass[i] = 0;
-    for(i = 0;i < 32; ++i)
-        charClass[i] |= CTL;
-    for(i = 32;i < 256; ++i)
-        charClass[i] |= CHR;
-    for(s = (quint8*)"@ABCDGHILMPSTXZcdfry"; *s; ++s)
-        charClass[*s] |= CPN;
-    // resize = \e[8;<row>;<col>t
-    for(s = (quint8*)"t"; *s; ++s)
-        charClass[*s] |= CPS;
-    for(s = (quint8*)"0123456789"; *s; ++s)
-        charClass[*s] |= DIG;
-    for(s = (quint8*)"()+*%"; *s; ++s)
-        charClass[*s] |= SCS;
-    for(s = (quint8*)"()+*#[]%"; *s; ++s)
-        charClass[*s] |= GRP;
+   The table has one column for each of the code units 0..255, all code
+   units above that share the last column.  It is generated at compile
+   time by parserEntry() below, which is the place to look at when the
+   handling of a sequence needs to change.
 
-    resetTokenizer();
+   Control characters are executed in every state without disturbing
+   the sequence being scanned (a VT100 property), except for CAN and SUB
+   which abort it and ESC which starts a new one.  DEL is ignored.
+
+   Parameters of control sequences are accumulated in (argv,argc) while
+   scanning, so the dispatch actions hand them to processToken() as
+   they are.
+*/
+
+#define ESC 27
+#define CNTL(c) ((c)-'@')
+
+namespace {
+
+enum ParserState {
+    StateGround,            // printable characters, ANSI mode
+    StateEscape,            // <ESC>
+    StateEscapeCharset,     // <ESC> any of `()+*%'
+    StateEscapeHash,        // <ESC> '#'
+    StateCsiEntry,          // <ESC> '['
+    StateCsiParam,          // <ESC> '[' {Pn} ';' ...
+    StateCsiPrivate,        // <ESC> '[' '?' {Pn} ';' ...
+    StateCsiGreater,        // <ESC> '[' '>' {Pn} ';' ...
+    StateCsiBang,           // <ESC> '[' '!'
+    StateOscString,         // <ESC> ']' {Pn} ';' {Text}
+    StateVt52Ground,        // printable characters, VT52 mode
+    StateVt52Escape,        // <ESC>
+    StateVt52CursorRow,     // <ESC> 'Y'
+    StateVt52CursorColumn,  // <ESC> 'Y' {Pc}
+    StateCount
+};
+
+enum ParserAction {
+    ActionNone,             // only change the state
+    ActionIgnore,           // drop the character
+    ActionExecute,          // process a control character
+    ActionCancel,           // abort the sequence, then process the control character
+    ActionEscape,           // start a new escape sequence
+    ActionCsiIntroducer,    // 8-bit CSI, equivalent to <ESC> '['
+    ActionCollect,          // add the character to the sequence
+    ActionParam,            // add a digit to the current argument
+    ActionSeparator,        // start the next argument
+    ActionPrint,            // display a character using the current charset
+    ActionPrintRaw,         // display a character as it is
+    ActionEscDispatch,
+    ActionCharsetDispatch,
+    ActionHashDispatch,
+    ActionCsiPnDispatch,
+    ActionCsiResizeDispatch,
+    ActionCsiPsDispatch,
+    ActionCsiPrDispatch,
+    ActionCsiPgDispatch,
+    ActionCsiPeDispatch,
+    ActionOscDispatch,
+    ActionVt52Dispatch,
+    ActionVt52CursorDispatch
+};
+
+// Code units above 0xff all share the last column of the table
+#define PARSER_COLUMNS 257
+
+struct ParserTable
+{
+    quint16 entry[StateCount][PARSER_COLUMNS];
+};
+
+constexpr quint16 parserTransition(int action, int state)
+{
+    return (action << 8) | state;
 }
 
-/* Ok, here comes the nasty part of the decoder.
+constexpr bool isOneOf(int c, const char* set)
+{
+    for (; *set; ++set)
+        if (c == *set)
+            return true;
+    return false;
+}
 
-   Instead of keeping an explicit state, we deduce it from the
-   token scanned so far. It is then immediately combined with
-   the current character to form a scanning decision.
+constexpr bool isDigit(int c)
+{
+    return c >= '0' && c <= '9';
+}
 
-   This is done by the following defines.
+// Final characters of control sequences which take up to two
+// numeric arguments (CSI_PN)
+constexpr bool isCsiPnFinal(int c)
+{
+    return isOneOf(c, "@ABCDGHILMPSTXZcdfry");
+}
 
-   - P is the length of the token scanned so far.
-   - L (often P-1) is the position on which contents we base a decision.
-   - C is a character or a group of characters (taken from 'charClass').
-   
-   - 'cc' is the current character
-   - 's' is a pointer to the start of the token buffer
-   - 'p' is the current position within the token buffer
+// Returns the table entry for character class 'c' in 'state'
+constexpr quint16 parserEntry(int state, int c)
+{
+    const bool vt52 = state >= StateVt52Ground;
+    const int ground = vt52 ? StateVt52Ground : StateGround;
+
+    // characters which are treated the same in every state
+    if (c == 127)
+        return parserTransition(ActionIgnore, state);
+    if (c == ESC)
+        return parserTransition(ActionEscape, vt52 ? StateVt52Escape : StateEscape);
+    if (c == CNTL('X') || c == CNTL('Z'))
+        return parserTransition(ActionCancel, ground);
+    if (c == CNTL('G') && state == StateOscString)
+        return parserTransition(ActionOscDispatch, ground);
+    if (c < 32)
+        return parserTransition(ActionExecute, state);
+
+    switch (state)
+    {
+    case StateGround:
+        if (c == ESC+128)
+            return parserTransition(ActionCsiIntroducer, StateCsiEntry);
+        return parserTransition(ActionPrint, StateGround);
+
+    case StateEscape:
+        if (isOneOf(c, "()+*%"))
+            return parserTransition(ActionCollect, StateEscapeCharset);
+        if (c == '#')
+            return parserTransition(ActionCollect, StateEscapeHash);
+        if (c == '[')
+            return parserTransition(ActionCollect, StateCsiEntry);
+        if (c == ']')
+            return parserTransition(ActionCollect, StateOscString);
+        return parserTransition(ActionEscDispatch, ground);
+
+    case StateEscapeCharset:
+    case StateEscapeHash:
+    case StateCsiEntry:
+        // a private marker directly following the introducer turns the
+        // rest into a control sequence, even after a charset designator
+        if (c == '?')
+            return parserTransition(ActionCollect, StateCsiPrivate);
+        if (c == '>')
+            return parserTransition(ActionCollect, StateCsiGreater);
+        if (c == '!')
+            return parserTransition(ActionCollect, StateCsiBang);
+        if (state == StateEscapeCharset)
+            return parserTransition(ActionCharsetDispatch, ground);
+        if (state == StateEscapeHash)
+            return parserTransition(ActionHashDispatch, ground);
+        // the character is the first one of the parameters
+        // fall through
+    case StateCsiParam:
+        if (isDigit(c))
+            return parserTransition(ActionParam, StateCsiParam);
+        if (c == ';')
+            return parserTransition(ActionSeparator, StateCsiParam);
+        if (isCsiPnFinal(c))
+            return parserTransition(ActionCsiPnDispatch, ground);
+        if (c == 't')
+            return parserTransition(ActionCsiResizeDispatch, ground);
+        return parserTransition(ActionCsiPsDispatch, ground);
+
+    case StateCsiPrivate:
+    case StateCsiGreater:
+        if (isDigit(c))
+            return parserTransition(ActionParam, state);
+        if (c == ';')
+            return parserTransition(ActionSeparator, state);
+        if (state == StateCsiPrivate)
+            return parserTransition(ActionCsiPrDispatch, ground);
+        return parserTransition(ActionCsiPgDispatch, ground);
+
+    case StateCsiBang:
+        return parserTransition(ActionCsiPeDispatch, ground);
+
+    case StateOscString:
+        return parserTransition(ActionCollect, StateOscString);
+
+    case StateVt52Ground:
+        return parserTransition(ActionPrintRaw, StateVt52Ground);
+
+    case StateVt52Escape:
+        if (c == 'Y')
+            return parserTransition(ActionCollect, StateVt52CursorRow);
+        return parserTransition(ActionVt52Dispatch, ground);
+
+    case StateVt52CursorRow:
+        return parserTransition(ActionCollect, StateVt52CursorColumn);
+
+    case StateVt52CursorColumn:
+        return parserTransition(ActionVt52CursorDispatch, ground);
+    }
 
-   Note that they need to applied in proper order.
-*/
+    return parserTransition(ActionNone, state);
+}
+
+constexpr ParserTable makeParserTable()
+{
+    ParserTable table = {};
+    for (int state = 0; state < StateCount; state++)
+        for (int c = 0; c < PARSER_COLUMNS; c++)
+            table.entry[state][c] = parserEntry(state, c);
+    return table;
+}
 
-#define lec(P,L,C) (p == (P) && s[(L)] == (C))
-#define lun(     ) (p ==  1  && cc >= 32 )
-#define les(P,L,C) (p == (P) && s[L] < 256 && (charClass[s[(L)]] & (C)) == (C))
-#define eec(C)     (p >=  3  && cc == (C))
-#define ees(C)     (p >=  3  && cc < 256 && (charClass[cc] & (C)) == (C))
-#define eps(C)     (p >=  3  && s[2] != '?' && s[2] != '!' && s[2] != '>' && cc < 256 && (charClass[cc] & (C)) == (C))
-#define epp( )     (p >=  3  && s[2] == '?')
-#define epe( )     (p >=  3  && s[2] == '!')
-#define egt( )     (p >=  3  && s[2] == '>')
-#define Xpe        (tokenBufferPos >= 2 && tokenBuffer[1] == ']')
-#define Xte        (Xpe      && cc ==  7 )
-#define ces(C)     (cc < 256 && (charClass[cc] & (C)) == (C) && !Xte)
+constexpr ParserTable parserTable = makeParserTable();
 
-#define ESC 27
-#define CNTL(c) ((c)-'@')
+} // namespace
 
 // process an incoming unicode character
 void Vt102Emulation::receiveChar(int cc)
-{ 
-    if (cc == 127)
-        return; //VT100: ignore.
+{
+    const quint16 entry = parserTable.entry[parserState][qMin(cc, PARSER_COLUMNS-1)];
 
-    if (ces(CTL))
+    switch (entry >> 8)
     {
-        // DEC HACK ALERT! Control Characters are allowed *within* esc sequences in VT100
-        // This means, they do neither a resetTokenizer() nor a pushToToken(). Some of them, do
-        // of course. Guess this originates from a weakly layered handling of the X-on
-        // X-off protocol, which comes really below this level.
-        if (cc == CNTL('X') || cc == CNTL('Z') || cc == ESC)
-            resetTokenizer(); //VT100: CAN or SUB
-        if (cc != ESC)
-        {
-            processToken(TY_CTL(cc+'@' ),0,0);
-            return;
-        }
+    case ActionNone:
+        break;
+
+    case ActionIgnore:
+        return;
+
+    case ActionExecute:
+        processToken( TY_CTL(cc+'@'), 0, 0);
+        return;
+
+    case ActionCancel:
+        resetTokenizer();
+        processToken( TY_CTL(cc+'@'), 0, 0);
+        return;
+
+    case ActionEscape:
+        resetTokenizer();
+        addToCurrentToken(cc);
+        break;
+
+    case ActionCsiIntroducer:
+        addToCurrentToken(ESC);
+        addToCurrentToken('[');
+        break;
+
+    case ActionCollect:
+        addToCurrentToken(cc);
+        break;
+
+    case ActionParam:
+        addToCurrentToken(cc);
+        addDigit(cc-'0');
+        break;
+
+    case ActionSeparator:
+        addToCurrentToken(cc);
+        addArgument();
+        break;
+
+    case ActionPrint:
+        processToken( TY_CHR(), applyCharset(cc), 0);
+        return;
+
+    case ActionPrintRaw:
+        processToken( TY_CHR(), cc, 0);
+        return;
+
+    default:
+        // the remaining actions complete a sequence
+        addToCurrentToken(cc);
+        dispatchSequence(entry >> 8, cc);
+        resetTokenizer();
+        return;
     }
-    // advance the state
-    addToCurrentToken(cc);
 
-    int* s = tokenBuffer;
-    int  p = tokenBufferPos;
+    parserState = entry & 0xff;
+}
 
-    if (getMode(MODE_Ansi))
+void Vt102Emulation::dispatchSequence(int action, int cc)
+{
+    switch (action)
     {
-        if (lec(1,0,ESC)) { return; }
-        if (lec(1,0,ESC+128)) { s[0] = ESC; receiveChar('['); return; }
-        if (les(2,1,GRP)) { return; }
-        if (Xte         ) { processWindowAttributeChange(); resetTokenizer(); return; }
-        if (Xpe         ) { return; }
-        if (lec(3,2,'?')) { return; }
-        if (lec(3,2,'>')) { return; }
-        if (lec(3,2,'!')) { return; }
-        if (lun(       )) { processToken( TY_CHR(), applyCharset(cc), 0);   resetTokenizer(); return; }
-        if (lec(2,0,ESC)) { processToken( TY_ESC(s[1]), 0, 0);              resetTokenizer(); return; }
-        if (les(3,1,SCS)) { processToken( TY_ESC_CS(s[1],s[2]), 0, 0);      resetTokenizer(); return; }
-        if (lec(3,1,'#')) { processToken( TY_ESC_DE(s[2]), 0, 0);           resetTokenizer(); return; }
-        if (eps(    CPN)) { processToken( TY_CSI_PN(cc), argv[0],argv[1]);  resetTokenizer(); return; }
+    case ActionEscDispatch:
+        processToken( TY_ESC(cc), 0, 0);
+        break;
 
-        // resize = \e[8;<row>;<col>t
-        if (eps(CPS))
-        {
-            processToken( TY_CSI_PS(cc, argv[0]), argv[1], argv[2]);
-            resetTokenizer();
-            return;
-        }
+    case ActionCharsetDispatch:
+        processToken( TY_ESC_CS(tokenBuffer[1],cc), 0, 0);
+        break;
+
+    case ActionHashDispatch:
+        processToken( TY_ESC_DE(cc), 0, 0);
+        break;
 
-        if (epe(   )) { processToken( TY_CSI_PE(cc), 0, 0); resetTokenizer(); return; }
-        if (ees(DIG)) { addDigit(cc-'0'); return; }
-        if (eec(';')) { addArgument();    return; }
+    case ActionCsiPnDispatch:
+        processToken( TY_CSI_PN(cc), argv[0], argv[1]);
+        break;
+
+    // resize = \e[8;<row>;<col>t
+    case ActionCsiResizeDispatch:
+        processToken( TY_CSI_PS(cc, argv[0]), argv[1], argv[2]);
+        break;
+
+    case ActionCsiPsDispatch:
         for (int i=0;i<=argc;i++)
         {
-            if (epp())
-                processToken( TY_CSI_PR(cc,argv[i]), 0, 0);
-            else if (egt())
-                processToken( TY_CSI_PG(cc), 0, 0); // spec. case for ESC]>0c or ESC]>c
-            else if (cc == 'm' && argc - i >= 4 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 2)
+            if (cc == 'm' && argc - i >= 4 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 2)
             {
                 // ESC[ ... 48;2;<red>;<green>;<blue> ... m -or- ESC[ ... 38;2;<red>;<green>;<blue> ... m
                 i += 2;
@@ -343,32 +521,67 @@ void Vt102Emulation::receiveChar(int cc)
             else
                 processToken( TY_CSI_PS(cc,argv[i]), 0, 0);
         }
-        resetTokenizer();
+        break;
+
+    case ActionCsiPrDispatch:
+        for (int i=0;i<=argc;i++)
+            processToken( TY_CSI_PR(cc,argv[i]), 0, 0);
+        break;
+
+    case ActionCsiPgDispatch:
+        // spec. case for ESC]>0c or ESC]>c
+        for (int i=0;i<=argc;i++)
+            processToken( TY_CSI_PG(cc), 0, 0);
+        break;
+
+    case ActionCsiPeDispatch:
+        processToken( TY_CSI_PE(cc), 0, 0);
+        break;
+
+    case ActionOscDispatch:
+        processWindowAttributeChange();
+        break;
+
+    case ActionVt52Dispatch:
+        processToken( TY_VT52(cc), 0, 0);
+        break;
+
+    case ActionVt52CursorDispatch:
+        processToken( TY_VT52('Y'), tokenBuffer[2], cc);
+        break;
     }
-    else
+}
+
+// true for characters which receiveChar() hands to processToken() as TY_CHR()
+// when no escape sequence is pending
+#define isPlainChar(C) ((C) >= 32 && (C) != 127 && (C) != ESC+128)
+
+// process a buffer of incoming unicode characters
+void Vt102Emulation::receiveChars(const ushort* chars, int count)
+{
+    int i = 0;
+    while (i < count)
     {
-        // VT52 Mode
-        if (lec(1,0,ESC))
-            return;
-        if (les(1,0,CHR))
+        // Fast path: while no token is pending, runs of plain text go
+        // straight to the screen.  This is only possible if the current
+        // charset does not translate characters.
+        const CharCodes& charset = _charset[_currentScreen == _screen[1]];
+        if (parserState == StateGround && !charset.graphic && !charset.pound)
         {
-            processToken( TY_CHR(), s[0], 0);
-            resetTokenizer();
-            return;
-        }
-        if (lec(2,1,'Y'))
-            return;
-        if (lec(3,1,'Y'))
-            return;
-        if (p < 4)
-        {
-            processToken( TY_VT52(s[1] ), 0, 0);
-            resetTokenizer();
-            return;
+            int end = i;
+            while (end < count && isPlainChar(chars[end]))
+                end++;
+
+            if (end > i)
+            {
+                _currentScreen->displayCharacters(chars + i, end - i);
+                i = end;
+                continue;
+            }
         }
-        processToken( TY_VT52(s[1]), s[2], s[3]);
-        resetTokenizer();
-        return;
+
+        receiveChar(chars[i]);
+        i++;
     }
 }
 void Vt102Emulation::processWindowAttributeChange()
@@ -894,6 +1107,8 @@ void Vt102Emulation::sendKeyEvent( QKeyEvent* event )
     Qt::KeyboardModifiers modifiers = event->modifiers();
     KeyboardTranslator::States states = KeyboardTranslator::NoState;
 
+    notifyUserInput();
+
     // get current states
     if (getMode(MODE_NewLine)  ) states |= KeyboardTranslator::NewLineState;
     if (getMode(MODE_Ansi)     ) states |= KeyboardTranslator::AnsiState;
@@ -98,6 +98,7 @@ protected:
     virtual void setMode(int mode);
     virtual void resetMode(int mode);
     virtual void receiveChar(int cc);
+    virtual void receiveChars(const ushort* chars, int count);
 
 private slots:
     //causes changeTitle() to be emitted for each (int,QString) pair in pendingTitleUpdates
@@ -137,12 +138,14 @@ private:
     void addArgument();
     int argv[MAXARGS];
     int argc;
-    void initTokenizer();
 
-    // Set of flags for each of the ASCII characters which indicates
-    // what category they fall into (printable character, control, digit etc.)
-    // for the purposes of decoding terminal output
-    int charClass[256];
+    // State of the escape sequence parser, see the transition
+    // table in vt102emulation.cpp
+    int parserState;
+
+    // performs the action which completes an escape sequence
+    // with the final character 'cc'
+    void dispatchSequence(int action, int cc);
 
     void reportDecodingError();
 